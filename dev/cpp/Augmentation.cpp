@@ -0,0 +1,83 @@
+
+bool Augmentation::enabled (void) {
+    return shift || flip || rotation || noise;
+}
+
+// Augments one sample's input values in place, with new random amounts each time
+void Augmentation::apply (float* input, int size, int channels, std::vector<float>& scratch) {
+
+    int span = sqrt(size / std::max(channels, 1));
+
+    if (span * span * channels == size && (shift || flip || rotation)) {
+
+        int dx = shift ? std::uniform_int_distribution<int>(-shift, shift)(rng) : 0;
+        int dy = shift ? std::uniform_int_distribution<int>(-shift, shift)(rng) : 0;
+        bool mirror = flip && std::bernoulli_distribution(0.5)(rng);
+        double angle = rotation ? std::uniform_real_distribution<double>(-rotation, rotation)(rng) * 3.14159265358979323846 / 180 : 0;
+
+        if (dx || dy || mirror || angle) {
+            transform(input, channels, span, dx, dy, mirror, angle, scratch);
+        }
+    }
+
+    if (noise) {
+        std::normal_distribution<float> distribution(0, noise);
+
+        for (int i=0; i<size; i++) {
+            input[i] += distribution(rng);
+        }
+    }
+}
+
+// Mirrors, then rotates (about the centre) and shifts each channel's map, bilinearly sampling the original.
+// Anything sampled from outside the map is 0
+void Augmentation::transform (float* input, int channels, int span, int dx, int dy, bool mirror, double angle,
+    std::vector<float>& scratch) {
+
+    scratch.assign(input, input + channels * span * span);
+
+    double centre = (span - 1) / 2.0;
+    double cosA = cos(angle);
+    double sinA = sin(angle);
+
+    for (int r=0; r<span; r++) {
+        for (int c=0; c<span; c++) {
+
+            // Work back from the output pixel to where it came from
+            double x = c - dx - centre;
+            double y = r - dy - centre;
+            double sourceX = cosA * x + sinA * y + centre;
+            double sourceY = -sinA * x + cosA * y + centre;
+
+            if (mirror) {
+                sourceX = span - 1 - sourceX;
+            }
+
+            int x0 = floor(sourceX);
+            int y0 = floor(sourceY);
+            double fx = sourceX - x0;
+            double fy = sourceY - y0;
+
+            for (int ch=0; ch<channels; ch++) {
+
+                float* map = scratch.data() + ch * span * span;
+                double value = 0;
+
+                for (int ny=0; ny<2; ny++) {
+                    for (int nx=0; nx<2; nx++) {
+
+                        int sx = x0 + nx;
+                        int sy = y0 + ny;
+                        double weight = (nx ? fx : 1 - fx) * (ny ? fy : 1 - fy);
+
+                        if (weight && sx>=0 && sx<span && sy>=0 && sy<span) {
+                            value += weight * map[sy * span + sx];
+                        }
+                    }
+                }
+
+                input[ch * span * span + r * span + c] = value;
+            }
+        }
+    }
+}
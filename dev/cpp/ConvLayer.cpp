@@ -56,6 +56,11 @@ void ConvLayer::init (int layerIndex) {
 
     errors = NetUtil::createVolume<double>(filters.size(), outMapSize, outMapSize, 0);
     activations = NetUtil::createVolume<double>(filters.size(), outMapSize, outMapSize, 0);
+
+    convAlgorithm = -1;
+    winogradStale = true;
+    winogradErrorStale = true;
+    fftStale = true;
 }
 
 void ConvLayer::forward (void) {
@@ -70,56 +75,117 @@ void ConvLayer::forward (void) {
         actvs = prevLayer->activations;
     }
 
-    for (int f=0; f<filters.size(); f++) {
+    int algorithm = NetUtil::getConvAlgorithm(this, actvs[0].size());
 
-        filters[f]->sumMap = NetUtil::convolve(actvs, zeroPadding, filterWeights[f], channels, stride, biases[f]);
+    // The Winograd, FFT and GEMM paths compute every filter's sum map in one go, with the filter transforms cached between weight updates
+    if (algorithm) {
 
-        for (int sumY=0; sumY<filters[f]->sumMap.size(); sumY++) {
-            for (int sumX=0; sumX<filters[f]->sumMap.size(); sumX++) {
+        std::vector<std::vector<std::vector<double> > > sumMaps;
 
-                if (net->dropout != 1) {
-                    filters[f]->dropoutMap[sumY][sumX] = (double) rand() / (RAND_MAX) > net->dropout;
-                }
+        if (algorithm==1) {
+            int tile = NetUtil::winogradTileSize(outMapSize);
 
-                if (net->dropout != 1 && net->isTraining && filters[f]->dropoutMap[sumY][sumX]) {
-                    activations[f][sumY][sumX] = 0;
+            if (winogradStale || winogradTile!=tile) {
+                winogradWeights = NetUtil::winogradFilters(filterWeights, tile, false);
+                winogradTile = tile;
+                winogradStale = false;
+            }
 
-                } else if (hasActivation) {
+            sumMaps = NetUtil::winogradConvolve(actvs, zeroPadding, winogradWeights, filters.size(), tile);
+        } else if (algorithm==2) {
+            sumMaps = NetUtil::fftConvolve(actvs, this);
+        } else {
+            sumMaps = NetUtil::gemmConvolve(actvs, this);
+        }
 
-                    activations[f][sumY][sumX] = activationC(filters[f]->sumMap[sumY][sumX], false, filters[f]) / net->dropout;
+        for (int f=0; f<filters.size(); f++) {
+            for (int r=0; r<sumMaps[f].size(); r++) {
+                for (int v=0; v<sumMaps[f].size(); v++) {
+                    sumMaps[f][r][v] += biases[f];
+                }
+            }
+            filters[f]->sumMap = sumMaps[f];
+        }
+    }
 
-                } else {
-                    activations[f][sumY][sumX] = filters[f]->sumMap[sumY][sumX];
+    // Drawn up front, in order, so the filters can be worked on in parallel
+    if (net->dropout != 1) {
+        for (int f=0; f<filters.size(); f++) {
+            for (int sumY=0; sumY<outMapSize; sumY++) {
+                for (int sumX=0; sumX<outMapSize; sumX++) {
+                    filters[f]->dropoutMap[sumY][sumX] = net->dropoutDraw(this) > net->dropout;
                 }
             }
         }
     }
+
+    double work = (double) filters.size() * outMapSize * outMapSize * (algorithm ? 1 : channels * filterSize * filterSize);
+
+    net->parallelFor(filters.size(), work, [&](int first, int last) {
+        for (int f=first; f<last; f++) {
+
+            if (!algorithm) {
+                filters[f]->sumMap = NetUtil::convolve(actvs, zeroPadding, filterWeights[f], channels, stride, biases[f]);
+            }
+
+            for (int sumY=0; sumY<filters[f]->sumMap.size(); sumY++) {
+                for (int sumX=0; sumX<filters[f]->sumMap.size(); sumX++) {
+
+                    if (net->dropout != 1 && net->isTraining && filters[f]->dropoutMap[sumY][sumX]) {
+                        activations[f][sumY][sumX] = 0;
+
+                    } else if (hasActivation) {
+
+                        activations[f][sumY][sumX] = activationC(filters[f]->sumMap[sumY][sumX], false, filters[f]) / net->dropout;
+
+                    } else {
+                        activations[f][sumY][sumX] = filters[f]->sumMap[sumY][sumX];
+                    }
+                }
+            }
+        }
+    });
 }
 
 void ConvLayer::backward (bool lastLayer) {
 
+    Network* net = Network::getInstance(netInstance);
+
     if (nextLayer->type == "FC") {
 
         // For each filter, build the errorMap from the weighted neuron errors in the next FCLayer corresponding to each value in the activation map
-        for (int f=0; f<filters.size(); f++) {
+        double work = (double) filters.size() * outMapSize * outMapSize * nextLayer->neurons.size();
 
-            for (int emY=0; emY<errors[f].size(); emY++) {
-                for (int emX=0; emX<errors[f].size(); emX++) {
+        // A pruned next layer scatters its errors through its surviving weights only, up front
+        std::vector<double> sparseWeightedErrors;
 
-                    int weightI = f * outMapSize*outMapSize + emY * errors[f].size() + emX;
+        if (nextLayer->pruned) {
+            sparseWeightedErrors = static_cast<FCLayer*>(nextLayer)->sparseWeightedErrors();
+        }
+
+        net->parallelFor(filters.size(), work, [&](int first, int last) {
+            for (int f=first; f<last; f++) {
+
+                for (int emY=0; emY<errors[f].size(); emY++) {
+                    for (int emX=0; emX<errors[f].size(); emX++) {
 
-                    for (int n=0; n < nextLayer->neurons.size(); n++) {
-                        errors[f][emY][emX] += nextLayer->errs[n] * nextLayer->weights[n][weightI];
+                        int weightI = f * outMapSize*outMapSize + emY * errors[f].size() + emX;
+
+                        if (nextLayer->pruned) {
+                            errors[f][emY][emX] += sparseWeightedErrors[weightI];
+                        } else {
+                            for (int n=0; n < nextLayer->neurons.size(); n++) {
+                                errors[f][emY][emX] += nextLayer->errs[n] * nextLayer->weights[n][weightI];
+                            }
+                        }
                     }
                 }
             }
-        }
+        });
 
     } else if (nextLayer->type == "Conv") {
 
-        for (int f=0; f<filters.size(); f++) {
-            errors[f] = NetUtil::buildConvErrorMap(outMapSize + nextLayer->zeroPadding*2, nextLayer, f);
-        }
+        errors = NetUtil::buildConvErrorMaps(outMapSize, nextLayer, filters.size());
 
     } else {
 
@@ -337,14 +403,22 @@ void ConvLayer::applyDeltaWeights (void) {
         net->maxNormTotal = sqrt(net->maxNormTotal);
         NetMath::maxNorm(netInstance);
     }
+
+    winogradStale = true;
+    winogradErrorStale = true;
+    fftStale = true;
 }
 
+// Like FCLayer's, assigning over the previous back-up reuses its rows, and restoring it swaps it in
 void ConvLayer::backUpValidation (void) {
     validationBiases = biases;
     validationFilterWeights = filterWeights;
 }
 
 void ConvLayer::restoreValidation (void) {
-    biases = validationBiases;
-    filterWeights = validationFilterWeights;
+    biases.swap(validationBiases);
+    filterWeights.swap(validationFilterWeights);
+    winogradStale = true;
+    winogradErrorStale = true;
+    fftStale = true;
 }
@@ -0,0 +1,95 @@
+
+// Copies a flat buffer of total values, sampleSize values per sample, in one go. With a classCount, each sample's
+// one expected value is its class index
+void Dataset::load (const float* buf, int total, int sampleSize, int dimension, int classCount) {
+
+    if (!sampleSize) {
+        return clear();
+    }
+
+    inputSize = dimension;
+    expectedSize = sampleSize - dimension;
+    stride = sampleSize;
+    classes = classCount;
+    shared.reset();
+    values.assign(buf, buf + total / sampleSize * sampleSize);
+}
+
+// Appends a sample. All samples need the same input and expected value counts as the first
+void Dataset::push_back (std::vector<double> input, std::vector<double> expected) {
+
+    if (!stride) {
+        inputSize = input.size();
+        expectedSize = expected.size();
+
+        // Samples with no values still take up one, to be counted
+        stride = std::max(inputSize + expectedSize, 1);
+    }
+
+    // Shared values are read-only, so appending takes a copy of them
+    if (shared) {
+        values = *shared;
+        shared.reset();
+    }
+
+    int start = values.size();
+    values.resize(start + stride, 0);
+    std::copy(input.begin(), input.end(), values.begin() + start);
+    std::copy(expected.begin(), expected.end(), values.begin() + start + inputSize);
+}
+
+// Appends a class index (label) sample. The classes count needs setting separately
+void Dataset::push_back (std::vector<double> input, int label) {
+    push_back(input, std::vector<double>({(double) label}));
+}
+
+int Dataset::size (void) {
+    return stride ? (shared ? shared->size() : values.size()) / stride : 0;
+}
+
+void Dataset::clear (void) {
+    values.clear();
+    shared.reset();
+    inputSize = 0;
+    expectedSize = 0;
+    stride = 0;
+    classes = 0;
+}
+
+// Moves the values into shared storage, so copies of the data set, such as other networks', read the same ones
+// instead of copying them
+void Dataset::share (void) {
+    if (!shared) {
+        shared = std::make_shared<std::vector<float> >(std::move(values));
+        values.clear();
+    }
+}
+
+float* Dataset::data (void) {
+    return shared ? shared->data() : values.data();
+}
+
+float* Dataset::input (int index) {
+    return data() + index * stride;
+}
+
+float* Dataset::expected (int index) {
+    return data() + index * stride + inputSize;
+}
+
+// The expected values, built as one-hot values for class index samples
+std::vector<double> Dataset::expectedValues (int index) {
+
+    if (classes) {
+        std::vector<double> oneHot(classes, 0);
+        oneHot[label(index)] = 1;
+        return oneHot;
+    }
+
+    return std::vector<double>(expected(index), expected(index) + expectedSize);
+}
+
+// A class index sample's class, or -1 for expected values samples
+int Dataset::label (int index) {
+    return classes ? (int) *expected(index) : -1;
+}
@@ -0,0 +1,88 @@
+
+int Ensemble::newEnsemble (std::vector<int> instances) {
+    Ensemble* ensemble = new Ensemble();
+    ensemble->networks = instances;
+    ensembleInstances.push_back(ensemble);
+    ensemble->instanceIndex = ensembleInstances.size()-1;
+    return ensemble->instanceIndex;
+}
+
+void Ensemble::deleteEnsemble (int index) {
+    delete ensembleInstances[index];
+    ensembleInstances[index] = 0;
+}
+
+Ensemble* Ensemble::getInstance (int index) {
+    return ensembleInstances[index];
+}
+
+// Runs every network over the count inputs, one network at a time on each thread, so each one's weights stay in cache
+// for the whole batch, and returns the combined outputs, outputSize values per input
+std::vector<double> Ensemble::forward (const float* inputs, int count) {
+
+    Network* first = Network::getInstance(networks[0]);
+    int inputSize = first->layers[0]->size;
+    int outputSize = first->layers[first->layers.size()-1]->size;
+
+    outputs.resize(networks.size());
+
+    auto runNetwork = [&](int n) {
+
+        Network* net = Network::getInstance(networks[n]);
+        Layer* inputLayer = net->layers[0];
+        Layer* outputLayer = net->layers[net->layers.size()-1];
+
+        inputLayer->actvns.resize(inputSize);
+        outputs[n].resize(count * outputSize);
+
+        for (int i=0; i<count; i++) {
+            std::copy(inputs + i*inputSize, inputs + (i+1)*inputSize, inputLayer->actvns.begin());
+            net->forwardLayers();
+            std::copy(outputLayer->actvns.begin(), outputLayer->actvns.end(), outputs[n].begin() + i*outputSize);
+        }
+    };
+
+    if (threads>1 && networks.size()>1) {
+        ThreadPool::shared(threads-1)->run(networks.size(), runNetwork);
+    } else {
+        for (int n=0; n<networks.size(); n++) {
+            runNetwork(n);
+        }
+    }
+
+    return combineOutputs(count, outputSize);
+}
+
+// Votes go to each network's highest output, and are returned as the share of the networks voting for each class
+std::vector<double> Ensemble::combineOutputs (int count, int outputSize) {
+
+    std::vector<double> combined(count * outputSize, 0);
+    double totalWeight = 0;
+
+    for (int n=0; n<outputs.size(); n++) {
+
+        double weight = combine==1 && n<weights.size() ? weights[n] : 1;
+        totalWeight += weight;
+
+        for (int i=0; i<count; i++) {
+
+            std::vector<double>::iterator output = outputs[n].begin() + i*outputSize;
+
+            if (combine==2) {
+                combined[i*outputSize + (std::max_element(output, output + outputSize) - output)] += weight;
+            } else {
+                for (int o=0; o<outputSize; o++) {
+                    combined[i*outputSize + o] += weight * output[o];
+                }
+            }
+        }
+    }
+
+    for (int v=0; v<combined.size(); v++) {
+        combined[v] /= totalWeight;
+    }
+
+    return combined;
+}
+
+std::vector<Ensemble*> Ensemble::ensembleInstances = {};
@@ -60,51 +60,67 @@ void FCLayer::forward (void) {
 
     Network* net = Network::getInstance(netInstance);
 
+    // Pruned layers read their inputs by column index, so volumes get flattened once, up front
+    std::vector<double> flatInput;
+    const std::vector<double>* input = &flatInput;
+
+    if (pruned) {
+        if (prevLayer->type == "FC") {
+            input = &prevLayer->actvns;
+        } else {
+            flatInput = NetUtil::flattenVolume(prevLayer->activations);
+        }
+    }
+
+    // Drawn up front, in order, so the neurons can be worked on in parallel
     for (int n=0; n<neurons.size(); n++) {
+        neurons[n]->dropped = net->dropoutDraw(this) > net->dropout;
+    }
 
-        neurons[n]->dropped = (double) rand() / (RAND_MAX) > net->dropout;
+    double work = pruned ? sparseColumns.size() : (double) neurons.size() * (weights.size() ? weights[0].size() : 0);
 
-        if (net->isTraining && neurons[n]->dropped) {
-            actvns[n] = 0;
+    net->parallelFor(neurons.size(), work, [&](int first, int last) {
+        for (int n=first; n<last; n++) {
 
-        } else {
-            sums[n] = biases[n];
+            if (net->isTraining && neurons[n]->dropped) {
+                actvns[n] = 0;
 
-            if (prevLayer->type == "FC") {
-                for (int pn=0; pn<prevLayer->neurons.size(); pn++) {
-                    sums[n] += prevLayer->actvns[pn] * weights[n][pn];
-                }
-            } else if (prevLayer->type == "Conv") {
+            } else {
+                sums[n] = biases[n];
 
-                for (int f=0; f<prevLayer->size; f++) {
-                    for (int y=0; y<prevLayer->outMapSize; y++) {
-                        for (int x=0; x<prevLayer->outMapSize; x++) {
-                            sums[n] += prevLayer->activations[f][y][x]
-                                * weights[n][f*prevLayer->outMapSize*prevLayer->outMapSize + y*prevLayer->outMapSize + x];
-                        }
+                if (pruned) {
+                    const int* columns = sparseColumns.data() + sparseRowStarts[n];
+
+                    for (int k=0; k<weights[n].size(); k++) {
+                        sums[n] += (*input)[columns[k]] * weights[n][k];
                     }
-                }
+                } else if (prevLayer->type == "FC") {
+                    sums[n] += NetMath::dot(prevLayer->actvns.data(), weights[n].data(), prevLayer->neurons.size());
 
-            } else {
-                for (int c=0; c<prevLayer->channels; c++) {
-                    for (int r=0; r<prevLayer->outMapSize; r++) {
-                        for (int v=0; v<prevLayer->outMapSize; v++) {
-                            sums[n] += prevLayer->activations[c][r][v] * weights[n][c * prevLayer->outMapSize * prevLayer->outMapSize + r * prevLayer->outMapSize + v ];
+                } else {
+                    int mapCount = prevLayer->type == "Conv" ? prevLayer->size : prevLayer->channels;
+
+                    for (int c=0; c<mapCount; c++) {
+                        for (int r=0; r<prevLayer->outMapSize; r++) {
+                            sums[n] += NetMath::dot(prevLayer->activations[c][r].data(),
+                                &weights[n][c * prevLayer->outMapSize * prevLayer->outMapSize + r * prevLayer->outMapSize], prevLayer->outMapSize);
                         }
                     }
                 }
-            }
 
-            if (hasActivation) {
-                actvns[n] = activation(sums[n], false, neurons[n]) / net->dropout;
-            } else {
-                actvns[n] = sums[n] / net->dropout;
+                if (hasActivation) {
+                    actvns[n] = activation(sums[n], false, neurons[n]) / net->dropout;
+                } else {
+                    actvns[n] = sums[n] / net->dropout;
+                }
             }
         }
-    }
+    });
 
     if (softmax) {
-        actvns = NetMath::softmax(actvns);
+        // Copied in place, so that the output buffer JS holds a view onto doesn't move
+        std::vector<double> softmaxActivations = NetMath::softmax(actvns);
+        std::copy(softmaxActivations.begin(), softmaxActivations.end(), actvns.begin());
     }
 }
 
@@ -112,51 +128,83 @@ void FCLayer::backward (bool lastLayer) {
 
     Network* net = Network::getInstance(netInstance);
 
-    for (int n=0; n<neurons.size(); n++) {
+    // When the next layer is pruned, scatter its errors through the surviving weights only
+    std::vector<double> sparseWeightedErrors;
+
+    if (!lastLayer && nextLayer->pruned) {
+        sparseWeightedErrors = static_cast<FCLayer*>(nextLayer)->sparseWeightedErrors();
+    }
 
-        if (neurons[n]->dropped) {
-            errs[n] = 0;
-            deltaBiases[n] = 0;
+    std::vector<double> flatInput;
+    const std::vector<double>* input = &flatInput;
 
+    if (pruned) {
+        if (prevLayer->type == "FC") {
+            input = &prevLayer->actvns;
         } else {
+            flatInput = NetUtil::flattenVolume(prevLayer->activations);
+        }
+    }
 
-            if (!lastLayer) {
-                if (hasActivation) {
-                    neurons[n]->derivative = activation(sums[n], true, neurons[n]);
-                } else {
-                    neurons[n]->derivative = 1;
-                }
+    // Each neuron only writes to its own errors and deltas
+    double work = (pruned ? (double) sparseColumns.size() : (double) neurons.size() * (weights.size() ? weights[0].size() : 0))
+        + neurons.size() * (lastLayer || nextLayer->pruned ? 0 : nextLayer->neurons.size());
 
-                double weightedErrors = 0.0;
+    net->parallelFor(neurons.size(), work, [&](int first, int last) {
+        for (int n=first; n<last; n++) {
 
-                for (int nn=0; nn<nextLayer->neurons.size(); nn++) {
-                    weightedErrors += nextLayer->errs[nn] * nextLayer->weights[nn][n];
-                }
+            if (neurons[n]->dropped) {
+                errs[n] = 0;
+                deltaBiases[n] = 0;
 
-                errs[n] = neurons[n]->derivative * weightedErrors;
-            }
+            } else {
 
-            if (prevLayer->type == "FC") {
-                for (int wi=0; wi<weights[n].size(); wi++) {
-                    deltaWeights[n][wi] += errs[n] * prevLayer->actvns[wi];
+                if (!lastLayer) {
+                    if (hasActivation) {
+                        neurons[n]->derivative = activation(sums[n], true, neurons[n]);
+                    } else {
+                        neurons[n]->derivative = 1;
+                    }
+
+                    double weightedErrors = 0.0;
+
+                    if (nextLayer->pruned) {
+                        weightedErrors = sparseWeightedErrors[n];
+                    } else {
+                        for (int nn=0; nn<nextLayer->neurons.size(); nn++) {
+                            weightedErrors += nextLayer->errs[nn] * nextLayer->weights[nn][n];
+                        }
+                    }
+
+                    errs[n] = neurons[n]->derivative * weightedErrors;
                 }
-            } else {
 
-                int counter = 0;
-                int span = prevLayer->activations[0].size();
+                if (pruned) {
+                    const int* columns = sparseColumns.data() + sparseRowStarts[n];
+
+                    for (int k=0; k<deltaWeights[n].size(); k++) {
+                        deltaWeights[n][k] += errs[n] * (*input)[columns[k]];
+                    }
+                } else if (prevLayer->type == "FC") {
+                    NetMath::axpy(errs[n], prevLayer->actvns.data(), deltaWeights[n].data(), weights[n].size());
+
+                } else {
+
+                    int counter = 0;
+                    int span = prevLayer->activations[0].size();
 
-                for (int c=0; c<prevLayer->activations.size(); c++) {
-                    for (int row=0; row<span; row++) {
-                        for (int col=0; col<span; col++) {
-                            deltaWeights[n][counter++] += errs[n] * prevLayer->activations[c][row][col];
+                    for (int c=0; c<prevLayer->activations.size(); c++) {
+                        for (int row=0; row<span; row++) {
+                            NetMath::axpy(errs[n], prevLayer->activations[c][row].data(), &deltaWeights[n][counter], span);
+                            counter += span;
                         }
                     }
                 }
-            }
 
-            deltaBiases[n] += errs[n];
+                deltaBiases[n] += errs[n];
+            }
         }
-    }
+    });
 }
 
 void FCLayer::resetDeltaWeights (void) {
@@ -164,7 +212,7 @@ void FCLayer::resetDeltaWeights (void) {
     deltaBiases = std::vector<double>(neurons.size(), 0);
 
     for (int n=0; n<neurons.size(); n++) {
-        deltaWeights[n] = std::vector<double>(weights[n].size(), 0);
+        std::fill(deltaWeights[n].begin(), deltaWeights[n].end(), 0);
     }
 }
 
@@ -173,6 +221,7 @@ void FCLayer::applyDeltaWeights (void) {
 
     Network* net = Network::getInstance(netInstance);
 
+    // Pruned layers' rows only hold their surviving weights, so they get updated just like dense ones
     for (int n=0; n<neurons.size(); n++) {
         for (int dw=0; dw<deltaWeights[n].size(); dw++) {
             if (net->l2) net->l2Error += 0.5 * net->l2 * pow(weights[n][dw], 2);
@@ -186,16 +235,11 @@ void FCLayer::applyDeltaWeights (void) {
     switch (net->updateFnIndex) {
         case 0: // vanilla
             for (int n=0; n<neurons.size(); n++) {
-                for (int dw=0; dw<deltaWeights[n].size(); dw++) {
-
-                    double regularized = (deltaWeights[n][dw]
-                        + net->l2 * weights[n][dw]
-                        + net->l1 * (weights[n][dw] > 0 ? 1 : -1)) / net->miniBatchSize;
 
-                    weights[n][dw] = NetMath::vanillasgd(netInstance, weights[n][dw], regularized);
+                double squares = NetMath::sgdUpdate(weights[n].data(), deltaWeights[n].data(), weights[n].size(),
+                    net->learningRate, net->l2, net->l1, net->miniBatchSize);
 
-                    if (net->maxNorm) net->maxNormTotal += weights[n][dw] * weights[n][dw];
-                }
+                if (net->maxNorm) net->maxNormTotal += squares;
                 biases[n] = NetMath::vanillasgd(netInstance, biases[n], deltaBiases[n]);
             }
             break;
@@ -297,31 +341,190 @@ void FCLayer::applyDeltaWeights (void) {
     }
 }
 
+// Assigning over the previous back-up copies into its existing rows, so only the first one allocates
 void FCLayer::backUpValidation (void) {
+    validationBiases = biases;
+    validationWeights = weights;
+}
+
+// The back-up gets swapped in, instead of copied, leaving the replaced values in its place, to be overwritten by the
+// next back-up. Back-ups from before pruning get packed down to the surviving weights when pruning
+void FCLayer::restoreValidation (void) {
+    weights.swap(validationWeights);
+    biases.swap(validationBiases);
+}
+
+// Keeps only the weights with a magnitude of at least the threshold, along with their deltas and optimizer state, so
+// the layer's memory shrinks with its sparsity. Pruning again starts over from the full rows, where the weights
+// pruned before are 0
+void FCLayer::prune (double threshold) {
+
+    if (pruned) {
+        densify();
+    }
+
+    std::vector<double> mask;
 
-    validationBiases = {};
-    validationWeights = {};
+    for (int n=0; n<neurons.size(); n++) {
+        for (int w=0; w<weights[n].size(); w++) {
+            mask.push_back(fabs(weights[n][w]) >= threshold);
+        }
+    }
+
+    pruneMask(mask.data());
+}
+
+// Keeps only the weights with a non 0 mask value, such as from exported parameters. The mask has a value per weight,
+// a row per neuron. The layer must not already be pruned
+void FCLayer::pruneMask (const double* mask) {
+
+    denseRowSize = weights.size() ? weights[0].size() : 0;
+    sparseRowStarts = {0};
+    sparseColumns = {};
 
     for (int n=0; n<neurons.size(); n++) {
-        validationBiases.push_back(biases[n]);
+        for (int w=0; w<denseRowSize; w++) {
+            if (mask[n*denseRowSize + w]) {
+                sparseColumns.push_back(w);
+            }
+        }
+        sparseRowStarts.push_back(sparseColumns.size());
+    }
+
+    pack();
+}
 
-        std::vector<double> neuron;
+void FCLayer::pruneToSparsity (float sparsity) {
 
+    if (pruned) {
+        densify();
+    }
+
+    std::vector<double> magnitudes;
+
+    for (int n=0; n<neurons.size(); n++) {
         for (int w=0; w<weights[n].size(); w++) {
-            neuron.push_back(weights[n][w]);
+            magnitudes.push_back(fabs(weights[n][w]));
         }
+    }
+
+    int prunedCount = floor(magnitudes.size() * sparsity);
+
+    if (!prunedCount) {
+        return prune(0);
+    }
 
-        validationWeights.push_back(neuron);
+    if (prunedCount >= magnitudes.size()) {
+        return prune(std::numeric_limits<double>::infinity());
     }
+
+    // The smallest surviving magnitude becomes the threshold
+    std::nth_element(magnitudes.begin(), magnitudes.begin()+prunedCount, magnitudes.end());
+    prune(magnitudes[prunedCount]);
 }
 
-void FCLayer::restoreValidation (void) {
+// Packs every full width row down to the values in the CSR index's columns
+void FCLayer::pack (void) {
+
+    auto packIfDense = [&](std::vector<double>& row, int n) {
+        if (row.size()==denseRowSize) {
+            row = packRow(row.data(), n);
+        }
+    };
 
     for (int n=0; n<neurons.size(); n++) {
-        biases[n] = validationBiases[n];
+        packIfDense(weights[n], n);
+        packIfDense(deltaWeights[n], n);
 
-        for (int w=0; w<weights[n].size(); w++) {
-            weights[n][w] = validationWeights[n][w];
+        if (n < validationWeights.size()) {
+            packIfDense(validationWeights[n], n);
         }
+
+        packIfDense(neurons[n]->weightGain, n);
+        packIfDense(neurons[n]->weightsCache, n);
+        packIfDense(neurons[n]->adadeltaCache, n);
+    }
+
+    pruned = true;
+}
+
+// Un-prunes the layer, scattering its rows back out to their full width. The pruned weights come back as 0, and
+// trainable again, with fresh optimizer state
+void FCLayer::densify (void) {
+
+    if (!pruned) {
+        return;
     }
+
+    Network* net = Network::getInstance(netInstance);
+
+    for (int n=0; n<neurons.size(); n++) {
+        weights[n] = expandRow(weights[n], n, 0);
+        deltaWeights[n] = expandRow(deltaWeights[n], n, 0);
+
+        if (n < validationWeights.size()) {
+            validationWeights[n] = expandRow(validationWeights[n], n, 0);
+        }
+
+        switch (net->updateFnIndex) {
+            case 1: // gain
+                neurons[n]->weightGain = expandRow(neurons[n]->weightGain, n, 1);
+                break;
+            case 2: // adagrad
+            case 3: // rmsprop
+            case 5: // adadelta
+            case 6: // momentum
+                neurons[n]->weightsCache = expandRow(neurons[n]->weightsCache, n, 0);
+
+                if (net->updateFnIndex == 5) {
+                    neurons[n]->adadeltaCache = expandRow(neurons[n]->adadeltaCache, n, 0);
+                }
+                break;
+        }
+    }
+
+    pruned = false;
+    sparseRowStarts.clear();
+    sparseColumns.clear();
+}
+
+// A neuron's row of pruned values, scattered out to the full width, with the fill value in the pruned columns
+std::vector<double> FCLayer::expandRow (const std::vector<double>& row, int n, double fill) {
+
+    std::vector<double> dense(denseRowSize, fill);
+
+    for (int k=0; k<row.size(); k++) {
+        dense[sparseColumns[sparseRowStarts[n] + k]] = row[k];
+    }
+
+    return dense;
+}
+
+// The values in a neuron's surviving columns, out of a full width row
+std::vector<double> FCLayer::packRow (const double* values, int n) {
+
+    std::vector<double> row(sparseRowStarts[n+1] - sparseRowStarts[n]);
+
+    for (int k=0; k<row.size(); k++) {
+        row[k] = values[sparseColumns[sparseRowStarts[n] + k]];
+    }
+
+    return row;
+}
+
+// The previous layer's errors, weighted through this pruned layer's surviving weights, scattered into their columns
+std::vector<double> FCLayer::sparseWeightedErrors (void) {
+
+    std::vector<double> weighted(denseRowSize, 0);
+
+    for (int n=0; n<neurons.size(); n++) {
+
+        const int* columns = sparseColumns.data() + sparseRowStarts[n];
+
+        for (int k=0; k<weights[n].size(); k++) {
+            weighted[columns[k]] += errs[n] * weights[n][k];
+        }
+    }
+
+    return weighted;
 }
@@ -68,6 +68,27 @@ double NetMath::crossentropy (std::vector<double> target, std::vector<double> ou
     return error;
 }
 
+// The same cost functions, against a class index, as if it were one-hot expected values
+double NetMath::meansquarederror (int label, const std::vector<double>& output) {
+    double error = 0.0;
+
+    for (int v=0; v<output.size(); v++) {
+        error += pow(output[v] - (v==label), 2);
+    }
+
+    return error / output.size();
+}
+
+double NetMath::crossentropy (int label, const std::vector<double>& output) {
+    double error = 0.0;
+
+    for (int v=0; v<output.size(); v++) {
+        error -= v==label ? log(output[v]+1e-15) : log(1+1e-15-output[v]);
+    }
+
+    return error;
+}
+
 // Weight update functions
 double NetMath::vanillasgd (int netInstance, double value, double deltaValue) {
     return value + Network::getInstance(netInstance)->learningRate * deltaValue;
@@ -420,3 +441,110 @@ void NetMath::maxNorm(int netInstance) {
 double NetMath::sech(double value) {
     return (2 * exp(-value)) / (1+exp(-2*value));
 }
+
+// Four independent sums, so that the loop vectorizes without needing -ffast-math. The SIMD128 build keeps the same
+// four sums, two per f64x2 lane pair, so both builds add things up in the same order
+JSNET_KERNEL double NetMath::dot (const double* a, const double* b, int n) {
+
+    double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    int i = 0;
+
+#ifdef __wasm_simd128__
+    v128_t sums01 = wasm_f64x2_splat(0);
+    v128_t sums23 = wasm_f64x2_splat(0);
+
+    for (; i+4<=n; i+=4) {
+        sums01 = wasm_f64x2_add(sums01, wasm_f64x2_mul(wasm_v128_load(a+i), wasm_v128_load(b+i)));
+        sums23 = wasm_f64x2_add(sums23, wasm_f64x2_mul(wasm_v128_load(a+i+2), wasm_v128_load(b+i+2)));
+    }
+
+    sum0 = wasm_f64x2_extract_lane(sums01, 0);
+    sum1 = wasm_f64x2_extract_lane(sums01, 1);
+    sum2 = wasm_f64x2_extract_lane(sums23, 0);
+    sum3 = wasm_f64x2_extract_lane(sums23, 1);
+#else
+    for (; i+4<=n; i+=4) {
+        sum0 += a[i] * b[i];
+        sum1 += a[i+1] * b[i+1];
+        sum2 += a[i+2] * b[i+2];
+        sum3 += a[i+3] * b[i+3];
+    }
+#endif
+
+    for (; i<n; i++) {
+        sum0 += a[i] * b[i];
+    }
+
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+// y += alpha * x
+JSNET_KERNEL void NetMath::axpy (double alpha, const double* x, double* y, int n) {
+
+    int i = 0;
+
+#ifdef __wasm_simd128__
+    v128_t alphas = wasm_f64x2_splat(alpha);
+
+    for (; i+2<=n; i+=2) {
+        wasm_v128_store(y+i, wasm_f64x2_add(wasm_v128_load(y+i), wasm_f64x2_mul(alphas, wasm_v128_load(x+i))));
+    }
+#endif
+
+    for (; i<n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// out += a * b, element-wise
+JSNET_KERNEL void NetMath::multiplyAccumulate (const double* a, const double* b, double* out, int n) {
+
+    int i = 0;
+
+#ifdef __wasm_simd128__
+    for (; i+2<=n; i+=2) {
+        wasm_v128_store(out+i, wasm_f64x2_add(wasm_v128_load(out+i), wasm_f64x2_mul(wasm_v128_load(a+i), wasm_v128_load(b+i))));
+    }
+#endif
+
+    for (; i<n; i++) {
+        out[i] += a[i] * b[i];
+    }
+}
+
+// Regularized vanilla SGD over a row of weights. Returns the sum of the squared new weights, for max norm
+JSNET_KERNEL double NetMath::sgdUpdate (double* values, const double* deltaValues, int n, double learningRate, double l2, double l1, int miniBatchSize) {
+
+    double squares = 0;
+    int i = 0;
+
+#ifdef __wasm_simd128__
+    const v128_t zeros = wasm_f64x2_splat(0);
+    const v128_t l1Positive = wasm_f64x2_splat(l1);
+    const v128_t l1Negative = wasm_f64x2_splat(-l1);
+    const v128_t l2s = wasm_f64x2_splat(l2);
+    const v128_t learningRates = wasm_f64x2_splat(learningRate);
+    const v128_t miniBatchSizes = wasm_f64x2_splat(miniBatchSize);
+    v128_t squareSums = zeros;
+
+    for (; i+2<=n; i+=2) {
+        v128_t vals = wasm_v128_load(values+i);
+        v128_t l1Term = wasm_v128_bitselect(l1Positive, l1Negative, wasm_f64x2_gt(vals, zeros));
+        v128_t regularized = wasm_f64x2_add(wasm_f64x2_add(wasm_v128_load(deltaValues+i), wasm_f64x2_mul(l2s, vals)), l1Term);
+
+        vals = wasm_f64x2_add(vals, wasm_f64x2_mul(learningRates, wasm_f64x2_div(regularized, miniBatchSizes)));
+        wasm_v128_store(values+i, vals);
+        squareSums = wasm_f64x2_add(squareSums, wasm_f64x2_mul(vals, vals));
+    }
+
+    squares = wasm_f64x2_extract_lane(squareSums, 0) + wasm_f64x2_extract_lane(squareSums, 1);
+#endif
+
+    for (; i<n; i++) {
+        double regularized = (deltaValues[i] + l2 * values[i] + l1 * (values[i] > 0 ? 1 : -1)) / miniBatchSize;
+        values[i] += learningRate * regularized;
+        squares += values[i] * values[i];
+    }
+
+    return squares;
+}
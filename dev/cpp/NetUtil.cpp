@@ -1,10 +1,9 @@
 
-void NetUtil::shuffle (std::vector<std::tuple<std::vector<double>, std::vector<double> > > &values) {
-    for (int i=values.size(); i; i--) {
-        int j = floor(rand() / RAND_MAX * i);
-        std::tuple<std::vector<double>, std::vector<double> > x = values[i-1];
-        values[i-1] = values[j];
-        values[j] = x;
+// Fisher-Yates shuffle, so that the same seed gives the same order
+void NetUtil::shuffle (std::vector<int>& indeces, std::mt19937& rng) {
+    for (int i=(int) indeces.size()-1; i>0; i--) {
+        int j = std::uniform_int_distribution<int>(0, i)(rng);
+        std::swap(indeces[i], indeces[j]);
     }
 }
 
@@ -212,45 +211,92 @@ std::vector<std::vector<double> > NetUtil::buildConvErrorMap (int paddedLength,
     return errorMap;
 }
 
+std::vector<std::vector<std::vector<double> > > NetUtil::buildConvErrorMaps (int mapSize, Layer* nextLayer, int channels) {
+
+    int algorithm = getConvAlgorithm(nextLayer, mapSize);
+
+    // Stride 1 error maps are the next layer's errors convolved with the 180 degree rotated weights,
+    // which can be done with the Winograd path, padded so that the output matches this layer's map size
+    if (algorithm==1) {
+
+        int tile = winogradTileSize(mapSize);
+
+        if (nextLayer->winogradErrorStale || nextLayer->winogradErrorTile!=tile) {
+            nextLayer->winogradErrorWeights = winogradFilters(nextLayer->filterWeights, tile, true);
+            nextLayer->winogradErrorTile = tile;
+            nextLayer->winogradErrorStale = false;
+        }
+
+        return winogradConvolve(nextLayer->errors, 2-nextLayer->zeroPadding, nextLayer->winogradErrorWeights, channels, tile);
+
+    } else if (algorithm==2) {
+        return fftConvErrorMaps(mapSize, nextLayer, channels);
+
+    } else if (algorithm==3) {
+        return gemmConvErrorMaps(mapSize, nextLayer, channels);
+    }
+
+    std::vector<std::vector<std::vector<double> > > errorMaps;
+
+    for (int c=0; c<channels; c++) {
+        errorMaps.push_back(buildConvErrorMap(mapSize + nextLayer->zeroPadding*2, nextLayer, c));
+    }
+
+    return errorMaps;
+}
+
 void NetUtil::buildConvDWeights (ConvLayer* layer) {
 
+    int algorithm = getConvAlgorithm(layer, sqrt(layer->inMapValuesCount));
+
+    if (algorithm==2) {
+        fftConvDWeights(layer);
+        return;
+    } else if (algorithm==3) {
+        gemmConvDWeights(layer);
+        return;
+    }
+
     int weightsCount = layer->filterWeights[0][0].size();
     int fsSpread = floor(weightsCount / 2);
     int channelsCount = layer->filterWeights[0].size();
+    double work = (double) layer->filters.size() * channelsCount * layer->inMapValuesCount * weightsCount * weightsCount;
 
-    // For each filter
-    for (int f=0; f<layer->filters.size(); f++) {
+    // For each filter, each only writing to its own deltas
+    Network::getInstance(layer->netInstance)->parallelFor(layer->filters.size(), work, [&](int first, int last) {
+        for (int f=first; f<last; f++) {
 
-        // Each channel will take the error map and the corresponding inputMap from the input...
-        for (int c=0; c<channelsCount; c++) {
+            // Each channel will take the error map and the corresponding inputMap from the input...
+            for (int c=0; c<channelsCount; c++) {
 
-            std::vector<double> inputValues = NetUtil::getActivations(layer->prevLayer, c, layer->inMapValuesCount);
-            std::vector<std::vector<double> > inputMap = NetUtil::addZeroPadding(NetUtil::arrayToMap(inputValues, sqrt(layer->inMapValuesCount)), layer->zeroPadding);
+                std::vector<double> inputValues = NetUtil::getActivations(layer->prevLayer, c, layer->inMapValuesCount);
+                std::vector<std::vector<double> > inputMap = NetUtil::addZeroPadding(NetUtil::arrayToMap(inputValues, sqrt(layer->inMapValuesCount)), layer->zeroPadding);
 
-            // ...slide the filter with correct stride across the zero-padded inputMap...
-            for (int inY=fsSpread; inY<inputMap.size()-fsSpread; inY+= layer->stride) {
-                for (int inX=fsSpread; inX<inputMap.size()-fsSpread; inX+= layer->stride) {
+                // ...slide the filter with correct stride across the zero-padded inputMap...
+                for (int inY=fsSpread; inY<inputMap.size()-fsSpread; inY+= layer->stride) {
+                    for (int inX=fsSpread; inX<inputMap.size()-fsSpread; inX+= layer->stride) {
 
-                    double error = layer->errors[f][(inY-fsSpread)/layer->stride][(inX-fsSpread)/layer->stride];
+                        double error = layer->errors[f][(inY-fsSpread)/layer->stride][(inX-fsSpread)/layer->stride];
 
-                    // ...and at each location...
-                    for (int wY=0; wY<weightsCount; wY++) {
-                        for (int wX=0; wX<weightsCount; wX++) {
-                            // activation * error
-                            layer->filterDeltaWeights[f][c][wY][wX] += inputMap[inY-fsSpread+wY][inX-fsSpread+wX] * error;
+                        // ...and at each location...
+                        for (int wY=0; wY<weightsCount; wY++) {
+                            for (int wX=0; wX<weightsCount; wX++) {
+                                // activation * error
+                                layer->filterDeltaWeights[f][c][wY][wX] += inputMap[inY-fsSpread+wY][inX-fsSpread+wX] * error;
+                            }
                         }
                     }
                 }
             }
-        }
 
-        // Increment the deltaBias by the sum of all errors in the filter
-        for (int eY=0; eY<layer->errors[f].size(); eY++) {
-            for (int eX=0; eX<layer->errors[f].size(); eX++) {
-                layer->deltaBiases[f] += layer->errors[f][eY][eX];
+            // Increment the deltaBias by the sum of all errors in the filter
+            for (int eY=0; eY<layer->errors[f].size(); eY++) {
+                for (int eX=0; eX<layer->errors[f].size(); eX++) {
+                    layer->deltaBiases[f] += layer->errors[f][eY][eX];
+                }
             }
         }
-    }
+    });
 }
 
 std::vector<double> NetUtil::getActivations (Layer* layer, int mapStartI, int mapSize) {
@@ -282,4 +328,790 @@ std::vector<double> NetUtil::getActivations (Layer* layer, int mapStartI, int ma
     }
 
     return activations;
-}
\ No newline at end of file
+}
+
+std::vector<double> NetUtil::flattenVolume (const std::vector<std::vector<std::vector<double> > > &volume) {
+
+    std::vector<double> values;
+
+    for (int d=0; d<volume.size(); d++) {
+        for (int r=0; r<volume[d].size(); r++) {
+            values.insert(values.end(), volume[d][r].begin(), volume[d][r].end());
+        }
+    }
+
+    return values;
+}
+
+// Winograd minimal filtering matrices, for F(2x2, 3x3) and F(4x4, 3x3)
+static const double winogradBT2[16] = {
+    1,  0, -1,  0,
+    0,  1,  1,  0,
+    0, -1,  1,  0,
+    0,  1,  0, -1
+};
+static const double winogradG2[12] = {
+    1,    0,   0,
+    0.5,  0.5, 0.5,
+    0.5, -0.5, 0.5,
+    0,    0,   1
+};
+static const double winogradAT2[8] = {
+    1, 1,  1,  0,
+    0, 1, -1, -1
+};
+static const double winogradBT4[36] = {
+    4,  0, -5,  0, 1, 0,
+    0, -4, -4,  1, 1, 0,
+    0,  4, -4, -1, 1, 0,
+    0, -2, -1,  2, 1, 0,
+    0,  2, -1, -2, 1, 0,
+    0,  4,  0, -5, 0, 1
+};
+static const double winogradG4[18] = {
+     1.0/4,       0,      0,
+    -1.0/6, -1.0/6, -1.0/6,
+    -1.0/6,  1.0/6, -1.0/6,
+    1.0/24, 1.0/12,  1.0/6,
+    1.0/24,-1.0/12,  1.0/6,
+         0,      0,      1
+};
+static const double winogradAT4[24] = {
+    1, 1,  1, 1,  1, 0,
+    0, 1, -1, 2, -2, 0,
+    0, 1,  1, 4,  4, 0,
+    0, 1, -1, 8, -8, 1
+};
+
+int NetUtil::winogradTileSize (int outSize) {
+    // F(4x4, 3x3) does fewer multiplies, but wastes more of them on the edge tiles of small maps
+    return outSize >= 8 ? 4 : 2;
+}
+
+// out = transform * values * transform^T, where transform is rows x columns, and values is columns x columns
+void NetUtil::winogradTransform (const double* transform, int rows, int columns, const double* values, double* out) {
+
+    double temp[6*6];
+
+    for (int r=0; r<rows; r++) {
+        for (int c=0; c<columns; c++) {
+            double sum = 0;
+            for (int k=0; k<columns; k++) {
+                sum += transform[r*columns+k] * values[k*columns+c];
+            }
+            temp[r*columns+c] = sum;
+        }
+    }
+
+    for (int r=0; r<rows; r++) {
+        for (int c=0; c<rows; c++) {
+            double sum = 0;
+            for (int k=0; k<columns; k++) {
+                sum += temp[r*columns+k] * transform[c*columns+k];
+            }
+            out[r*rows+c] = sum;
+        }
+    }
+}
+
+std::vector<double> NetUtil::winogradFilters (const std::vector<std::vector<std::vector<std::vector<double> > > > &weights, int tile, bool rotate) {
+
+    int t = tile+2;
+    int filtersCount = weights.size();
+    int channelsCount = filtersCount ? weights[0].size() : 0;
+    int inMaps = rotate ? filtersCount : channelsCount;
+    const double* G = tile==4 ? winogradG4 : winogradG2;
+
+    std::vector<double> transformed(filtersCount * channelsCount * t*t);
+    double g[9];
+
+    for (int f=0; f<filtersCount; f++) {
+        for (int c=0; c<channelsCount; c++) {
+
+            // The input gradient needs the weights rotated by 180 degrees, and the filters/channels swapped around
+            for (int r=0; r<3; r++) {
+                for (int v=0; v<3; v++) {
+                    g[r*3+v] = rotate ? weights[f][c][2-r][2-v] : weights[f][c][r][v];
+                }
+            }
+
+            int outMap = rotate ? c : f;
+            int inMap = rotate ? f : c;
+
+            winogradTransform(G, t, 3, g, &transformed[(outMap*inMaps + inMap) * t*t]);
+        }
+    }
+
+    return transformed;
+}
+
+std::vector<std::vector<std::vector<double> > > NetUtil::winogradConvolve (const std::vector<std::vector<std::vector<double> > > &input, int zP,
+    const std::vector<double> &filters, int outMaps, int tile) {
+
+    int t = tile+2;
+    int tt = t*t;
+    int inMaps = filters.size() / (outMaps*tt);
+    int inSize = input[0].size();
+    int outSize = inSize + 2*zP - 2;
+    int tiles = (outSize + tile-1) / tile;
+    const double* BT = tile==4 ? winogradBT4 : winogradBT2;
+    const double* AT = tile==4 ? winogradAT4 : winogradAT2;
+
+    std::vector<std::vector<std::vector<double> > > output = createVolume<double>(outMaps, outSize, outSize, 0);
+
+    // Transform every (overlapping) input tile, once
+    std::vector<double> transformedInput(tiles*tiles * inMaps * tt);
+    double d[6*6];
+
+    for (int i=0; i<inMaps; i++) {
+        for (int tY=0; tY<tiles; tY++) {
+            for (int tX=0; tX<tiles; tX++) {
+
+                for (int r=0; r<t; r++) {
+
+                    int inputY = tY*tile - zP + r;
+
+                    for (int c=0; c<t; c++) {
+
+                        int inputX = tX*tile - zP + c;
+
+                        if (inputY>=0 && inputY<inSize && inputX>=0 && inputX<inSize) {
+                            d[r*t+c] = input[i][inputY][inputX];
+                        } else {
+                            d[r*t+c] = 0;
+                        }
+                    }
+                }
+
+                winogradTransform(BT, t, t, d, &transformedInput[((tY*tiles + tX)*inMaps + i) * tt]);
+            }
+        }
+    }
+
+    // Element-wise products, summed across the input maps, then transformed back into output tiles
+    double m[6*6];
+    double y[4*4];
+
+    for (int o=0; o<outMaps; o++) {
+        for (int tY=0; tY<tiles; tY++) {
+            for (int tX=0; tX<tiles; tX++) {
+
+                for (int k=0; k<tt; k++) {
+                    m[k] = 0;
+                }
+
+                for (int i=0; i<inMaps; i++) {
+
+                    const double* u = &filters[(o*inMaps + i) * tt];
+                    const double* v = &transformedInput[((tY*tiles + tX)*inMaps + i) * tt];
+
+                    NetMath::multiplyAccumulate(u, v, m, tt);
+                }
+
+                winogradTransform(AT, tile, t, m, y);
+
+                for (int r=0; r<tile && tY*tile+r<outSize; r++) {
+                    for (int c=0; c<tile && tX*tile+c<outSize; c++) {
+                        output[o][tY*tile+r][tX*tile+c] = y[r*tile+c];
+                    }
+                }
+            }
+        }
+    }
+
+    return output;
+}
+
+// Estimates the multiplications needed by each convolution algorithm, for a layer's shape, and picks the cheapest
+int NetUtil::pickConvAlgorithm (int filters, int channels, int filterSize, int stride, int zeroPadding, int inSize) {
+
+    int outSize = (inSize - filterSize + 2*zeroPadding) / stride + 1;
+    int algorithm = 0;
+    double best = (double) filters * channels * outSize*outSize * filterSize*filterSize;
+
+    if (filterSize==3 && stride==1 && zeroPadding<=2) {
+        int tile = winogradTileSize(outSize);
+        int tiles = (outSize + tile-1) / tile;
+        double winograd = (double) filters * channels * tiles*tiles * (tile+2)*(tile+2);
+
+        if (winograd < best) {
+            best = winograd;
+            algorithm = 1;
+        }
+    }
+
+    if (stride==1 && zeroPadding<filterSize) {
+        int n = fftGridSize(inSize + 2*zeroPadding);
+
+        // Complex multiplies (4 real ones) for the input and output transforms, and the spectra products
+        double fft = (double) (filters + channels) * 4*n*n * log2(n) + (double) filters * channels * 4*n*n;
+
+        if (fft < best) {
+            best = fft;
+            algorithm = 2;
+        }
+    }
+
+    return algorithm;
+}
+
+int NetUtil::getConvAlgorithm (Layer* layer, int inSize) {
+
+    int filterSize = layer->filterSize;
+    int stride = layer->stride;
+    int zeroPadding = layer->zeroPadding;
+
+    if (layer->convAlgorithm < 0) {
+        int channelsCount = layer->filterWeights.size() ? layer->filterWeights[0].size() : 0;
+        layer->convAlgorithm = pickConvAlgorithm(layer->filterWeights.size(), channelsCount, filterSize, stride, zeroPadding, inSize);
+    }
+
+    // Fall back to the direct path, for shapes which an explicitly set algorithm does not support
+    if (layer->convAlgorithm==1 && !(filterSize==3 && stride==1 && zeroPadding<=2)) {
+        return 0;
+    }
+    if (layer->convAlgorithm==2 && !(stride==1 && zeroPadding<filterSize)) {
+        return 0;
+    }
+
+    return layer->convAlgorithm;
+}
+
+int NetUtil::fftGridSize (int size) {
+    int n = 1;
+    while (n < size) {
+        n <<= 1;
+    }
+    return n;
+}
+
+// In-place, iterative radix-2 FFT, over n values spaced step apart. The inverse is not scaled
+void NetUtil::fft (std::complex<double>* values, int n, int step, bool inverse) {
+
+    // Bit reversed ordering
+    for (int i=1, j=0; i<n; i++) {
+        int bit = n >> 1;
+
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+
+        if (i < j) {
+            std::swap(values[i*step], values[j*step]);
+        }
+    }
+
+    for (int length=2; length<=n; length<<=1) {
+
+        double angle = 2 * 3.14159265358979323846 / length * (inverse ? 1 : -1);
+        std::complex<double> rootOfUnity(cos(angle), sin(angle));
+
+        for (int i=0; i<n; i+=length) {
+
+            std::complex<double> twiddle(1, 0);
+
+            for (int k=0; k<length/2; k++) {
+                std::complex<double> even = values[(i+k)*step];
+                std::complex<double> odd = values[(i+k+length/2)*step] * twiddle;
+
+                values[(i+k)*step] = even + odd;
+                values[(i+k+length/2)*step] = even - odd;
+                twiddle *= rootOfUnity;
+            }
+        }
+    }
+}
+
+void NetUtil::fft2D (std::vector<std::complex<double> > &values, int n, bool inverse) {
+
+    for (int r=0; r<n; r++) {
+        fft(&values[r*n], n, 1, inverse);
+    }
+
+    for (int c=0; c<n; c++) {
+        fft(&values[c], n, n, inverse);
+    }
+
+    if (inverse) {
+        for (int i=0; i<n*n; i++) {
+            values[i] /= n*n;
+        }
+    }
+}
+
+// Spectrum of a map placed offset values down and right into an n x n grid of zeroes
+std::vector<std::complex<double> > NetUtil::mapSpectrum (const std::vector<std::vector<double> > &map, int n, int offset) {
+
+    std::vector<std::complex<double> > values(n*n);
+
+    for (int r=0; r<map.size(); r++) {
+        for (int c=0; c<map[r].size(); c++) {
+            values[(r+offset)*n + c+offset] = map[r][c];
+        }
+    }
+
+    fft2D(values, n, false);
+
+    return values;
+}
+
+void NetUtil::updateFFTWeights (Layer* layer, int n) {
+
+    if (!layer->fftStale && layer->fftSize==n) {
+        return;
+    }
+
+    layer->fftWeights.clear();
+
+    for (int f=0; f<layer->filterWeights.size(); f++) {
+        for (int c=0; c<layer->filterWeights[f].size(); c++) {
+            layer->fftWeights.push_back(mapSpectrum(layer->filterWeights[f][c], n, 0));
+        }
+    }
+
+    layer->fftSize = n;
+    layer->fftStale = false;
+}
+
+// Forward pass sum maps (without biases). Correlation is a product with the conjugated filter spectra
+std::vector<std::vector<std::vector<double> > > NetUtil::fftConvolve (const std::vector<std::vector<std::vector<double> > > &input, Layer* layer) {
+
+    int filtersCount = layer->filterWeights.size();
+    int channelsCount = layer->filterWeights[0].size();
+    int zP = layer->zeroPadding;
+    int inSize = input[0].size();
+    int outSize = inSize + 2*zP - layer->filterSize + 1;
+    int n = fftGridSize(inSize + 2*zP);
+
+    updateFFTWeights(layer, n);
+
+    std::vector<std::vector<std::complex<double> > > inputSpectra;
+
+    for (int c=0; c<channelsCount; c++) {
+        inputSpectra.push_back(mapSpectrum(input[c], n, zP));
+    }
+
+    std::vector<std::vector<std::vector<double> > > output = createVolume<double>(filtersCount, outSize, outSize, 0);
+    std::vector<std::complex<double> > sum(n*n);
+
+    for (int f=0; f<filtersCount; f++) {
+
+        std::fill(sum.begin(), sum.end(), 0);
+
+        for (int c=0; c<channelsCount; c++) {
+
+            const std::vector<std::complex<double> > &weights = layer->fftWeights[f*channelsCount + c];
+
+            for (int i=0; i<n*n; i++) {
+                sum[i] += inputSpectra[c][i] * std::conj(weights[i]);
+            }
+        }
+
+        fft2D(sum, n, true);
+
+        for (int r=0; r<outSize; r++) {
+            for (int v=0; v<outSize; v++) {
+                output[f][r][v] = sum[r*n + v].real();
+            }
+        }
+    }
+
+    return output;
+}
+
+// Error maps are the full convolution of the next layer's errors with its weights, with the zero padding cropped off
+std::vector<std::vector<std::vector<double> > > NetUtil::fftConvErrorMaps (int mapSize, Layer* nextLayer, int channels) {
+
+    int filtersCount = nextLayer->filterWeights.size();
+    int zP = nextLayer->zeroPadding;
+    int n = fftGridSize(mapSize + 2*zP);
+
+    updateFFTWeights(nextLayer, n);
+
+    std::vector<std::vector<std::complex<double> > > errorSpectra;
+
+    for (int f=0; f<filtersCount; f++) {
+        errorSpectra.push_back(mapSpectrum(nextLayer->errors[f], n, 0));
+    }
+
+    std::vector<std::vector<std::vector<double> > > errorMaps = createVolume<double>(channels, mapSize, mapSize, 0);
+    std::vector<std::complex<double> > sum(n*n);
+
+    for (int c=0; c<channels; c++) {
+
+        std::fill(sum.begin(), sum.end(), 0);
+
+        for (int f=0; f<filtersCount; f++) {
+
+            const std::vector<std::complex<double> > &weights = nextLayer->fftWeights[f*channels + c];
+
+            for (int i=0; i<n*n; i++) {
+                sum[i] += errorSpectra[f][i] * weights[i];
+            }
+        }
+
+        fft2D(sum, n, true);
+
+        for (int r=0; r<mapSize; r++) {
+            for (int v=0; v<mapSize; v++) {
+                errorMaps[c][r][v] = sum[(r+zP)*n + v+zP].real();
+            }
+        }
+    }
+
+    return errorMaps;
+}
+
+// Delta weights are the correlation of the zero padded input maps with the error maps
+void NetUtil::fftConvDWeights (ConvLayer* layer) {
+
+    int channelsCount = layer->filterWeights[0].size();
+    int filterSize = layer->filterWeights[0][0].size();
+    int zP = layer->zeroPadding;
+    int inSize = sqrt(layer->inMapValuesCount);
+    int n = fftGridSize(inSize + 2*zP);
+
+    std::vector<std::vector<std::complex<double> > > inputSpectra;
+
+    for (int c=0; c<channelsCount; c++) {
+        std::vector<double> inputValues = getActivations(layer->prevLayer, c, layer->inMapValuesCount);
+        inputSpectra.push_back(mapSpectrum(arrayToMap(inputValues, inSize), n, zP));
+    }
+
+    std::vector<std::complex<double> > product(n*n);
+
+    for (int f=0; f<layer->filters.size(); f++) {
+
+        std::vector<std::complex<double> > errorSpectrum = mapSpectrum(layer->errors[f], n, 0);
+
+        for (int c=0; c<channelsCount; c++) {
+
+            for (int i=0; i<n*n; i++) {
+                product[i] = inputSpectra[c][i] * std::conj(errorSpectrum[i]);
+            }
+
+            fft2D(product, n, true);
+
+            for (int r=0; r<filterSize; r++) {
+                for (int v=0; v<filterSize; v++) {
+                    layer->filterDeltaWeights[f][c][r][v] += product[r*n + v].real();
+                }
+            }
+        }
+
+        for (int eY=0; eY<layer->errors[f].size(); eY++) {
+            for (int eX=0; eX<layer->errors[f].size(); eX++) {
+                layer->deltaBiases[f] += layer->errors[f][eY][eX];
+            }
+        }
+    }
+}
+
+// c (m x n) += op(a) (m x k) * op(b) (k x n), all row major
+void NetUtil::gemm (const double* a, const double* b, double* c, int m, int n, int k, bool transposeA, bool transposeB) {
+
+    if (transposeB) {
+        for (int i=0; i<m; i++) {
+            for (int j=0; j<n; j++) {
+                if (transposeA) {
+                    double sum = 0;
+                    for (int p=0; p<k; p++) {
+                        sum += a[p*m + i] * b[j*k + p];
+                    }
+                    c[i*n + j] += sum;
+                } else {
+                    c[i*n + j] += NetMath::dot(&a[i*k], &b[j*k], k);
+                }
+            }
+        }
+        return;
+    }
+
+    for (int i=0; i<m; i++) {
+        for (int p=0; p<k; p++) {
+            NetMath::axpy(transposeA ? a[p*m + i] : a[i*k + p], &b[p*n], &c[i*n], n);
+        }
+    }
+}
+
+// Unrolls every (zero padded) input patch into a column, giving a (channels*filterSize*filterSize) x (outSize*outSize) matrix
+std::vector<double> NetUtil::im2col (const std::vector<std::vector<std::vector<double> > > &input, int filterSize, int zP, int stride) {
+
+    int channelsCount = input.size();
+    int inSize = input[0].size();
+    int outSize = (inSize - filterSize + 2*zP) / stride + 1;
+    int columns = outSize*outSize;
+
+    std::vector<double> matrix(channelsCount * filterSize*filterSize * columns, 0);
+
+    for (int c=0; c<channelsCount; c++) {
+        for (int wY=0; wY<filterSize; wY++) {
+            for (int wX=0; wX<filterSize; wX++) {
+
+                double* row = &matrix[((c*filterSize + wY)*filterSize + wX) * columns];
+
+                for (int outY=0; outY<outSize; outY++) {
+
+                    int inputY = outY*stride - zP + wY;
+
+                    if (inputY<0 || inputY>=inSize) {
+                        continue;
+                    }
+
+                    for (int outX=0; outX<outSize; outX++) {
+
+                        int inputX = outX*stride - zP + wX;
+
+                        if (inputX>=0 && inputX<inSize) {
+                            row[outY*outSize + outX] = input[c][inputY][inputX];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return matrix;
+}
+
+std::vector<double> NetUtil::flattenFilters (const std::vector<std::vector<std::vector<std::vector<double> > > > &weights) {
+
+    std::vector<double> values;
+
+    for (int f=0; f<weights.size(); f++) {
+        std::vector<double> filter = flattenVolume(weights[f]);
+        values.insert(values.end(), filter.begin(), filter.end());
+    }
+
+    return values;
+}
+
+// Forward pass sum maps (without biases), as a single (filters) x (channels*filterSize*filterSize) x (outSize*outSize) GEMM
+std::vector<std::vector<std::vector<double> > > NetUtil::gemmConvolve (const std::vector<std::vector<std::vector<double> > > &input, Layer* layer) {
+
+    int filtersCount = layer->filterWeights.size();
+    int channelsCount = layer->filterWeights[0].size();
+    int filterSize = layer->filterSize;
+    int outSize = (input[0].size() - filterSize + 2*layer->zeroPadding) / layer->stride + 1;
+    int patchSize = channelsCount * filterSize*filterSize;
+
+    std::vector<std::vector<std::vector<double> > > channelsInput(input.begin(), input.begin()+channelsCount);
+    std::vector<double> columns = im2col(channelsInput, filterSize, layer->zeroPadding, layer->stride);
+    std::vector<double> weights = flattenFilters(layer->filterWeights);
+    std::vector<double> sums(filtersCount * outSize*outSize, 0);
+
+    gemm(&weights[0], &columns[0], &sums[0], filtersCount, outSize*outSize, patchSize, false, false);
+
+    std::vector<std::vector<std::vector<double> > > output = createVolume<double>(filtersCount, outSize, outSize, 0);
+
+    for (int f=0; f<filtersCount; f++) {
+        for (int r=0; r<outSize; r++) {
+            for (int v=0; v<outSize; v++) {
+                output[f][r][v] = sums[(f*outSize + r)*outSize + v];
+            }
+        }
+    }
+
+    return output;
+}
+
+// The error columns are the transposed weights times the next layer's errors, scattered back (col2im) onto the input maps
+std::vector<std::vector<std::vector<double> > > NetUtil::gemmConvErrorMaps (int mapSize, Layer* nextLayer, int channels) {
+
+    int filtersCount = nextLayer->filterWeights.size();
+    int filterSize = nextLayer->filterSize;
+    int zP = nextLayer->zeroPadding;
+    int stride = nextLayer->stride;
+    int outSize = (mapSize - filterSize + 2*zP) / stride + 1;
+    int columnsCount = outSize*outSize;
+    int patchSize = channels * filterSize*filterSize;
+
+    std::vector<double> weights = flattenFilters(nextLayer->filterWeights);
+    std::vector<double> errors;
+
+    for (int f=0; f<filtersCount; f++) {
+        for (int r=0; r<outSize; r++) {
+            errors.insert(errors.end(), nextLayer->errors[f][r].begin(), nextLayer->errors[f][r].begin()+outSize);
+        }
+    }
+
+    std::vector<double> columns(patchSize * columnsCount, 0);
+
+    gemm(&weights[0], &errors[0], &columns[0], patchSize, columnsCount, filtersCount, true, false);
+
+    std::vector<std::vector<std::vector<double> > > errorMaps = createVolume<double>(channels, mapSize, mapSize, 0);
+
+    for (int c=0; c<channels; c++) {
+        for (int wY=0; wY<filterSize; wY++) {
+            for (int wX=0; wX<filterSize; wX++) {
+
+                const double* row = &columns[((c*filterSize + wY)*filterSize + wX) * columnsCount];
+
+                for (int outY=0; outY<outSize; outY++) {
+
+                    int inputY = outY*stride - zP + wY;
+
+                    if (inputY<0 || inputY>=mapSize) {
+                        continue;
+                    }
+
+                    for (int outX=0; outX<outSize; outX++) {
+
+                        int inputX = outX*stride - zP + wX;
+
+                        if (inputX>=0 && inputX<mapSize) {
+                            errorMaps[c][inputY][inputX] += row[outY*outSize + outX];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return errorMaps;
+}
+
+// Delta weights are the errors times the transposed input columns
+void NetUtil::gemmConvDWeights (ConvLayer* layer) {
+
+    int filtersCount = layer->filters.size();
+    int channelsCount = layer->filterWeights[0].size();
+    int filterSize = layer->filterWeights[0][0].size();
+    int inSize = sqrt(layer->inMapValuesCount);
+    int outSize = layer->errors[0].size();
+    int patchSize = channelsCount * filterSize*filterSize;
+
+    std::vector<std::vector<std::vector<double> > > input;
+
+    for (int c=0; c<channelsCount; c++) {
+        input.push_back(arrayToMap(getActivations(layer->prevLayer, c, layer->inMapValuesCount), inSize));
+    }
+
+    std::vector<double> columns = im2col(input, filterSize, layer->zeroPadding, layer->stride);
+    std::vector<double> errors;
+
+    for (int f=0; f<filtersCount; f++) {
+        for (int r=0; r<outSize; r++) {
+            errors.insert(errors.end(), layer->errors[f][r].begin(), layer->errors[f][r].end());
+        }
+    }
+
+    std::vector<double> deltaWeights(filtersCount * patchSize, 0);
+
+    gemm(&errors[0], &columns[0], &deltaWeights[0], filtersCount, patchSize, outSize*outSize, false, true);
+
+    for (int f=0; f<filtersCount; f++) {
+        for (int c=0; c<channelsCount; c++) {
+            for (int r=0; r<filterSize; r++) {
+                for (int v=0; v<filterSize; v++) {
+                    layer->filterDeltaWeights[f][c][r][v] += deltaWeights[f*patchSize + (c*filterSize + r)*filterSize + v];
+                }
+            }
+        }
+
+        for (int eY=0; eY<outSize; eY++) {
+            for (int eX=0; eX<outSize; eX++) {
+                layer->deltaBiases[f] += layer->errors[f][eY][eX];
+            }
+        }
+    }
+}
+
+// Times every convolution algorithm supported by the layer's shape, on its real inputs, and returns the fastest.
+// The layer is left as it was found, and no random numbers get drawn, so tuning doesn't change what training does next
+int NetUtil::benchmarkConvAlgorithms (ConvLayer* layer, int iterations) {
+
+    Network* net = Network::getInstance(layer->netInstance);
+
+    int inSize = sqrt(layer->inMapValuesCount);
+    int channelsCount = layer->filterWeights[0].size();
+    bool buildsErrorMaps = layer->prevLayer->type != "FC";
+
+    // The forward passes overwrite the activations and sum maps, and the delta weights get accumulated into, so they
+    // all need putting back afterwards
+    std::vector<std::vector<std::vector<std::vector<double> > > > filterDeltaWeights = layer->filterDeltaWeights;
+    std::vector<double> deltaBiases = layer->deltaBiases;
+    std::vector<std::vector<std::vector<double> > > activations = layer->activations;
+    std::vector<std::vector<std::vector<double> > > sumMaps;
+    std::vector<std::vector<std::vector<bool> > > dropoutMaps;
+
+    for (int f=0; f<layer->filters.size(); f++) {
+        sumMaps.push_back(layer->filters[f]->sumMap);
+        dropoutMaps.push_back(layer->filters[f]->dropoutMap);
+    }
+
+    // Without dropout, the forward passes don't take any dropout draws, from either rand() or the layer's generator
+    double dropout = net->dropout;
+    net->dropout = 1;
+
+    int fastest = 0;
+    double fastestTime = std::numeric_limits<double>::infinity();
+
+    for (int algorithm=0; algorithm<4; algorithm++) {
+
+        layer->convAlgorithm = algorithm;
+
+        if (getConvAlgorithm(layer, inSize) != algorithm) {
+            continue;
+        }
+
+        double time = 0;
+
+        // The first run is a warm up, which also fills the transforms caches
+        for (int i=0; i<=iterations; i++) {
+
+            auto start = std::chrono::steady_clock::now();
+
+            layer->forward();
+            buildConvDWeights(layer);
+
+            if (buildsErrorMaps) {
+                buildConvErrorMaps(inSize, layer, channelsCount);
+            }
+
+            if (i) {
+                time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+
+        if (time < fastestTime) {
+            fastestTime = time;
+            fastest = algorithm;
+        }
+    }
+
+    net->dropout = dropout;
+    layer->filterDeltaWeights = filterDeltaWeights;
+    layer->deltaBiases = deltaBiases;
+    layer->activations = activations;
+
+    for (int f=0; f<layer->filters.size(); f++) {
+        layer->filters[f]->sumMap = sumMaps[f];
+        layer->filters[f]->dropoutMap = dropoutMaps[f];
+    }
+
+    layer->convAlgorithm = fastest;
+
+    return fastest;
+}
+
+// The instruction set the kernels run with, and the core count, so tuning results only get re-used on similar machines
+std::string NetUtil::machineTag (void) {
+
+#if defined(__wasm_simd128__)
+    std::string isa = "wasm-simd128";
+#elif defined(__EMSCRIPTEN__)
+    std::string isa = "wasm";
+#elif defined(JSNET_KERNEL_DISPATCH)
+    std::string isa = __builtin_cpu_supports("avx512f") ? "avx512f" : __builtin_cpu_supports("avx2") ? "avx2" : "x86-64";
+#elif defined(__AVX512F__)
+    std::string isa = "avx512f";
+#elif defined(__AVX2__)
+    std::string isa = "avx2";
+#else
+    std::string isa = "generic";
+#endif
+
+    return isa + "-" + std::to_string(std::thread::hardware_concurrency());
+}
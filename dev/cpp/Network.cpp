@@ -1,4 +1,9 @@
 #include <limits>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <fstream>
+#include <string>
 #include "jsNet.h"
 #include "FCLayer.cpp"
 #include "ConvLayer.cpp"
@@ -7,23 +12,55 @@
 #include "Filter.cpp"
 #include "NetMath.cpp"
 #include "NetUtil.cpp"
+#include "ThreadPool.cpp"
+#include "Dataset.cpp"
+#include "Prefetcher.cpp"
+#include "Augmentation.cpp"
+#include "Sweep.cpp"
+#include "Ensemble.cpp"
 
 Network::~Network () {
+    // The background validation reads the network, so it's stopped before anything is freed
+    cancelBackgroundValidation();
+    delete prefetcher;
+
     for (int l=0; l<layers.size(); l++) {
         delete layers[l];
     }
+
+    for (int r=0; r<replicas.size(); r++) {
+        if (replicas[r]->instanceIndex < netInstances.size() && netInstances[replicas[r]->instanceIndex]==replicas[r]) {
+            netInstances[replicas[r]->instanceIndex] = 0;
+        }
+        delete replicas[r];
+    }
+
+    if (validator) {
+        if (validator->instanceIndex < netInstances.size() && netInstances[validator->instanceIndex]==validator) {
+            netInstances[validator->instanceIndex] = 0;
+        }
+        delete validator;
+    }
 }
 
 int Network::newNetwork(void) {
     Network* net = new Network();
     net->iterations = 0;
     net->rreluSlope = ((double) rand() / (RAND_MAX)) * 0.001;
+    joinBackgroundValidations();
     netInstances.push_back(net);
     net->instanceIndex = netInstances.size()-1;
     return net->instanceIndex;
 }
 
+// Background validations' layers look their networks up in netInstances, so they're stopped before it's cleared
 void Network::deleteNetwork(void)  {
+    for (int i=0; i<netInstances.size(); i++) {
+        if (netInstances[i]) {
+            netInstances[i]->cancelBackgroundValidation();
+        }
+    }
+
     std::vector<Network*> clearNetworkInstances;
     netInstances.swap(clearNetworkInstances);
 }
@@ -72,16 +109,42 @@ void Network::joinLayers(void) {
 std::vector<double> Network::forward (std::vector<double> input) {
 
     layers[0]->actvns = input;
-
-    for (int l=1; l<layers.size(); l++) {
-        layers[l]->forward();
-    }
+    forwardLayers();
 
     return layers[layers.size()-1]->actvns;
 }
 
+// Runs the forward pass on the values already in the input layer
+void Network::forwardLayers (void) {
+
+    if (profiling) {
+        profiledForwards++;
+
+        for (int l=1; l<layers.size(); l++) {
+            auto start = std::chrono::steady_clock::now();
+            layers[l]->forward();
+            layers[l]->forwardTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    } else {
+        for (int l=1; l<layers.size(); l++) {
+            layers[l]->forward();
+        }
+    }
+}
+
 void Network::backward () {
 
+    if (profiling) {
+        profiledBackwards++;
+
+        for (int l=layers.size()-1; l>0; l--) {
+            auto start = std::chrono::steady_clock::now();
+            layers[l]->backward(l==layers.size()-1);
+            layers[l]->backwardTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        return;
+    }
+
     layers[layers.size()-1]->backward(true);
 
     for (int l=layers.size()-2; l>0; l--) {
@@ -91,57 +154,53 @@ void Network::backward () {
 
 void Network::train (int its, int startI) {
 
+    // Hogwild's updates race each other, so deterministic networks train synchronously, and so does max norm, which
+    // needs the whole network's weights at once. Its workers read the training data directly, so prefetched or
+    // augmented training does too
+    if (threads>1 && hogwild && updateFnIndex==0 && !deterministic && !maxNorm && !prefetch && !augmentation.enabled()) {
+        trainHogwild(its, startI);
+        return;
+    }
+
+    // Mini batches get split across the replicas, so a batch size of 1 has nothing to split
+    if (threads>1 && miniBatchSize>1) {
+        trainParallel(its, startI);
+        return;
+    }
+
     double totalErrors = 0.0;
     double iterationError = 0.0;
 
     isTraining = true;
     validationError = 0;
+    startPrefetching();
 
     for (int iterationIndex=startI; iterationIndex<(startI+its); iterationIndex++) {
 
         iterations++;
-        std::vector<double> output = forward(std::get<0>(trainingData[iterationIndex]));
-
-        int classIndex = -1;
-        int targetClassIndex = -1;
-        double classValue = -std::numeric_limits<double>::infinity();
-
-        for (int n=0; n<output.size(); n++) {
-            if (output[n] > classValue) {
-                classValue = output[n];
-                classIndex = n;
-            }
-            if (std::get<1>(trainingData[iterationIndex])[n]==1) {
-                targetClassIndex = n;
-                layers[layers.size()-1]->errs[n] = 1 - output[n];
-            } else {
-                layers[layers.size()-1]->errs[n] = 0 - output[n];
-            }
-        }
-
-        if (targetClassIndex != -1) {
-            trainingConfusionMatrix[targetClassIndex][classIndex]++;
-        }
+        int index;
+        Dataset& data = trainingSample(iterationIndex, index);
+        std::vector<double> output = forwardTrainingItem(data, index);
 
         if (validationInterval!=0 && iterationIndex!=0 && iterationIndex%validationInterval==0) {
-            validationError = validate();
-
-            if (collectErrors) {
-                collectedValidationErrors.push_back(validationError);
-            }
+            if (backgroundValidation) {
+                startBackgroundValidation();
+            } else {
+                validationError = validate();
 
-            if (earlyStoppingType && checkEarlyStopping()) {
-                if (trainingLogging) {
-                    printf("Stopping early\n");
+                if (validated(this)) {
+                    break;
                 }
-                stoppedEarly = true;
-                break;
             }
         }
 
+        if (backgroundValidation && finishBackgroundValidation(false) && validated(validator)) {
+            break;
+        }
+
         backward();
 
-        iterationError = costFunction(std::get<1>(trainingData[iterationIndex]), output);
+        iterationError = sampleCost(data, index, output);
         totalErrors += iterationError;
 
         if (collectErrors) {
@@ -156,150 +215,1407 @@ void Network::train (int its, int startI) {
         }
     }
 
+    finishEpochValidation(startI+its);
     isTraining = false;
     error = totalErrors / its;
 }
 
-double Network::validate (void) {
+// Trains whole mini batches, carrying on from trainingCursor, until budgetMs has passed or the epoch is over, so the
+// host can get control back in between, at whatever granularity suits it. Returns how many items were trained. The
+// error is averaged over the epoch so far
+int Network::trainFor (double budgetMs) {
 
-    double totalValidationErrors = 0;
+    auto start = std::chrono::steady_clock::now();
+    int startCursor = trainingCursor;
+
+    if (trainingCursor==0) {
+        epochTrainingError = 0;
+        stoppedEarly = false;
+    }
+
+    while (trainingCursor < trainingData.size() && !stoppedEarly) {
+
+        int its = std::min(miniBatchSize, trainingData.size() - trainingCursor);
+        train(its, trainingCursor);
+        epochTrainingError += error * its;
+        trainingCursor += its;
+
+        if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= budgetMs) {
+            break;
+        }
+    }
+
+    int trained = trainingCursor - startCursor;
+    error = trainingCursor ? epochTrainingError / trainingCursor : 0;
+
+    if (trainingCursor >= trainingData.size() || stoppedEarly) {
+        trainingCursor = 0;
+    }
+
+    return trained;
+}
+
+// Data parallel version of train(). Each mini batch is split evenly between this network and its replicas, which
+// all run their forward and backward passes at the same time. The replicas' deltas are then summed into this
+// network, which applies them, and the new weights are copied back out to the replicas. When pipelining, each batch
+// goes through trainPipelined() instead
+void Network::trainParallel (int its, int startI) {
+
+    createReplicas();
+    syncReplicas();
+    startPrefetching();
+
+    int workerCount = replicas.size()+1;
+    std::vector<double> workerErrors(workerCount);
+    std::vector<std::vector<double> > workerCollectedErrors(workerCount);
+    double totalErrors = 0.0;
+
+    isTraining = true;
+    validationError = 0;
+
+    int batchStart = startI;
 
-    for (int i=0; i<validationData.size(); i++) {
-        std::vector<double> output = forward(std::get<0>(validationData[i]));
+    while (batchStart < startI+its) {
 
-        int classIndex = -1;
-        int targetClassIndex = -1;
-        double classValue = -std::numeric_limits<double>::infinity();
+        // Mini batches end at the same indeces as they do in train()
+        int batchEnd = std::min(startI+its, (batchStart/miniBatchSize + 1) * miniBatchSize);
+        int batchSize = batchEnd - batchStart;
 
-        for (int n=0; n<output.size(); n++) {
-            if (output[n] > classValue) {
-                classValue = output[n];
-                classIndex = n;
+        if (pipeline) {
+            std::fill(workerErrors.begin(), workerErrors.end(), 0);
+            trainPipelined(batchStart, batchSize, workerErrors[0], workerCollectedErrors[0]);
+
+        } else {
+            threadPool->run(workerCount, [&](int w) {
+
+                Network* worker = w ? replicas[w-1] : this;
+                workerErrors[w] = 0;
+
+                for (int i=batchStart + batchSize*w/workerCount; i<batchStart + batchSize*(w+1)/workerCount; i++) {
+
+                    int index;
+                    Dataset& data = trainingSample(i, index);
+                    std::vector<double> output = worker->forwardTrainingItem(data, index);
+                    worker->backward();
+
+                    double iterationError = sampleCost(data, index, output);
+                    workerErrors[w] += iterationError;
+
+                    if (collectErrors) {
+                        workerCollectedErrors[w].push_back(iterationError);
+                    }
+                }
+            }, priority);
+        }
+
+        reduceReplicas();
+        iterations += batchSize;
+
+        for (int w=0; w<workerCount; w++) {
+            totalErrors += workerErrors[w];
+
+            if (collectErrors) {
+                collectedTrainingErrors.insert(collectedTrainingErrors.end(), workerCollectedErrors[w].begin(), workerCollectedErrors[w].end());
+                workerCollectedErrors[w].clear();
             }
-            if (std::get<1>(validationData[i])[n]==1) {
-                targetClassIndex = n;
+        }
+
+        // The weights only change at the end of a batch, so validating here sees the same weights as train() would
+        if (validationInterval!=0) {
+
+            int nextValidation = (std::max(batchStart, 1) + validationInterval - 1) / validationInterval * validationInterval;
+
+            if (nextValidation < batchEnd) {
+                if (backgroundValidation) {
+                    startBackgroundValidation();
+                } else {
+                    validationError = validate();
+
+                    if (validated(this)) {
+                        break;
+                    }
+                }
             }
         }
 
-        if (targetClassIndex != -1) {
-            validationConfusionMatrix[targetClassIndex][classIndex]++;
+        if (backgroundValidation && finishBackgroundValidation(false) && validated(validator)) {
+            break;
         }
 
-        totalValidationErrors += costFunction(std::get<1>(validationData[i]), output);
+        if (batchEnd % miniBatchSize == 0) {
+            applyDeltaWeights();
+            resetDeltaWeights();
+
+            // The next train() call syncs them anyway
+            if (batchEnd < startI+its) {
+                syncReplicas();
+            }
+        }
 
-        validations++;
+        batchStart = batchEnd;
     }
-    lastValidationError = totalValidationErrors / validationData.size();
-    return lastValidationError;
+
+    finishEpochValidation(startI+its);
+    isTraining = false;
+    error = totalErrors / its;
 }
 
-bool Network::checkEarlyStopping (void) {
+// Pipelined version of the mini batch pass in trainParallel(), for when the samples are too small to be worth
+// splitting up. The layers are split into consecutive stages, one per thread, and the batch's samples flow through
+// them, forwards and then backwards, GPipe style, each stage working on a different sample at the same time. Every
+// sample in flight needs activations and errors of its own, so they take turns going through this network and its
+// replicas, which bounds how many can be in flight. Stages do backward passes first, to free up their networks
+void Network::trainPipelined (int batchStart, int batchSize, double& batchError, std::vector<double>& batchCollectedErrors) {
 
-    bool stop = false;
+    int stages = std::min(threads, (int) layers.size()-1);
+    int slots = replicas.size()+1;
+    int outputLayer = layers.size()-1;
 
-    switch (earlyStoppingType) {
-        // threshold
-        case 1:
-            stop = lastValidationError <= earlyStoppingThreshold;
+    std::vector<int> stageStarts(stages+1);
 
-            // Do the last backward pass
-            if (stop) {
-                backward();
-                applyDeltaWeights();
-            }
+    for (int s=0; s<=stages; s++) {
+        stageStarts[s] = 1 + (layers.size()-1) * s / stages;
+    }
 
-            return stop;
-        // patience
-        case 2:
+    // How many of the batch's samples each stage has finished its forward and backward passes for, in order
+    std::vector<int> forwards(stages, 0);
+    std::vector<int> backwards(stages, 0);
+    std::vector<Dataset*> sampleData(batchSize);
+    std::vector<int> sampleIndeces(batchSize);
+    std::mutex mutex;
+    std::condition_variable progress;
 
-            if (lastValidationError < earlyStoppingBestError) {
-                earlyStoppingPatienceCounter = 0;
-                earlyStoppingBestError = lastValidationError;
+    // The stages wait on each other, so the shared pool runs them all at once, as a gang
+    threadPool->run(stages, [&](int s) {
+
+        bool outputStage = s==stages-1;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (backwards[s] < batchSize) {
+
+            int f = forwards[s];
+            int b = backwards[s];
+            bool canBackward = b < f && (outputStage || backwards[s+1] > b);
+            bool canForward = f < batchSize && (s ? forwards[s-1] > f : f < backwards[0] + slots);
 
-                for (int l=1; l<layers.size(); l++) {
-                    layers[l]->backUpValidation();
+            if (!canBackward && !canForward) {
+                progress.wait(lock);
+                continue;
+            }
+
+            int k = canBackward ? b : f;
+            Network* slot = k % slots ? replicas[k % slots - 1] : this;
+            lock.unlock();
+
+            if (canBackward) {
+                for (int l=stageStarts[s+1]-1; l>=stageStarts[s]; l--) {
+                    slot->layers[l]->backward(l==outputLayer);
                 }
+
             } else {
-                earlyStoppingPatienceCounter++;
-                stop = earlyStoppingPatienceCounter >= earlyStoppingPatience;
+                if (!s) {
+                    sampleData[k] = &trainingSample(batchStart+k, sampleIndeces[k]);
+                    float* input = sampleData[k]->input(sampleIndeces[k]);
+                    slot->layers[0]->actvns.assign(input, input + sampleData[k]->inputSize);
+                }
+
+                for (int l=stageStarts[s]; l<stageStarts[s+1]; l++) {
+                    slot->layers[l]->forward();
+                }
+
+                if (outputStage) {
+                    std::vector<double> output = slot->layers[outputLayer]->actvns;
+                    slot->outputErrors(*sampleData[k], sampleIndeces[k], output);
+
+                    double iterationError = sampleCost(*sampleData[k], sampleIndeces[k], output);
+                    batchError += iterationError;
+
+                    if (collectErrors) {
+                        batchCollectedErrors.push_back(iterationError);
+                    }
+                }
             }
 
-            return stop;
+            lock.lock();
+            (canBackward ? backwards : forwards)[s]++;
+            progress.notify_all();
+        }
+    }, priority, true);
+}
 
-        // divergence
-        case 3:
+// Hogwild version of train(). The items are split into one contiguous slice per thread, and this network and its
+// replicas each train through their own slice, in their own mini batches, at the same time. After each of its mini
+// batches, a worker applies its deltas straight to this network's weights, with no locking, and reads them back.
+// Updates racing each other lose a little of their effect, which sparse models barely notice. Only plain SGD applies
+// this way, and the workers read the training data directly, so train() keeps the other update functions, and
+// prefetched or augmented training, synchronous
+void Network::trainHogwild (int its, int startI) {
+
+    createReplicas();
+    syncReplicas();
+    stopPrefetching();
+
+    int workerCount = replicas.size()+1;
+    std::vector<double> workerErrors(workerCount, 0);
+    std::vector<std::vector<double> > workerCollectedErrors(workerCount);
+    double totalErrors = 0.0;
 
-            if (lastValidationError < earlyStoppingBestError) {
+    isTraining = true;
+    validationError = 0;
 
-                earlyStoppingBestError = lastValidationError;
+    // The replicas count their own regularization errors, added to this network's after the pass
+    for (int r=0; r<replicas.size(); r++) {
+        replicas[r]->l2Error = 0;
+        replicas[r]->l1Error = 0;
+    }
 
-                for (int l=1; l<layers.size(); l++) {
-                    layers[l]->backUpValidation();
-                }
+    threadPool->run(workerCount, [&](int w) {
 
-            } else {
-                stop = (lastValidationError / earlyStoppingBestError) >= (1+earlyStoppingPercent/100);
+        Network* worker = w ? replicas[w-1] : this;
+        int first = startI + its*w/workerCount;
+        int last = startI + its*(w+1)/workerCount;
+
+        for (int i=first; i<last; i++) {
+
+            int index = trainingIndex(i);
+            std::vector<double> output = worker->forwardTrainingItem(trainingData, index);
+            worker->backward();
+
+            double iterationError = sampleCost(trainingData, index, output);
+            workerErrors[w] += iterationError;
+
+            if (collectErrors) {
+                workerCollectedErrors[w].push_back(iterationError);
             }
 
-            return stop;
+            if ((i-first+1) % miniBatchSize == 0 || i==last-1) {
+                applyHogwildDeltas(worker);
+            }
+        }
+    }, priority);
+
+    // Only the confusion matrix counts are left to reduce
+    reduceReplicas();
+    iterations += its;
 
+    for (int w=0; w<workerCount; w++) {
+        totalErrors += workerErrors[w];
+        collectedTrainingErrors.insert(collectedTrainingErrors.end(), workerCollectedErrors[w].begin(), workerCollectedErrors[w].end());
     }
-    return stop;
+
+    for (int r=0; r<replicas.size(); r++) {
+        l2Error += replicas[r]->l2Error;
+        l1Error += replicas[r]->l1Error;
+    }
+
+    // The slices all run at once, so validation waits for the end of the pass
+    if (validationInterval!=0) {
+
+        int nextValidation = (std::max(startI, 1) + validationInterval - 1) / validationInterval * validationInterval;
+
+        if (nextValidation < startI+its) {
+            if (backgroundValidation) {
+                startBackgroundValidation();
+            } else {
+                validationError = validate();
+                validated(this);
+            }
+        }
+    }
+
+    if (backgroundValidation && finishBackgroundValidation(false)) {
+        validated(validator);
+    }
+
+    finishEpochValidation(startI+its);
+    isTraining = false;
+    error = totalErrors / its;
 }
 
-double Network::test (int its, int startI) {
+// Applies a Hogwild worker's deltas to this network's weights, as plain SGD would, and copies the result back into the
+// worker. Other workers may be doing the same to the same weights. The regularization errors go to the worker's totals
+void Network::applyHogwildDeltas (Network* worker) {
 
-    double totalErrors = 0.0;
+    for (int l=1; l<layers.size(); l++) {
+
+        Layer* layer = layers[l];
+        Layer* workerLayer = worker->layers[l];
+
+        if (layer->type=="FC") {
+            for (int n=0; n<layer->weights.size(); n++) {
 
-    for (int i=startI; i<(startI+its); i++) {
-        std::vector<double> output = forward(std::get<0>(testData[i]));
+                for (int dw=0; dw<layer->weights[n].size(); dw++) {
+                    if (l2) worker->l2Error += 0.5 * l2 * pow(layer->weights[n][dw], 2);
+                    if (l1) worker->l1Error += l1 * fabs(layer->weights[n][dw]);
+                }
+
+                // Pruned rows only hold their surviving weights, so they get updated just like dense ones
+                NetMath::sgdUpdate(layer->weights[n].data(), workerLayer->deltaWeights[n].data(), layer->weights[n].size(),
+                    learningRate, l2, l1, miniBatchSize);
 
-        int classIndex = -1;
-        int targetClassIndex = -1;
-        double classValue = -std::numeric_limits<double>::infinity();
+                layer->biases[n] += learningRate * workerLayer->deltaBiases[n];
 
-        for (int n=0; n<output.size(); n++) {
-            if (output[n] > classValue) {
-                classValue = output[n];
-                classIndex = n;
+                if (worker != this) {
+                    std::copy(layer->weights[n].begin(), layer->weights[n].end(), workerLayer->weights[n].begin());
+                    workerLayer->biases[n] = layer->biases[n];
+                }
             }
-            if (std::get<1>(testData[i])[n]==1) {
-                targetClassIndex = n;
+
+        } else if (layer->type=="Conv") {
+            for (int f=0; f<layer->filterWeights.size(); f++) {
+                for (int c=0; c<layer->filterWeights[f].size(); c++) {
+                    for (int row=0; row<layer->filterWeights[f][c].size(); row++) {
+
+                        std::vector<double>& weights = layer->filterWeights[f][c][row];
+
+                        for (int v=0; v<weights.size(); v++) {
+                            if (l2) worker->l2Error += 0.5 * l2 * pow(weights[v], 2);
+                            if (l1) worker->l1Error += l1 * fabs(weights[v]);
+                        }
+
+                        NetMath::sgdUpdate(weights.data(), workerLayer->filterDeltaWeights[f][c][row].data(), weights.size(),
+                            learningRate, l2, l1, miniBatchSize);
+
+                        if (worker != this) {
+                            std::copy(weights.begin(), weights.end(), workerLayer->filterWeights[f][c][row].begin());
+                        }
+                    }
+                }
+
+                layer->biases[f] += learningRate * workerLayer->deltaBiases[f];
+                workerLayer->biases[f] = layer->biases[f];
             }
+
+            layer->winogradStale = workerLayer->winogradStale = true;
+            layer->winogradErrorStale = workerLayer->winogradErrorStale = true;
+            layer->fftStale = workerLayer->fftStale = true;
         }
+    }
+
+    worker->resetDeltaWeights();
+}
+
+// The trainingData index of the given iteration's sample. Until shuffled, the data is trained in order
+int Network::trainingIndex (int iteration) {
+    return iteration < trainingOrder.size() ? trainingOrder[iteration] : iteration;
+}
+
+// Shuffles the order the training data is trained in, leaving the data itself where it is
+void Network::shuffleTrainingOrder (void) {
+
+    stopPrefetching();
+
+    if (trainingOrder.size() != trainingData.size()) {
+        trainingOrder.resize(trainingData.size());
+        std::iota(trainingOrder.begin(), trainingOrder.end(), 0);
+    }
+
+    NetUtil::shuffle(trainingOrder, shuffleRNG);
+}
+
+// The data set and index to read an iteration's training sample from. When prefetching or augmenting, that's the
+// loaded batch
+Dataset& Network::trainingSample (int iteration, int& index) {
+
+    if (prefetcher && prefetcher->running) {
+        index = iteration % miniBatchSize;
+        return prefetcher->batch(iteration);
+    }
+
+    index = trainingIndex(iteration);
+    return trainingData;
+}
+
+// Starts the prefetcher's loader, if prefetching. It keeps going across train() calls, until the training data or its
+// order change. Augmented samples go through the prefetcher too, loaded in place when not prefetching
+void Network::startPrefetching (void) {
+
+    if (!prefetch && !augmentation.enabled()) {
+        stopPrefetching();
+        return;
+    }
+
+    // One slot for the batch being trained, and one for each batch loaded ahead of it
+    int slotCount = prefetch + 1;
+    bool background = prefetch > 0;
+
+    if (prefetcher && (prefetcher->slots.size() != slotCount || prefetcher->background != background
+        || prefetcher->batchSize != miniBatchSize
+        || prefetcher->batchCount != (trainingData.size() + miniBatchSize - 1) / miniBatchSize)) {
+        stopPrefetching();
+    }
+
+    if (!prefetcher || prefetcher->slots.size() != slotCount || prefetcher->background != background) {
+        delete prefetcher;
+        prefetcher = new Prefetcher(this, slotCount);
+        prefetcher->background = background;
+    }
+
+    prefetcher->start();
+}
+
+void Network::stopPrefetching (void) {
+    if (prefetcher) {
+        prefetcher->stop();
+    }
+}
 
-        if (targetClassIndex != -1) {
-            testConfusionMatrix[targetClassIndex][classIndex]++;
+// Runs the forward pass on a sample's input, read straight out of the data set
+std::vector<double> Network::forwardItem (Dataset& data, int index) {
+
+    layers[0]->actvns.assign(data.input(index), data.input(index) + data.inputSize);
+    forwardLayers();
+
+    return layers[layers.size()-1]->actvns;
+}
+
+// Runs the forward pass for a training item, setting the output errors and counting it in the confusion matrix
+std::vector<double> Network::forwardTrainingItem (Dataset& data, int index) {
+    std::vector<double> output = forwardItem(data, index);
+    outputErrors(data, index, output);
+    return output;
+}
+
+// Sets the output layer's errors for a training item's output, and counts it in the confusion matrix
+void Network::outputErrors (Dataset& data, int index, const std::vector<double>& output) {
+
+    float* expected = data.expected(index);
+    int label = data.label(index);
+
+    int classIndex = -1;
+    int targetClassIndex = -1;
+    double classValue = -std::numeric_limits<double>::infinity();
+
+    for (int n=0; n<output.size(); n++) {
+        if (output[n] > classValue) {
+            classValue = output[n];
+            classIndex = n;
+        }
+        if (data.classes ? n==label : expected[n]==1) {
+            targetClassIndex = n;
+            layers[layers.size()-1]->errs[n] = 1 - output[n];
+        } else {
+            layers[layers.size()-1]->errs[n] = 0 - output[n];
         }
+    }
 
-        double iterationError = costFunction(std::get<1>(testData[i]), output);
+    if (targetClassIndex != -1) {
+        trainingConfusionMatrix[targetClassIndex][classIndex]++;
+    }
+}
 
-        if (collectErrors) {
-            collectedTestErrors.push_back(iterationError);
+double Network::validate (void) {
+
+    double totalValidationErrors = 0;
+
+    if (threads>1 && validationData.size()>1) {
+
+        // train() only keeps the replicas in sync when it splits mini batches across them
+        createReplicas();
+        syncReplicas();
+
+        int workerCount = replicas.size()+1;
+        int count = validationData.size();
+        std::vector<double> workerErrors(workerCount, 0);
+
+        threadPool->run(workerCount, [&](int w) {
+            Network* worker = w ? replicas[w-1] : this;
+
+            for (int i=count*w/workerCount; i<count*(w+1)/workerCount; i++) {
+                workerErrors[w] += worker->evaluateItem(validationData, i, worker->validationConfusionMatrix);
+            }
+        }, priority);
+
+        for (int w=0; w<workerCount; w++) {
+            totalValidationErrors += workerErrors[w];
         }
 
-        totalErrors += iterationError;
+        reduceReplicas();
+        validations += count;
+
+    } else {
+        for (int i=0; i<validationData.size(); i++) {
+            totalValidationErrors += evaluateItem(validationData, i, validationConfusionMatrix);
+            validations++;
+        }
     }
 
-    return totalErrors / its;
+    lastValidationError = totalValidationErrors / validationData.size();
+    return lastValidationError;
 }
 
-void Network::resetDeltaWeights (void) {
-    for (int l=1; l<layers.size(); l++) {
-        layers[l]->resetDeltaWeights();
+// Copies the current weights into the validator, and validates them on a background thread, while training carries
+// on. Validation intervals coming up while it's still going are skipped, returning false
+bool Network::startBackgroundValidation (void) {
+
+    if (validationPending) {
+        return false;
     }
-}
 
-void Network::applyDeltaWeights (void) {
-    for (int l=1; l<layers.size(); l++) {
-        layers[l]->applyDeltaWeights();
+    if (!validator) {
+        validator = createReplica();
     }
+
+    syncReplica(validator);
+    validationDone = false;
+    validationPending = true;
+
+    validationThread = std::thread([this] {
+
+        double totalValidationErrors = 0;
+
+        for (int i=0; i<validationData.size(); i++) {
+            totalValidationErrors += validator->evaluateItem(validationData, i, validator->validationConfusionMatrix);
+        }
+
+        backgroundValidationError = totalValidationErrors / validationData.size();
+        validationDone = true;
+    });
+
+    return true;
 }
 
-void Network::restoreValidation (void) {
+// Collects the background validation's error and confusion matrix counts, as validate() would have, once it's done,
+// or waiting for it. Returns whether there was one to collect. Deterministic networks always wait, so that early
+// stopping doesn't depend on how long validating took
+bool Network::finishBackgroundValidation (bool wait) {
+
+    if (!validationPending || (!wait && !validationDone && !deterministic)) {
+        return false;
+    }
+
+    if (validationThread.joinable()) {
+        validationThread.join();
+    }
+
+    validationPending = false;
+    validations += validationData.size();
+    validationError = lastValidationError = backgroundValidationError;
+
+    for (int row=0; row<validationConfusionMatrix.size(); row++) {
+        for (int col=0; col<validationConfusionMatrix.size(); col++) {
+            validationConfusionMatrix[row][col] += validator->validationConfusionMatrix[row][col];
+            validator->validationConfusionMatrix[row][col] = 0;
+        }
+    }
+
+    return true;
+}
+
+// Waits for any background validation, dropping its results
+void Network::cancelBackgroundValidation (void) {
+
+    if (validationThread.joinable()) {
+        validationThread.join();
+    }
+
+    if (validationPending) {
+        validationPending = false;
+
+        for (int row=0; row<validator->validationConfusionMatrix.size(); row++) {
+            std::fill(validator->validationConfusionMatrix[row].begin(), validator->validationConfusionMatrix[row].end(), 0);
+        }
+    }
+}
+
+// Epochs don't end with a validation still going, so its error makes it into the epoch's logs, and into early stopping
+void Network::finishEpochValidation (int end) {
+
+    if (stoppedEarly) {
+        cancelBackgroundValidation();
+
+    } else if (end >= trainingData.size() && finishBackgroundValidation(true)) {
+        validated(validator);
+    }
+}
+
+// Growing netInstances can move it, while background validations' layers are looking their networks up in it, so
+// they're waited for first. Their results still get collected as usual
+void Network::joinBackgroundValidations (void) {
+    for (int i=0; i<netInstances.size(); i++) {
+        if (netInstances[i] && netInstances[i]->validationThread.joinable()) {
+            netInstances[i]->validationThread.join();
+        }
+    }
+}
+
+// Collects a validation's error, and checks for early stopping on the weights it validated. Returns whether to stop
+bool Network::validated (Network* snapshot) {
+
+    if (collectErrors) {
+        collectedValidationErrors.push_back(validationError);
+    }
+
+    if (earlyStoppingType && checkEarlyStopping(snapshot)) {
+        if (trainingLogging) {
+            printf("Stopping early\n");
+        }
+        stoppedEarly = true;
+        return true;
+    }
+
+    return false;
+}
+
+// Runs the forward pass for a validation or test item, counting it in the given confusion matrix, and returns its error
+double Network::evaluateItem (Dataset& data, int index, std::vector<std::vector<int> >& confusionMatrix) {
+
+    std::vector<double> output = forwardItem(data, index);
+    float* expected = data.expected(index);
+    int label = data.label(index);
+
+    int classIndex = -1;
+    int targetClassIndex = -1;
+    double classValue = -std::numeric_limits<double>::infinity();
+
+    for (int n=0; n<output.size(); n++) {
+        if (output[n] > classValue) {
+            classValue = output[n];
+            classIndex = n;
+        }
+        if (data.classes ? n==label : expected[n]==1) {
+            targetClassIndex = n;
+        }
+    }
+
+    if (targetClassIndex != -1) {
+        confusionMatrix[targetClassIndex][classIndex]++;
+    }
+
+    return sampleCost(data, index, output);
+}
+
+// A sample's error. Class index samples get it straight from the index, without building one-hot expected values,
+// when the cost function has a version for that
+double Network::sampleCost (Dataset& data, int index, const std::vector<double>& output) {
+
+    if (data.classes && labelCostFunction) {
+        return labelCostFunction(data.label(index), output);
+    }
+
+    return costFunction(data.expectedValues(index), output);
+}
+
+// Makes sure there are threads-1 replicas of the network, and a thread pool to run them on
+void Network::createReplicas (void) {
+
+    createThreadPool();
+
+    if (replicas.size()==threads-1) {
+        return;
+    }
+
+    for (int r=0; r<replicas.size(); r++) {
+        netInstances[replicas[r]->instanceIndex] = 0;
+        delete replicas[r];
+    }
+    replicas.clear();
+
+    for (int r=0; r<threads-1; r++) {
+        replicas.push_back(createReplica());
+    }
+
+    if (deterministic) {
+        seedStreams();
+    }
+}
+
+// The pool is shared with every other network instance, and between the replicas, and the layers' own loops, for when
+// there's only one sample to work on
+void Network::createThreadPool (void) {
+    threadPool = ThreadPool::shared(threads-1);
+}
+
+// Splits a layer's loop over [0, count) into ranges, running fn(first, last) for each of them across the threads, if the
+// work (roughly, in multiply-adds) is worth it. There are a few ranges per thread, so the threads finishing theirs early
+// take on more. Inside the pool's own tasks, like the replicas' passes, everything runs on the calling thread
+void Network::parallelFor (int count, double work, const std::function<void(int, int)>& fn) {
+
+    if (threads<2 || count<2 || work<parallelThreshold || ThreadPool::inTask) {
+        fn(0, count);
+        return;
+    }
+
+    createThreadPool();
+
+    int ranges = std::min(count, threads*4);
+
+    threadPool->run(ranges, [&](int r) {
+        fn(count*r/ranges, count*(r+1)/ranges);
+    }, priority);
+}
+
+// A copy of the network, with its own layers, neurons and filters, registered as a network instance of its own, as
+// the layers look their network up by index
+Network* Network::createReplica (void) {
+
+    Network* replica = new Network();
+    joinBackgroundValidations();
+    netInstances.push_back(replica);
+    replica->instanceIndex = netInstances.size()-1;
+
+    for (int l=0; l<layers.size(); l++) {
+
+        Layer* layer;
+
+        if (layers[l]->type=="FC") {
+            layer = new FCLayer(*(FCLayer*)layers[l]);
+        } else if (layers[l]->type=="Conv") {
+            layer = new ConvLayer(*(ConvLayer*)layers[l]);
+        } else {
+            layer = new PoolLayer(*(PoolLayer*)layers[l]);
+        }
+
+        layer->netInstance = replica->instanceIndex;
+
+        for (int n=0; n<layer->neurons.size(); n++) {
+            layer->neurons[n] = new Neuron(*layers[l]->neurons[n]);
+        }
+        for (int f=0; f<layer->filters.size(); f++) {
+            layer->filters[f] = new Filter(*layers[l]->filters[f]);
+        }
+
+        if (l) {
+            layer->prevLayer = replica->layers[l-1];
+            replica->layers[l-1]->nextLayer = layer;
+        }
+
+        replica->layers.push_back(layer);
+    }
+
+    replica->trainingConfusionMatrix = trainingConfusionMatrix;
+    replica->validationConfusionMatrix = validationConfusionMatrix;
+    replica->testConfusionMatrix = testConfusionMatrix;
+
+    for (int row=0; row<trainingConfusionMatrix.size(); row++) {
+        std::fill(replica->trainingConfusionMatrix[row].begin(), replica->trainingConfusionMatrix[row].end(), 0);
+        std::fill(replica->validationConfusionMatrix[row].begin(), replica->validationConfusionMatrix[row].end(), 0);
+        std::fill(replica->testConfusionMatrix[row].begin(), replica->testConfusionMatrix[row].end(), 0);
+    }
+
+    replica->resetDeltaWeights();
+    return replica;
+}
+
+// Copies the config and the current weights over to the replicas
+void Network::syncReplicas (void) {
+    for (int r=0; r<replicas.size(); r++) {
+        syncReplica(replicas[r]);
+    }
+}
+
+void Network::syncReplica (Network* replica) {
+    replica->miniBatchSize = miniBatchSize;
+    replica->channels = channels;
+    replica->learningRate = learningRate;
+    replica->lreluSlope = lreluSlope;
+    replica->rreluSlope = rreluSlope;
+    replica->eluAlpha = eluAlpha;
+    replica->isTraining = isTraining;
+    replica->dropout = dropout;
+    replica->deterministic = deterministic;
+    replica->l2 = l2;
+    replica->l1 = l1;
+    replica->maxNorm = maxNorm;
+    replica->updateFnIndex = updateFnIndex;
+    replica->activation = activation;
+    replica->costFunction = costFunction;
+    replica->labelCostFunction = labelCostFunction;
+
+    for (int l=1; l<layers.size(); l++) {
+
+        Layer* layer = replica->layers[l];
+
+        if (layers[l]->type=="FC") {
+            layer->weights = layers[l]->weights;
+            layer->biases = layers[l]->biases;
+            layer->pruned = layers[l]->pruned;
+            layer->sparseRowStarts = layers[l]->sparseRowStarts;
+            layer->sparseColumns = layers[l]->sparseColumns;
+            layer->denseRowSize = layers[l]->denseRowSize;
+
+            // The replica's deltas follow its rows through pruning and densifying
+            for (int n=0; n<layer->weights.size(); n++) {
+                if (layer->deltaWeights[n].size() != layer->weights[n].size()) {
+                    layer->deltaWeights[n] = std::vector<double>(layer->weights[n].size(), 0);
+                }
+            }
+
+        } else if (layers[l]->type=="Conv") {
+            layer->filterWeights = layers[l]->filterWeights;
+            layer->biases = layers[l]->biases;
+            layer->convAlgorithm = layers[l]->convAlgorithm;
+            layer->winogradStale = true;
+            layer->winogradErrorStale = true;
+            layer->fftStale = true;
+        }
+    }
+}
+
+// Sums the replicas' deltas and confusion matrix counts into this network, clearing them in the replicas. The deltas
+// are summed as a tree, in a fixed order, which only depends on the thread count. In each round, every other worker
+// still holding deltas adds in its neighbour's, half of the rounds' width apart, and the pairs are added in parallel
+void Network::reduceReplicas (void) {
+
+    if (replicas.empty()) {
+        return;
+    }
+
+    int workerCount = replicas.size()+1;
+    double deltasCount = 0;
+
+    for (int l=1; l<layers.size(); l++) {
+        if (layers[l]->type=="FC") {
+            deltasCount += (double) layers[l]->deltaWeights.size() * (layers[l]->deltaWeights.size() ? layers[l]->deltaWeights[0].size() : 0);
+        } else if (layers[l]->type=="Conv") {
+            deltasCount += (double) layers[l]->filterDeltaWeights.size() * layers[l]->channels * layers[l]->filterSize * layers[l]->filterSize;
+        }
+    }
+
+    for (int width=1; width<workerCount; width*=2) {
+
+        int pairs = (workerCount - width + 2*width - 1) / (2*width);
+
+        parallelFor(pairs, pairs * deltasCount, [&](int first, int last) {
+            for (int p=first; p<last; p++) {
+
+                int w = p * 2*width;
+                Network* worker = w ? replicas[w-1] : this;
+                Network* source = replicas[w+width-1];
+
+                worker->addDeltas(source);
+                source->resetDeltaWeights();
+            }
+        });
+    }
+
+    for (int r=0; r<replicas.size(); r++) {
+
+        Network* replica = replicas[r];
+
+        for (int row=0; row<trainingConfusionMatrix.size(); row++) {
+            for (int col=0; col<trainingConfusionMatrix.size(); col++) {
+                trainingConfusionMatrix[row][col] += replica->trainingConfusionMatrix[row][col];
+                validationConfusionMatrix[row][col] += replica->validationConfusionMatrix[row][col];
+                testConfusionMatrix[row][col] += replica->testConfusionMatrix[row][col];
+                replica->trainingConfusionMatrix[row][col] = 0;
+                replica->validationConfusionMatrix[row][col] = 0;
+                replica->testConfusionMatrix[row][col] = 0;
+            }
+        }
+    }
+}
+
+// Adds another copy of the network's deltas into this one's
+void Network::addDeltas (Network* source) {
+    for (int l=1; l<layers.size(); l++) {
+
+        Layer* layer = layers[l];
+        Layer* sourceLayer = source->layers[l];
+
+        if (layer->type=="FC") {
+            for (int n=0; n<layer->deltaWeights.size(); n++) {
+                NetMath::axpy(1, sourceLayer->deltaWeights[n].data(), layer->deltaWeights[n].data(), layer->deltaWeights[n].size());
+            }
+            NetMath::axpy(1, sourceLayer->deltaBiases.data(), layer->deltaBiases.data(), layer->deltaBiases.size());
+
+        } else if (layer->type=="Conv") {
+            for (int f=0; f<layer->filterDeltaWeights.size(); f++) {
+                for (int c=0; c<layer->filterDeltaWeights[f].size(); c++) {
+                    for (int row=0; row<layer->filterDeltaWeights[f][c].size(); row++) {
+                        NetMath::axpy(1, sourceLayer->filterDeltaWeights[f][c][row].data(), layer->filterDeltaWeights[f][c][row].data(),
+                            layer->filterDeltaWeights[f][c][row].size());
+                    }
+                }
+            }
+            NetMath::axpy(1, sourceLayer->deltaBiases.data(), layer->deltaBiases.data(), layer->deltaBiases.size());
+        }
+    }
+}
+
+// Gives every layer, in this network and its replicas, a random stream of its own, from the seed. The replicas and
+// pipeline stages run their layers on different threads, so one shared sequence would get drawn from in a different
+// order every run
+void Network::seedStreams (void) {
+    for (int r=0; r<=replicas.size(); r++) {
+
+        Network* net = r ? replicas[r-1] : this;
+
+        for (int l=0; l<net->layers.size(); l++) {
+            std::seed_seq sequence{seed, (unsigned int) r, (unsigned int) l};
+            net->layers[l]->rng.seed(sequence);
+        }
+    }
+}
+
+// A 0 to 1 dropout draw
+double Network::dropoutDraw (Layer* layer) {
+    return deterministic ? layer->rng() / 4294967295.0 : (double) rand() / (RAND_MAX);
+}
+
+bool Network::checkEarlyStopping (void) {
+    return checkEarlyStopping(this);
+}
+
+// The validated network is the validator when validating in the background. Training has moved on since its weights
+// were copied, so the best ones get backed up from there
+bool Network::checkEarlyStopping (Network* validated) {
+
+    bool stop = false;
+
+    auto backUpValidation = [&] {
+        for (int l=1; l<layers.size(); l++) {
+            validated->layers[l]->backUpValidation();
+
+            if (validated != this) {
+                layers[l]->validationBiases.swap(validated->layers[l]->validationBiases);
+                layers[l]->validationWeights.swap(validated->layers[l]->validationWeights);
+                layers[l]->validationFilterWeights.swap(validated->layers[l]->validationFilterWeights);
+            }
+        }
+        validationBackedUp = true;
+    };
+
+    switch (earlyStoppingType) {
+        // threshold
+        case 1:
+            stop = lastValidationError <= earlyStoppingThreshold;
+
+            // Do the last backward pass, for the item validation happened on
+            if (stop && validated == this) {
+                backward();
+                applyDeltaWeights();
+            }
+
+            return stop;
+        // patience
+        case 2:
+
+            if (lastValidationError < earlyStoppingBestError) {
+                earlyStoppingPatienceCounter = 0;
+                earlyStoppingBestError = lastValidationError;
+
+                backUpValidation();
+            } else {
+                earlyStoppingPatienceCounter++;
+                stop = earlyStoppingPatienceCounter >= earlyStoppingPatience;
+            }
+
+            return stop;
+
+        // divergence
+        case 3:
+
+            if (lastValidationError < earlyStoppingBestError) {
+
+                earlyStoppingBestError = lastValidationError;
+
+                backUpValidation();
+
+            } else {
+                stop = (lastValidationError / earlyStoppingBestError) >= (1+earlyStoppingPercent/100);
+            }
+
+            return stop;
+
+    }
+    return stop;
+}
+
+// Split across the replicas like validate(), each counting into its own confusion matrix, and collecting its own
+// errors, which are merged back in order
+double Network::test (int its, int startI) {
+
+    double totalErrors = 0.0;
+
+    if (threads>1 && its>1) {
+
+        createReplicas();
+        syncReplicas();
+
+        int workerCount = replicas.size()+1;
+        std::vector<double> workerErrors(workerCount, 0);
+        std::vector<std::vector<double> > workerCollectedErrors(workerCount);
+
+        threadPool->run(workerCount, [&](int w) {
+            Network* worker = w ? replicas[w-1] : this;
+
+            for (int i=startI + its*w/workerCount; i<startI + its*(w+1)/workerCount; i++) {
+
+                double iterationError = worker->evaluateItem(testData, i, worker->testConfusionMatrix);
+                workerErrors[w] += iterationError;
+
+                if (collectErrors) {
+                    workerCollectedErrors[w].push_back(iterationError);
+                }
+            }
+        }, priority);
+
+        reduceReplicas();
+
+        for (int w=0; w<workerCount; w++) {
+            totalErrors += workerErrors[w];
+            collectedTestErrors.insert(collectedTestErrors.end(), workerCollectedErrors[w].begin(), workerCollectedErrors[w].end());
+        }
+
+    } else {
+        for (int i=startI; i<(startI+its); i++) {
+
+            double iterationError = evaluateItem(testData, i, testConfusionMatrix);
+
+            if (collectErrors) {
+                collectedTestErrors.push_back(iterationError);
+            }
+
+            totalErrors += iterationError;
+        }
+    }
+
+    return totalErrors / its;
+}
+
+void Network::resetDeltaWeights (void) {
+    for (int l=1; l<layers.size(); l++) {
+        layers[l]->resetDeltaWeights();
+    }
+}
+
+void Network::applyDeltaWeights (void) {
+    for (int l=1; l<layers.size(); l++) {
+        layers[l]->applyDeltaWeights();
+    }
+}
+
+// The layers swap their back-ups in, leaving the replaced weights in their place, so each back-up can only be restored
+// once. Restoring again, or after a train() which didn't back up new best weights, leaves the weights as they are
+void Network::restoreValidation (void) {
+
+    if (!validationBackedUp) {
+        return;
+    }
+
     for (int l=1; l<layers.size(); l++) {
         layers[l]->restoreValidation();
     }
+    validationBackedUp = false;
+}
+
+void Network::prune (double threshold, float sparsity) {
+    for (int l=1; l<layers.size(); l++) {
+        if (layers[l]->type == "FC") {
+            if (sparsity) {
+                static_cast<FCLayer*>(layers[l])->pruneToSparsity(sparsity);
+            } else {
+                static_cast<FCLayer*>(layers[l])->prune(threshold);
+            }
+        }
+    }
+}
+
+void Network::densify (void) {
+    for (int l=1; l<layers.size(); l++) {
+        if (layers[l]->type == "FC") {
+            static_cast<FCLayer*>(layers[l])->densify();
+        }
+    }
+}
+
+void Network::printProfile (void) {
+
+    const char* convAlgorithms[] = {"direct", "winograd", "fft", "gemm"};
+
+    printf("Layer\tType\tAlgorithm\tForward (ms)\tBackward (ms)\n");
+
+    for (int l=1; l<layers.size(); l++) {
+
+        const char* algorithm = "-";
+
+        if (layers[l]->type == "FC") {
+            algorithm = layers[l]->pruned ? "sparse" : "dense";
+        } else if (layers[l]->type == "Conv" && layers[l]->convAlgorithm >= 0) {
+            algorithm = convAlgorithms[layers[l]->convAlgorithm];
+        }
+
+        printf("%d\t%s\t%s\t%.4f\t%.4f\n", l, layers[l]->type.c_str(), algorithm,
+            profiledForwards ? layers[l]->forwardTime / profiledForwards : 0,
+            profiledBackwards ? layers[l]->backwardTime / profiledBackwards : 0);
+    }
+}
+
+void Network::tune (std::string cachePath) {
+
+    // Previous decisions, keyed by the machine and the layer shape
+    std::map<std::string, int> decisions;
+    std::string key;
+    int algorithm;
+
+    std::ifstream cacheFile(cachePath);
+
+    while (cacheFile >> key >> algorithm) {
+        decisions[key] = algorithm;
+    }
+
+    cacheFile.close();
+
+    bool updated = false;
+
+    for (int l=1; l<layers.size(); l++) {
+
+        if (layers[l]->type != "Conv") {
+            continue;
+        }
+
+        Layer* layer = layers[l];
+
+        key = NetUtil::machineTag() + "-conv-" + std::to_string(layer->filterWeights[0].size()) + "-" + std::to_string(layer->filterWeights.size())
+            + "-" + std::to_string(layer->filterSize) + "-" + std::to_string(layer->stride)
+            + "-" + std::to_string(layer->zeroPadding) + "-" + std::to_string((int) sqrt(layer->inMapValuesCount));
+
+        if (decisions.count(key)) {
+            layer->convAlgorithm = decisions[key];
+        } else {
+            decisions[key] = NetUtil::benchmarkConvAlgorithms(static_cast<ConvLayer*>(layer), 3);
+            updated = true;
+        }
+    }
+
+    if (updated) {
+        std::ofstream outFile(cachePath);
+
+        for (auto const& decision : decisions) {
+            outFile << decision.first << " " << decision.second << "\n";
+        }
+    }
+}
+
+// The optimizer state values kept for a neuron or filter with the given number of weights, by the update function
+int Network::stateValuesCount (int weightsCount) {
+    switch (updateFnIndex) {
+        case 1: // gain
+        case 2: // adagrad
+        case 3: // rmsprop
+        case 6: // momentum
+            return weightsCount + 1;
+        case 5: // adadelta
+            return 2 * (weightsCount + 1);
+        case 4: // adam
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Five values per layer: its offset into the exported parameters, then its biases, weights, optimizer state and
+// pruning mask counts. FC layers have a mask value per weight, 1 if it's kept, or 0 if it's pruned
+std::vector<int> Network::parametersLayout (void) {
+
+    std::vector<int> layout;
+    int offset = 0;
+
+    for (int l=0; l<layers.size(); l++) {
+
+        Layer* layer = layers[l];
+        int biasesCount = 0;
+        int weightsCount = 0;
+        int stateCount = 0;
+        int maskCount = 0;
+
+        if (l && layer->type=="FC") {
+            // Pruned layers still export full width rows, with 0 in the pruned columns
+            int rowSize = layer->pruned ? layer->denseRowSize : layer->weights[0].size();
+
+            for (int n=0; n<layer->neurons.size(); n++) {
+                biasesCount++;
+                weightsCount += rowSize;
+                stateCount += stateValuesCount(rowSize);
+                maskCount += rowSize;
+            }
+
+        } else if (l && layer->type=="Conv") {
+            for (int f=0; f<layer->filters.size(); f++) {
+                int filterWeightsCount = layer->filterWeights[f].size() * layer->filterSize * layer->filterSize;
+                biasesCount++;
+                weightsCount += filterWeightsCount;
+                stateCount += stateValuesCount(filterWeightsCount);
+            }
+        }
+
+        layout.insert(layout.end(), {offset, biasesCount, weightsCount, stateCount, maskCount});
+        offset += biasesCount + weightsCount + stateCount + maskCount;
+    }
+
+    return layout;
+}
+
+void Network::exportParameters (double* values) {
+    transferParameters(values, true);
+}
+
+// The FC layers get the imported values at their full width, then get pruned by the imported masks
+void Network::importParameters (double* values) {
+
+    for (int l=1; l<layers.size(); l++) {
+        if (layers[l]->type=="FC") {
+            static_cast<FCLayer*>(layers[l])->densify();
+        }
+    }
+
+    transferParameters(values, false);
+
+    for (int l=1; l<layers.size(); l++) {
+
+        Layer* layer = layers[l];
+
+        if (layer->type=="Conv") {
+            layer->winogradStale = true;
+            layer->winogradErrorStale = true;
+            layer->fftStale = true;
+        }
+    }
+
+    resetDeltaWeights();
+}
+
+// Walks every layer's biases, weights, optimizer state and then pruning mask, in the parametersLayout order, either
+// copying them into values, or overwriting them from it
+void Network::transferParameters (double* values, bool exporting) {
+
+    auto transfer = [&](double& parameter) {
+        if (exporting) {
+            *values++ = parameter;
+        } else {
+            parameter = *values++;
+        }
+    };
+
+    auto transferRow = [&](std::vector<double>& row) {
+        for (int i=0; i<row.size(); i++) {
+            transfer(row[i]);
+        }
+    };
+
+    // Pruned FC rows are transferred at their full width, only keeping the imported values in the surviving columns
+    auto transferNeuronRow = [&](FCLayer* layer, std::vector<double>& row, int n, double fill) {
+        if (!layer->pruned) {
+            return transferRow(row);
+        }
+
+        std::vector<double> dense = layer->expandRow(row, n, fill);
+        transferRow(dense);
+
+        if (!exporting) {
+            row = layer->packRow(dense.data(), n);
+        }
+    };
+
+    auto transferVolume = [&](std::vector<std::vector<std::vector<double> > >& volume) {
+        for (int c=0; c<volume.size(); c++) {
+            for (int r=0; r<volume[c].size(); r++) {
+                transferRow(volume[c][r]);
+            }
+        }
+    };
+
+    for (int l=1; l<layers.size(); l++) {
+
+        Layer* layer = layers[l];
+
+        if (layer->type=="FC") {
+
+            FCLayer* fcLayer = static_cast<FCLayer*>(layer);
+
+            transferRow(layer->biases);
+
+            for (int n=0; n<layer->neurons.size(); n++) {
+                transferNeuronRow(fcLayer, layer->weights[n], n, 0);
+            }
+
+            for (int n=0; n<layer->neurons.size(); n++) {
+
+                Neuron* neuron = layer->neurons[n];
+
+                switch (updateFnIndex) {
+                    case 1: // gain
+                        transfer(neuron->biasGain);
+                        transferNeuronRow(fcLayer, neuron->weightGain, n, 1);
+                        break;
+                    case 2: // adagrad
+                    case 3: // rmsprop
+                    case 5: // adadelta
+                    case 6: // momentum
+                        transfer(neuron->biasCache);
+                        transferNeuronRow(fcLayer, neuron->weightsCache, n, 0);
+
+                        if (updateFnIndex == 5) {
+                            transfer(neuron->adadeltaBiasCache);
+                            transferNeuronRow(fcLayer, neuron->adadeltaCache, n, 0);
+                        }
+                        break;
+                    case 4: // adam
+                        transfer(neuron->m);
+                        transfer(neuron->v);
+                        break;
+                }
+            }
+
+            // Imported layers are dense at this point, and only get pruned if the mask prunes any weights
+            int rowSize = layer->pruned ? layer->denseRowSize : layer->weights[0].size();
+
+            if (exporting) {
+                for (int n=0; n<layer->neurons.size(); n++) {
+                    std::vector<double> mask(rowSize, 1);
+
+                    if (layer->pruned) {
+                        mask = fcLayer->expandRow(std::vector<double>(layer->weights[n].size(), 1), n, 0);
+                    }
+                    transferRow(mask);
+                }
+            } else {
+                std::vector<double> mask(layer->neurons.size() * rowSize);
+                transferRow(mask);
+
+                if (std::find(mask.begin(), mask.end(), 0) != mask.end()) {
+                    fcLayer->pruneMask(mask.data());
+                }
+            }
+
+        } else if (layer->type=="Conv") {
+
+            transferRow(layer->biases);
+
+            for (int f=0; f<layer->filters.size(); f++) {
+                transferVolume(layer->filterWeights[f]);
+            }
+
+            for (int f=0; f<layer->filters.size(); f++) {
+
+                Filter* filter = layer->filters[f];
+
+                switch (updateFnIndex) {
+                    case 1: // gain
+                        transfer(filter->biasGain);
+                        transferVolume(filter->weightGain);
+                        break;
+                    case 2: // adagrad
+                    case 3: // rmsprop
+                    case 5: // adadelta
+                    case 6: // momentum
+                        transfer(filter->biasCache);
+                        transferVolume(filter->weightsCache);
+
+                        if (updateFnIndex == 5) {
+                            transfer(filter->adadeltaBiasCache);
+                            transferVolume(filter->adadeltaCache);
+                        }
+                        break;
+                    case 4: // adam
+                        transfer(filter->m);
+                        transfer(filter->v);
+                        break;
+                }
+            }
+        }
+    }
 }
 
 std::vector<Network*> Network::netInstances = {};
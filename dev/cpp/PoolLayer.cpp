@@ -54,34 +54,43 @@ void PoolLayer::backward (bool lastLayer) {
 
     if (nextLayer->type=="FC") {
 
+        // Gather the errors for each output value a whole weights row at a time, then route them to the max indeces
+        std::vector<double> outErrors;
+
+        if (nextLayer->pruned) {
+            outErrors = static_cast<FCLayer*>(nextLayer)->sparseWeightedErrors();
+        } else {
+            outErrors = std::vector<double>(channels * outMapSize * outMapSize, 0);
+
+            for (int n=0; n<nextLayer->neurons.size(); n++) {
+                NetMath::axpy(nextLayer->errs[n], nextLayer->weights[n].data(), outErrors.data(), outErrors.size());
+            }
+        }
+
         for (int c=0; c<channels; c++) {
             for (int r=0; r<outMapSize; r++) {
                 for (int v=0; v<outMapSize; v++) {
 
                     int rowI = indeces[c][r][v][0] + r * stride;
                     int colI = indeces[c][r][v][1] + v * stride;
-                    int weightI = c * outMapSize*outMapSize + r * outMapSize + v;
 
-                    for (int n=0; n<nextLayer->neurons.size(); n++) {
-                        errors[c][rowI][colI] += nextLayer->errs[n] * nextLayer->weights[n][weightI];
-                    }
+                    errors[c][rowI][colI] += outErrors[c * outMapSize*outMapSize + r * outMapSize + v];
                 }
             }
         }
 
     } else if (nextLayer->type=="Conv") {
 
-        for (int c=0; c<channels; c++) {
-
-            // Convolve on the error map
-            std::vector<std::vector<double> > errs = NetUtil::buildConvErrorMap(outMapSize+nextLayer->zeroPadding*2, nextLayer, c);
+        // Convolve on the error maps
+        std::vector<std::vector<std::vector<double> > > errs = NetUtil::buildConvErrorMaps(outMapSize, nextLayer, channels);
 
+        for (int c=0; c<channels; c++) {
             for (int r=0; r<outMapSize; r++) {
                 for (int v=0; v<outMapSize; v++) {
                     int rowI = indeces[c][r][v][0] + r * stride;
                     int colI = indeces[c][r][v][1] + v * stride;
 
-                    errors[c][rowI][colI] += errs[r][v];
+                    errors[c][rowI][colI] += errs[c][r][v];
                 }
             }
         }
@@ -0,0 +1,158 @@
+
+Prefetcher::Prefetcher (Network* n, int slotCount) {
+    net = n;
+    slots.resize(slotCount);
+}
+
+Prefetcher::~Prefetcher (void) {
+    stop();
+}
+
+// Starts loading the epoch's batches from the first one. The training data and order mustn't change until stop()
+void Prefetcher::start (void) {
+
+    if (running) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchSize = net->miniBatchSize;
+        batchCount = (net->trainingData.size() + batchSize - 1) / batchSize;
+        slotBatches.assign(slots.size(), -1);
+        currentBatch = 0;
+        nextBatch = 0;
+        stopping = false;
+        channels = net->layers.size()>1 && net->layers[1]->type=="Conv" ? net->layers[1]->channels : 1;
+    }
+
+    running = true;
+
+    if (background) {
+        loader = std::thread(&Prefetcher::work, this);
+    }
+}
+
+void Prefetcher::stop (void) {
+
+    running = false;
+
+    if (!loader.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slotFree.notify_all();
+    loader.join();
+}
+
+// The loaded batch holding the given iteration's sample, at index iteration % batchSize. Waits for it, if the loader
+// hasn't got to it yet. Asking for it frees up the slots of the batches before it
+Dataset& Prefetcher::batch (int iteration) {
+
+    int batchIndex = iteration / batchSize;
+    int s = batchIndex % slots.size();
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (batchIndex != currentBatch) {
+
+        // Anything other than the next few batches means training skipped around, so loading carries on from there
+        if (batchIndex < currentBatch || batchIndex > nextBatch) {
+            nextBatch = batchIndex;
+        }
+
+        currentBatch = batchIndex;
+        slotFree.notify_all();
+    }
+
+    if (slotBatches[s] != batchIndex) {
+        auto start = std::chrono::steady_clock::now();
+
+        if (background) {
+            batchReady.wait(lock, [&]{ return slotBatches[s]==batchIndex; });
+        } else {
+            // With the lock held, so any other threads training this batch wait for it
+            loadBatch(slots[s], batchIndex);
+            slotBatches[s] = batchIndex;
+            batchesLoaded++;
+        }
+
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stallTime += elapsed;
+        stalls++;
+
+        if (!background) {
+            loadTime += elapsed;
+        }
+    }
+
+    return slots[s];
+}
+
+// Gathers a batch's samples out of the training data, in training order, so they're contiguous even once shuffled,
+// and augments them
+void Prefetcher::loadBatch (Dataset& slot, int batchIndex) {
+
+    Dataset& data = net->trainingData;
+    int first = batchIndex * batchSize;
+    int count = std::min(batchSize, data.size() - first);
+
+    slot.inputSize = data.inputSize;
+    slot.expectedSize = data.expectedSize;
+    slot.stride = data.stride;
+    slot.classes = data.classes;
+    slot.values.resize(count * data.stride);
+
+    for (int i=0; i<count; i++) {
+        float* sample = data.input(net->trainingIndex(first + i));
+        std::copy(sample, sample + data.stride, slot.values.begin() + i * data.stride);
+
+        if (net->augmentation.enabled()) {
+            net->augmentation.apply(slot.input(i), data.inputSize, channels, scratch);
+        }
+    }
+}
+
+// The stall time, stall count, load time and loaded batches count so far
+std::vector<double> Prefetcher::stats (void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {stallTime, (double) stalls, loadTime, (double) batchesLoaded};
+}
+
+void Prefetcher::work (void) {
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        slotFree.wait(lock, [this]{ return stopping || (nextBatch < batchCount && nextBatch < currentBatch + (int) slots.size()); });
+
+        if (stopping) {
+            return;
+        }
+
+        int batchIndex = nextBatch++;
+        int s = batchIndex % slots.size();
+
+        // Still there from before training skipped back
+        if (slotBatches[s] == batchIndex) {
+            continue;
+        }
+
+        slotBatches[s] = -1;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        loadBatch(slots[s], batchIndex);
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        slotBatches[s] = batchIndex;
+        loadTime += elapsed;
+        batchesLoaded++;
+        batchReady.notify_all();
+    }
+}
@@ -0,0 +1,129 @@
+
+Sweep::Sweep (std::vector<Network*> networks) {
+    nets = networks;
+    trainingErrors.assign(nets.size(), 0);
+    validationErrors.assign(nets.size(), 0);
+    epochs.assign(nets.size(), 0);
+    rounds.assign(nets.size(), 0);
+}
+
+// The networks each train on a single thread, with their own validation and prefetching turned off, as the sweep
+// validates them itself, at the end of each round. Without validation data, they're compared by training error.
+// Each network gets its own settings back once it's eliminated, or when the sweep ends
+void Sweep::run (void) {
+
+    Network* first = nets[0];
+    first->stopPrefetching();
+    first->cancelBackgroundValidation();
+    first->trainingData.share();
+    first->validationData.share();
+
+    struct Settings {
+        int prefetch;
+        int threads;
+        bool backgroundValidation;
+        int validationInterval;
+    };
+
+    std::vector<Settings> settings;
+
+    auto restore = [&](int n) {
+        nets[n]->prefetch = settings[n].prefetch;
+        nets[n]->threads = settings[n].threads;
+        nets[n]->backgroundValidation = settings[n].backgroundValidation;
+        nets[n]->validationInterval = settings[n].validationInterval;
+    };
+
+    for (int n=0; n<nets.size(); n++) {
+        Network* net = nets[n];
+        settings.push_back({net->prefetch, net->threads, net->backgroundValidation, net->validationInterval});
+
+        net->stopPrefetching();
+        net->cancelBackgroundValidation();
+        net->prefetch = 0;
+        net->threads = 1;
+        net->backgroundValidation = false;
+        net->validationInterval = 0;
+
+        if (n) {
+            net->trainingData = first->trainingData;
+            net->validationData = first->validationData;
+            net->trainingOrder.clear();
+        }
+    }
+
+    std::vector<int> training(nets.size());
+    std::iota(training.begin(), training.end(), 0);
+
+    ThreadPool* pool = ThreadPool::shared(threads-1);
+
+    while (true) {
+
+        pool->run(training.size(), [&](int t) {
+
+            int n = training[t];
+            Network* net = nets[n];
+
+            for (int e=0; e<roundEpochs; e++) {
+                if (shuffle) {
+                    net->shuffleTrainingOrder();
+                }
+
+                net->train(net->trainingData.size(), 0);
+                trainingErrors[n] = net->error;
+                epochs[n]++;
+            }
+
+            validationErrors[n] = net->validationData.size() ? net->validate() : net->error;
+            net->lastValidationError = validationErrors[n];
+            rounds[n]++;
+        });
+
+        if (training.size() <= 1) {
+            break;
+        }
+
+        // Always drops at least one, so that the sweep ends
+        int kept = std::max(1, std::min((int) training.size()-1, (int) ceil(training.size() * keep)));
+
+        std::stable_sort(training.begin(), training.end(), [&](int a, int b) {
+            return validationErrors[a] < validationErrors[b];
+        });
+
+        for (int t=kept; t<training.size(); t++) {
+            restore(training[t]);
+        }
+        training.resize(kept);
+    }
+
+    for (int t=0; t<training.size(); t++) {
+        restore(training[t]);
+    }
+}
+
+// The networks' indeces, best first: by how many rounds they lasted, then by validation error
+std::vector<int> Sweep::ranking (void) {
+
+    std::vector<int> order(nets.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return rounds[a] != rounds[b] ? rounds[a] > rounds[b] : validationErrors[a] < validationErrors[b];
+    });
+
+    return order;
+}
+
+// A row per network, best first: instance index, validation error, training error, epochs and rounds trained
+std::vector<std::vector<double> > Sweep::results (void) {
+
+    std::vector<std::vector<double> > table;
+    std::vector<int> order = ranking();
+
+    for (int o=0; o<order.size(); o++) {
+        int n = order[o];
+        table.push_back({(double) nets[n]->instanceIndex, validationErrors[n], trainingErrors[n], (double) epochs[n], (double) rounds[n]});
+    }
+
+    return table;
+}
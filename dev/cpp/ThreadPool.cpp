@@ -0,0 +1,186 @@
+
+thread_local bool ThreadPool::inTask = false;
+
+ThreadPool::ThreadPool (int threadCount) {
+    grow(threadCount);
+}
+
+ThreadPool::~ThreadPool (void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskReady.notify_all();
+
+    for (int t=0; t<workers.size(); t++) {
+        workers[t].join();
+    }
+}
+
+// The pool every network instance runs its tasks on, so that networks training side by side share the cores between
+// them, instead of each starting threads of their own. It grows to the most workers asked for, and never shrinks
+ThreadPool* ThreadPool::shared (int threadCount) {
+    static ThreadPool pool(0);
+    pool.grow(threadCount);
+    return &pool;
+}
+
+void ThreadPool::grow (int threadCount) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    while (workers.size() < threadCount) {
+        workers.push_back(std::thread(&ThreadPool::work, this));
+    }
+}
+
+// Runs fn(0) to fn(count-1) as a job, across the workers and the calling thread, returning once they've all finished.
+// The tasks are claimed one at a time, so workers finishing early take on more of them, from whichever job is short
+// of its share. A job's share of the workers is its priority, relative to the other jobs running at the same time.
+// Gang jobs' tasks wait on each other, so they only start once there are enough idle workers to run them all at once.
+// Other jobs called from inside one of the tasks all just run there, as the workers are busy. Gang jobs can't, so they
+// go through the queue, and the pool grows by enough workers for them, on top of the busy ones
+void ThreadPool::run (int count, std::function<void(int)> fn, double priority, bool gang) {
+
+    if (inTask && !(gang && count>1)) {
+        for (int i=0; i<count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    Job job;
+    job.fn = fn;
+    job.count = count;
+    job.remaining = count;
+    job.priority = priority;
+    job.gang = gang && count>1;
+    job.admitted = !job.gang;
+
+    if (job.gang) {
+        int needed = count-1;
+
+        if (inTask) {
+            std::lock_guard<std::mutex> lock(mutex);
+            needed += workers.size() - idleWorkers + reservedWorkers;
+        }
+
+        grow(needed);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs.push_back(&job);
+    admitGangs();
+    taskReady.notify_all();
+
+    while (true) {
+        tasksDone.wait(lock, [&]{ return job.remaining==0 || (job.admitted && job.next<job.count); });
+
+        if (job.remaining==0) {
+            break;
+        }
+
+        runTask(&job, lock);
+    }
+
+    jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+}
+
+// Lets waiting gang jobs start, in the order they came in, setting aside idle workers for all of their tasks
+void ThreadPool::admitGangs (void) {
+
+    for (int j=0; j<jobs.size(); j++) {
+
+        if (!jobs[j]->gang || jobs[j]->admitted) {
+            continue;
+        }
+
+        if (idleWorkers - reservedWorkers < jobs[j]->count-1) {
+            return;
+        }
+
+        jobs[j]->admitted = true;
+        jobs[j]->reserved = jobs[j]->count-1;
+        reservedWorkers += jobs[j]->reserved;
+        taskReady.notify_all();
+        tasksDone.notify_all();
+    }
+}
+
+// The job a worker should take its next task from. Admitted gang jobs come first, as workers have been set aside for
+// them, then whichever job has the fewest threads on it, for its priority. While a gang job is waiting to be let in,
+// the workers don't start anything else, so enough of them become idle for it
+ThreadPool::Job* ThreadPool::nextJob (void) {
+
+    Job* next = 0;
+    bool gangWaiting = false;
+
+    for (int j=0; j<jobs.size(); j++) {
+
+        Job* job = jobs[j];
+
+        if (job->next >= job->count) {
+            continue;
+        }
+
+        if (job->gang) {
+            if (job->admitted) {
+                return job;
+            }
+            gangWaiting = true;
+
+        } else if (!next || job->running * next->priority < next->running * job->priority) {
+            next = job;
+        }
+    }
+
+    return gangWaiting ? 0 : next;
+}
+
+// Claims the job's next task, and runs it with the lock released
+void ThreadPool::runTask (Job* job, std::unique_lock<std::mutex>& lock) {
+
+    int index = job->next++;
+
+    // Frees up the workers set aside for a gang job, once there are fewer of its tasks left to claim
+    int spare = job->reserved - (job->count - job->next);
+
+    if (spare > 0) {
+        job->reserved -= spare;
+        reservedWorkers -= spare;
+    }
+
+    // Gang jobs started from inside a task run their own tasks on the same thread, nested in it
+    bool wasInTask = inTask;
+
+    job->running++;
+    lock.unlock();
+    inTask = true;
+    job->fn(index);
+    inTask = wasInTask;
+    lock.lock();
+    job->running--;
+
+    if (--job->remaining==0) {
+        tasksDone.notify_all();
+    }
+}
+
+void ThreadPool::work (void) {
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!stopping) {
+
+        Job* job = nextJob();
+
+        if (job) {
+            runTask(job, lock);
+            continue;
+        }
+
+        idleWorkers++;
+        admitGangs();
+        taskReady.wait(lock, [this]{ return stopping || nextJob(); });
+        idleWorkers--;
+    }
+}
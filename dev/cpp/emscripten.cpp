@@ -18,6 +18,47 @@ int main(int argc, char const *argv[]) {
     return 0;
 }
 
+// Values handed back to JS which aren't stored contiguously get flattened into here. Unlike a stack array, it
+// stays alive after the call returns, until the next call needing it
+std::vector<double> returnValues;
+
+double* returnBuffer (int size) {
+    if (returnValues.size() < size) {
+        returnValues.resize(size);
+    }
+    return returnValues.data();
+}
+
+// The last get_parametersLayout() result, kept alive the same way
+std::vector<int> layoutValues;
+
+// A neuron's weights, deltas or optimizer state row, at its full width, even when its layer only stores the values
+// which survived pruning
+double* neuronRow (Layer* layer, std::vector<double>& row, int neuronIndex, double fill) {
+
+    if (!layer->pruned) {
+        return row.data();
+    }
+
+    std::vector<double> dense = static_cast<FCLayer*>(layer)->expandRow(row, neuronIndex, fill);
+    double* values = returnBuffer(dense.size());
+    std::copy(dense.begin(), dense.end(), values);
+    return values;
+}
+
+// Sets a neuron's row from full width values, of which pruned layers only keep the surviving columns
+void setNeuronRow (Layer* layer, std::vector<double>& row, int neuronIndex, double* buf, int bufSize) {
+
+    if (layer->pruned) {
+        row = static_cast<FCLayer*>(layer)->packRow(buf, neuronIndex);
+        return;
+    }
+
+    for (int w=0; w<bufSize; w++) {
+        row[w] = buf[w];
+    }
+}
+
 extern "C" {
 
     EMSCRIPTEN_KEEPALIVE
@@ -86,6 +127,23 @@ extern "C" {
         Network::getInstance(instanceIndex)->validationInterval = vr;
     }
 
+    EMSCRIPTEN_KEEPALIVE
+    int get_backgroundValidation (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->backgroundValidation;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_backgroundValidation (int instanceIndex, int background) {
+        Network* net = Network::getInstance(instanceIndex);
+        net->cancelBackgroundValidation();
+#ifdef __EMSCRIPTEN_PTHREADS__
+        net->backgroundValidation = background;
+#else
+        // The validation needs a thread of its own
+        net->backgroundValidation = false;
+#endif
+    }
+
     EMSCRIPTEN_KEEPALIVE
     float get_stoppedEarly (int instanceIndex) {
         return Network::getInstance(instanceIndex)->stoppedEarly;
@@ -204,9 +262,11 @@ extern "C" {
         switch (fnIndex) {
             case 0:
                 net->costFunction = &NetMath::meansquarederror;
+                net->labelCostFunction = &NetMath::meansquarederror;
                 break;
             case 1:
                 net->costFunction = &NetMath::crossentropy;
+                net->labelCostFunction = &NetMath::crossentropy;
                 break;
         }
     }
@@ -218,7 +278,7 @@ extern "C" {
 
         int mapDepth = net->trainingConfusionMatrix.size();
         int mapSpan = net->trainingConfusionMatrix[0].size();
-        double map[mapDepth * mapSpan * mapSpan];
+        double* map = returnBuffer(mapDepth * mapSpan * mapSpan);
 
         for (int r=0; r<mapSpan; r++) {
             for (int c=0; c<mapSpan; c++) {
@@ -237,7 +297,7 @@ extern "C" {
 
         int mapDepth = net->testConfusionMatrix.size();
         int mapSpan = net->testConfusionMatrix[0].size();
-        double map[mapDepth * mapSpan * mapSpan];
+        double* map = returnBuffer(mapDepth * mapSpan * mapSpan);
 
         for (int r=0; r<mapSpan; r++) {
             for (int c=0; c<mapSpan; c++) {
@@ -256,7 +316,7 @@ extern "C" {
 
         int mapDepth = net->validationConfusionMatrix.size();
         int mapSpan = net->validationConfusionMatrix[0].size();
-        double map[mapDepth * mapSpan * mapSpan];
+        double* map = returnBuffer(mapDepth * mapSpan * mapSpan);
 
         for (int r=0; r<mapSpan; r++) {
             for (int c=0; c<mapSpan; c++) {
@@ -497,47 +557,48 @@ extern "C" {
     EMSCRIPTEN_KEEPALIVE
     double* forward (int instanceIndex, float *buf, int vals) {
 
+        // The input layer's values stay sized for the layer, so they don't move, and JS views onto them from
+        // get_input_buffer() stay valid. Missing values are 0, and extra ones are ignored
         Network* net = Network::getInstance(instanceIndex);
-        std::vector<double> input;
+        std::vector<double>& input = net->layers[0]->actvns;
+        input.resize(net->layers[0]->size);
 
-        for (int i=0; i<vals; i++) {
-            input.push_back((double)buf[i]);
+        for (int i=0; i<input.size(); i++) {
+            input[i] = i<vals ? (double)buf[i] : 0;
         }
 
-        std::vector<double> activations = net->forward(input);
-
-        double returnArr[activations.size()];
-        for (int v=0; v<activations.size(); v++) {
-            returnArr[v] = activations[v];
-        }
-
-        auto arrayPtr = &returnArr[0];
-        return arrayPtr;
+        net->forwardLayers();
+        return net->layers[net->layers.size()-1]->actvns.data();
     }
 
+    // The input layer's values, for JS to write the next forward_buffer() input straight into
     EMSCRIPTEN_KEEPALIVE
-    void loadTrainingData (int instanceIndex, float *buf, int total, int size, int dimension) {
+    double* get_input_buffer (int instanceIndex) {
         Network* net = Network::getInstance(instanceIndex);
-        net->trainingData.clear();
-        net->collectErrors = false;
-
-        std::tuple<std::vector<double>, std::vector<double> > epoch;
+        net->layers[0]->actvns.resize(net->layers[0]->size);
+        return net->layers[0]->actvns.data();
+    }
 
-        // Push training data to memory
-        for (int i=0; i<=total; i++) {
+    // The output layer's activations. These stay at the same address across forward passes
+    EMSCRIPTEN_KEEPALIVE
+    double* get_output_buffer (int instanceIndex) {
+        Network* net = Network::getInstance(instanceIndex);
+        return net->layers[net->layers.size()-1]->actvns.data();
+    }
 
-            if (i && i%size==0) {
-                net->trainingData.push_back(epoch);
-                std::get<0>(epoch).clear();
-                std::get<1>(epoch).clear();
-            }
+    EMSCRIPTEN_KEEPALIVE
+    double* forward_buffer (int instanceIndex) {
+        Network::getInstance(instanceIndex)->forwardLayers();
+        return get_output_buffer(instanceIndex);
+    }
 
-            if (i%size<dimension) {
-                std::get<0>(epoch).push_back((double)buf[i]);
-            } else {
-                std::get<1>(epoch).push_back((double)buf[i]);
-            }
-        }
+    EMSCRIPTEN_KEEPALIVE
+    void loadTrainingData (int instanceIndex, float *buf, int total, int size, int dimension, int classes) {
+        Network* net = Network::getInstance(instanceIndex);
+        net->stopPrefetching();
+        net->trainingData.load(buf, total, size, dimension, classes);
+        net->trainingOrder.clear();
+        net->collectErrors = false;
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -546,12 +607,12 @@ extern "C" {
         Network* net = Network::getInstance(instanceIndex);
 
         int errorsCount = net->collectedTrainingErrors.size();
-        double errors[errorsCount+1];
+        double* errors = returnBuffer(errorsCount+1);
         errors[0] = errorsCount;
 
 
         for (int i=1; i<=errorsCount; i++) {
-            errors[i] = net->collectedTrainingErrors[i];
+            errors[i] = net->collectedTrainingErrors[i-1];
         }
 
         auto ptr = &errors[0];
@@ -564,12 +625,12 @@ extern "C" {
         Network* net = Network::getInstance(instanceIndex);
 
         int errorsCount = net->collectedTestErrors.size();
-        double errors[errorsCount+1];
+        double* errors = returnBuffer(errorsCount+1);
         errors[0] = errorsCount;
 
 
         for (int i=1; i<=errorsCount; i++) {
-            errors[i] = net->collectedTestErrors[i];
+            errors[i] = net->collectedTestErrors[i-1];
         }
 
         auto ptr = &errors[0];
@@ -582,12 +643,12 @@ extern "C" {
         Network* net = Network::getInstance(instanceIndex);
 
         int errorsCount = net->collectedValidationErrors.size();
-        double errors[errorsCount+1];
+        double* errors = returnBuffer(errorsCount+1);
         errors[0] = errorsCount;
 
 
         for (int i=1; i<=errorsCount; i++) {
-            errors[i] = net->collectedValidationErrors[i];
+            errors[i] = net->collectedValidationErrors[i-1];
         }
 
         auto ptr = &errors[0];
@@ -600,27 +661,10 @@ extern "C" {
     }
 
     EMSCRIPTEN_KEEPALIVE
-    void loadValidationData (int instanceIndex, float *buf, int total, int size, int dimension) {
+    void loadValidationData (int instanceIndex, float *buf, int total, int size, int dimension, int classes) {
         Network* net = Network::getInstance(instanceIndex);
-        net->validationData.clear();
-
-        std::tuple<std::vector<double>, std::vector<double> > epoch;
-
-        // Push validation data to memory
-        for (int i=0; i<=total; i++) {
-
-            if (i && i%size==0) {
-                net->validationData.push_back(epoch);
-                std::get<0>(epoch).clear();
-                std::get<1>(epoch).clear();
-            }
-
-            if (i%size<dimension) {
-                std::get<0>(epoch).push_back((double)buf[i]);
-            } else {
-                std::get<1>(epoch).push_back((double)buf[i]);
-            }
-        }
+        net->cancelBackgroundValidation();
+        net->validationData.load(buf, total, size, dimension, classes);
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -635,34 +679,55 @@ extern "C" {
         }
     }
 
+    // Trains for up to budgetMs, returning how many items were trained. The epoch is over once trainingCursor is back to 0
+    EMSCRIPTEN_KEEPALIVE
+    int trainFor (int instanceIndex, double budgetMs) {
+        return Network::getInstance(instanceIndex)->trainFor(budgetMs);
+    }
+
     EMSCRIPTEN_KEEPALIVE
-    void loadTestingData (int instanceIndex, float *buf, int total, int size, int dimension) {
+    int get_trainingCursor (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->trainingCursor;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_trainingCursor (int instanceIndex, int cursor) {
+        Network::getInstance(instanceIndex)->trainingCursor = cursor;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void loadTestingData (int instanceIndex, float *buf, int total, int size, int dimension, int classes) {
         Network* net = Network::getInstance(instanceIndex);
-        net->testData.clear();
+        net->testData.load(buf, total, size, dimension, classes);
         net->collectErrors = false;
-        std::tuple<std::vector<double>, std::vector<double> > epoch;
-
-        // Push test data to memory
-        for (int i=0; i<total; i++) {
-            if (i && i%size==0) {
-                net->testData.push_back(epoch);
-                std::get<0>(epoch).clear();
-                std::get<1>(epoch).clear();
-            }
+    }
 
-            if (i%size<dimension) {
-                std::get<0>(epoch).push_back((double)buf[i]);
-            } else {
-                std::get<1>(epoch).push_back((double)buf[i]);
-            }
-        }
+    EMSCRIPTEN_KEEPALIVE
+    void shuffleTrainingData (int instanceIndex) {
+        Network::getInstance(instanceIndex)->shuffleTrainingOrder();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_shuffleSeed (int instanceIndex, int seed) {
+        // The augmentation's too, so seeded runs are repeatable
+        Network* net = Network::getInstance(instanceIndex);
+        net->shuffleRNG.seed(seed);
+        net->augmentation.rng.seed(seed);
+        net->seed = seed;
 
-        net->testData.push_back(epoch);
+        if (net->deterministic) {
+            net->seedStreams();
+        }
     }
 
     EMSCRIPTEN_KEEPALIVE
-    void shuffleTrainingData (int instanceIndex) {
-        NetUtil::shuffle(Network::getInstance(instanceIndex)->trainingData);
+    void set_augmentation (int instanceIndex, int shift, int flip, float rotation, float noise) {
+        Network* net = Network::getInstance(instanceIndex);
+        net->stopPrefetching();
+        net->augmentation.shift = shift;
+        net->augmentation.flip = flip;
+        net->augmentation.rotation = rotation;
+        net->augmentation.noise = noise;
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -686,11 +751,246 @@ extern "C" {
         return avgError;
     }
 
+    EMSCRIPTEN_KEEPALIVE
+    void prune (int instanceIndex, double threshold, float sparsity) {
+        Network::getInstance(instanceIndex)->prune(threshold, sparsity);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void densify (int instanceIndex) {
+        Network::getInstance(instanceIndex)->densify();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void tune (int instanceIndex, char *cachePath) {
+        Network::getInstance(instanceIndex)->tune(cachePath);
+    }
+
+    // Five ints per layer: offset into the exportParameters() values, then biases, weights, optimizer state and pruning
+    // mask counts
+    EMSCRIPTEN_KEEPALIVE
+    int* get_parametersLayout (int instanceIndex) {
+        layoutValues = Network::getInstance(instanceIndex)->parametersLayout();
+        return layoutValues.data();
+    }
+
+    // Every layer's parameters in one buffer, instead of a get_neuron_* / get_filter_* call per neuron and value
+    EMSCRIPTEN_KEEPALIVE
+    double* exportParameters (int instanceIndex) {
+        Network* net = Network::getInstance(instanceIndex);
+        std::vector<int> layout = net->parametersLayout();
+        double* values = returnBuffer(layout[layout.size()-5] + layout[layout.size()-4] + layout[layout.size()-3] + layout[layout.size()-2] + layout[layout.size()-1]);
+        net->exportParameters(values);
+        return values;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int importParameters (int instanceIndex, double *buf, int count) {
+        Network* net = Network::getInstance(instanceIndex);
+        std::vector<int> layout = net->parametersLayout();
+
+        if (count != layout[layout.size()-5] + layout[layout.size()-4] + layout[layout.size()-3] + layout[layout.size()-2] + layout[layout.size()-1]) {
+            return 0;
+        }
+
+        net->importParameters(buf);
+        return 1;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    float get_profiling (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->profiling;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_profiling (int instanceIndex, int p) {
+        Network::getInstance(instanceIndex)->profiling = p;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void printProfile (int instanceIndex) {
+        Network::getInstance(instanceIndex)->printProfile();
+    }
+
     EMSCRIPTEN_KEEPALIVE
     void set_miniBatchSize (int instanceIndex, int mbs) {
         Network::getInstance(instanceIndex)->miniBatchSize = mbs;
     }
 
+    EMSCRIPTEN_KEEPALIVE
+    int get_threads (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->threads;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_threads (int instanceIndex, int threads) {
+#ifdef __EMSCRIPTEN_PTHREADS__
+        // Capped to the PTHREAD_POOL_SIZE pre-spawned workers, less the prefetch loader's and the background
+        // validation's, plus the calling thread
+        Network::getInstance(instanceIndex)->threads = std::max(1, std::min(threads, 9));
+#else
+        // Only the pthreads build (NetWASM.threads.js) can start threads
+        Network::getInstance(instanceIndex)->threads = 1;
+#endif
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int get_hogwild (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->hogwild;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_hogwild (int instanceIndex, int hogwild) {
+        Network::getInstance(instanceIndex)->hogwild = hogwild;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int get_pipeline (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->pipeline;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_pipeline (int instanceIndex, int pipeline) {
+        Network::getInstance(instanceIndex)->pipeline = pipeline;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int get_deterministic (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->deterministic;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_deterministic (int instanceIndex, int deterministic) {
+        Network* net = Network::getInstance(instanceIndex);
+
+        // Only when switched on, so the streams carry on across train() calls
+        if (deterministic && !net->deterministic) {
+            net->deterministic = true;
+            net->seedStreams();
+        }
+        net->deterministic = deterministic;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    double get_priority (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->priority;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_priority (int instanceIndex, double priority) {
+        // Kept above 0, so every network gets some share of the threads
+        Network::getInstance(instanceIndex)->priority = std::max(priority, 0.01);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    double get_parallelThreshold (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->parallelThreshold;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_parallelThreshold (int instanceIndex, double threshold) {
+        Network::getInstance(instanceIndex)->parallelThreshold = threshold;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int get_prefetch (int instanceIndex) {
+        return Network::getInstance(instanceIndex)->prefetch;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_prefetch (int instanceIndex, int prefetch) {
+        // Starts over, with new stats
+        Network* net = Network::getInstance(instanceIndex);
+        delete net->prefetcher;
+        net->prefetcher = 0;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        net->prefetch = std::max(0, prefetch);
+#else
+        // The loader needs a thread of its own
+        net->prefetch = 0;
+#endif
+    }
+
+    // The prefetch loader's stall time (ms), stall count, load time (ms) and loaded batches count
+    EMSCRIPTEN_KEEPALIVE
+    double* get_prefetchStats (int instanceIndex) {
+        Network* net = Network::getInstance(instanceIndex);
+        std::vector<double> stats = net->prefetcher ? net->prefetcher->stats() : std::vector<double>(4, 0);
+        double* values = returnBuffer(4);
+        std::copy(stats.begin(), stats.end(), values);
+        return values;
+    }
+
+    // Trains the networks as a successive halving sweep, on the first one's training and validation data. Returns a row
+    // of 5 values per network, best first: instance index, validation error, training error, epochs and rounds
+    EMSCRIPTEN_KEEPALIVE
+    double* sweep (int* instances, int count, int roundEpochs, double keep, int threads, int shuffle) {
+
+        std::vector<Network*> nets;
+        for (int i=0; i<count; i++) {
+            nets.push_back(Network::getInstance(instances[i]));
+        }
+
+        Sweep sweep(nets);
+        sweep.roundEpochs = roundEpochs;
+        sweep.keep = keep;
+        sweep.shuffle = shuffle;
+#ifdef __EMSCRIPTEN_PTHREADS__
+        sweep.threads = std::max(1, std::min(threads, 9));
+#endif
+        sweep.run();
+
+        std::vector<std::vector<double> > results = sweep.results();
+        double* values = returnBuffer(count * 5);
+
+        for (int r=0; r<results.size(); r++) {
+            std::copy(results[r].begin(), results[r].end(), values + r*5);
+        }
+        return values;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int newEnsemble (int* instances, int count) {
+        return Ensemble::newEnsemble(std::vector<int>(instances, instances + count));
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void deleteEnsemble (int ensembleIndex) {
+        Ensemble::deleteEnsemble(ensembleIndex);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_ensemble_combine (int ensembleIndex, int combine) {
+        Ensemble::getInstance(ensembleIndex)->combine = combine;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_ensemble_weights (int ensembleIndex, double* weights, int count) {
+        Ensemble::getInstance(ensembleIndex)->weights.assign(weights, weights + count);
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void set_ensemble_threads (int ensembleIndex, int threads) {
+#ifdef __EMSCRIPTEN_PTHREADS__
+        Ensemble::getInstance(ensembleIndex)->threads = std::max(1, std::min(threads, 9));
+#else
+        Ensemble::getInstance(ensembleIndex)->threads = 1;
+#endif
+    }
+
+    // Runs the ensemble's networks over a batch of inputs, given one after the other, returning the combined outputs
+    EMSCRIPTEN_KEEPALIVE
+    double* ensemble_forward (int ensembleIndex, float* inputs, int total) {
+
+        Ensemble* ensemble = Ensemble::getInstance(ensembleIndex);
+        Network* net = Network::getInstance(ensemble->networks[0]);
+        std::vector<double> combined = ensemble->forward(inputs, total / net->layers[0]->size);
+
+        double* values = returnBuffer(combined.size());
+        std::copy(combined.begin(), combined.end(), values);
+        return values;
+    }
+
     EMSCRIPTEN_KEEPALIVE
     void resetDeltaWeights (int instanceIndex) {
         Network::getInstance(instanceIndex)->resetDeltaWeights();
@@ -947,7 +1247,7 @@ extern "C" {
 
         int mapDepth = layer->errors.size();
         int mapSpan = layer->errors[0].size();
-        double errors[mapDepth * mapSpan * mapSpan];
+        double* errors = returnBuffer(mapDepth * mapSpan * mapSpan);
 
         for (int d=0; d<mapDepth; d++) {
             for (int r=0; r<mapSpan; r++) {
@@ -982,7 +1282,7 @@ extern "C" {
 
         int mapDepth = layer->activations.size();
         int mapSpan = layer->activations[0].size();
-        double activations[mapDepth * mapSpan * mapSpan];
+        double* activations = returnBuffer(mapDepth * mapSpan * mapSpan);
 
         for (int d=0; d<mapDepth; d++) {
             for (int r=0; r<mapSpan; r++) {
@@ -1017,7 +1317,7 @@ extern "C" {
 
         int mapDepth = layer->indeces.size();
         int mapSpan = layer->indeces[0].size();
-        double indeces[mapDepth * mapSpan * mapSpan];
+        double* indeces = returnBuffer(mapDepth * mapSpan * mapSpan);
 
         for (int d=0; d<mapDepth; d++) {
             for (int r=0; r<mapSpan; r++) {
@@ -1050,26 +1350,14 @@ extern "C" {
     /* Neuron */
     EMSCRIPTEN_KEEPALIVE
     double* get_neuron_weights (int instanceIndex, int layerIndex, int neuronIndex) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        int neuronSize = net->layers[layerIndex]->weights[neuronIndex].size();
-        double weights[neuronSize];
-
-        for (int i=0; i<neuronSize; i++) {
-            weights[i] = net->layers[layerIndex]->weights[neuronIndex][i];
-        }
-
-        auto ptr = &weights[0];
-        return ptr;
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        return neuronRow(layer, layer->weights[neuronIndex], neuronIndex, 0);
     }
 
     EMSCRIPTEN_KEEPALIVE
     void set_neuron_weights (int instanceIndex, int layerIndex, int neuronIndex, double *buf, int bufSize) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        for (int w=0; w<bufSize; w++) {
-            net->layers[layerIndex]->weights[neuronIndex][w] = buf[w];
-        }
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        setNeuronRow(layer, layer->weights[neuronIndex], neuronIndex, buf, bufSize);
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -1084,26 +1372,14 @@ extern "C" {
 
     EMSCRIPTEN_KEEPALIVE
     double* get_neuron_deltaWeights (int instanceIndex, int layerIndex, int neuronIndex) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        int neuronSize = net->layers[layerIndex]->deltaWeights[neuronIndex].size();
-        double deltaWeights[neuronSize];
-
-        for (int i=0; i<neuronSize; i++) {
-            deltaWeights[i] = net->layers[layerIndex]->deltaWeights[neuronIndex][i];
-        }
-
-        auto ptr = &deltaWeights[0];
-        return ptr;
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        return neuronRow(layer, layer->deltaWeights[neuronIndex], neuronIndex, 0);
     }
 
     EMSCRIPTEN_KEEPALIVE
     void set_neuron_deltaWeights (int instanceIndex, int layerIndex, int neuronIndex, double *buf, int bufSize) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        for (int dw=0; dw<bufSize; dw++) {
-            net->layers[layerIndex]->deltaWeights[neuronIndex][dw] = buf[dw];
-        }
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        setNeuronRow(layer, layer->deltaWeights[neuronIndex], neuronIndex, buf, bufSize);
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -1118,50 +1394,26 @@ extern "C" {
 
     EMSCRIPTEN_KEEPALIVE
     double* get_neuron_weightGain (int instanceIndex, int layerIndex, int neuronIndex) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        int neuronSize = net->layers[layerIndex]->neurons[neuronIndex]->weightGain.size();
-        double weightGain[neuronSize];
-
-        for (int i=0; i<neuronSize; i++) {
-            weightGain[i] = net->layers[layerIndex]->neurons[neuronIndex]->weightGain[i];
-        }
-
-        auto ptr = &weightGain[0];
-        return ptr;
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        return neuronRow(layer, layer->neurons[neuronIndex]->weightGain, neuronIndex, 1);
     }
 
     EMSCRIPTEN_KEEPALIVE
     void set_neuron_weightGain (int instanceIndex, int layerIndex, int neuronIndex, double *buf, int bufSize) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        for (int dw=0; dw<bufSize; dw++) {
-            net->layers[layerIndex]->neurons[neuronIndex]->weightGain[dw] = buf[dw];
-        }
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        setNeuronRow(layer, layer->neurons[neuronIndex]->weightGain, neuronIndex, buf, bufSize);
     }
 
     EMSCRIPTEN_KEEPALIVE
     double* get_neuron_weightsCache (int instanceIndex, int layerIndex, int neuronIndex) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        int neuronSize = net->layers[layerIndex]->neurons[neuronIndex]->weightsCache.size();
-        double weightsCache[neuronSize];
-
-        for (int i=0; i<neuronSize; i++) {
-            weightsCache[i] = net->layers[layerIndex]->neurons[neuronIndex]->weightsCache[i];
-        }
-
-        auto ptr = &weightsCache[0];
-        return ptr;
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        return neuronRow(layer, layer->neurons[neuronIndex]->weightsCache, neuronIndex, 0);
     }
 
     EMSCRIPTEN_KEEPALIVE
     void set_neuron_weightsCache (int instanceIndex, int layerIndex, int neuronIndex, double *buf, int bufSize) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        for (int dw=0; dw<bufSize; dw++) {
-            net->layers[layerIndex]->neurons[neuronIndex]->weightsCache[dw] = buf[dw];
-        }
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        setNeuronRow(layer, layer->neurons[neuronIndex]->weightsCache, neuronIndex, buf, bufSize);
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -1216,26 +1468,14 @@ extern "C" {
 
     EMSCRIPTEN_KEEPALIVE
     double* get_neuron_adadeltaCache (int instanceIndex, int layerIndex, int neuronIndex) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        int neuronSize = net->layers[layerIndex]->neurons[neuronIndex]->adadeltaCache.size();
-        double adadeltaCache[neuronSize];
-
-        for (int i=0; i<neuronSize; i++) {
-            adadeltaCache[i] = net->layers[layerIndex]->neurons[neuronIndex]->adadeltaCache[i];
-        }
-
-        auto ptr = &adadeltaCache[0];
-        return ptr;
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        return neuronRow(layer, layer->neurons[neuronIndex]->adadeltaCache, neuronIndex, 0);
     }
 
     EMSCRIPTEN_KEEPALIVE
     void set_neuron_adadeltaCache (int instanceIndex, int layerIndex, int neuronIndex, double *buf, int bufSize) {
-        Network* net = Network::getInstance(instanceIndex);
-
-        for (int dw=0; dw<bufSize; dw++) {
-            net->layers[layerIndex]->neurons[neuronIndex]->adadeltaCache[dw] = buf[dw];
-        }
+        Layer* layer = Network::getInstance(instanceIndex)->layers[layerIndex];
+        setNeuronRow(layer, layer->neurons[neuronIndex]->adadeltaCache, neuronIndex, buf, bufSize);
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -1307,12 +1547,12 @@ extern "C" {
 
         int weightsDepth = layer->filterWeights[filterIndex].size();
         int weightsSpan = layer->filterWeights[filterIndex][0].size();
-        double weights[weightsDepth * weightsSpan * weightsSpan];
+        double* weights = returnBuffer(weightsDepth * weightsSpan * weightsSpan);
 
         for (int d=0; d<weightsDepth; d++) {
             for (int r=0; r<weightsSpan; r++) {
                 for (int c=0; c<weightsSpan; c++) {
-                    weights[d*weightsSpan + r*weightsSpan + c] = layer->filterWeights[filterIndex][d][r][c];
+                    weights[d*weightsSpan*weightsSpan + r*weightsSpan + c] = layer->filterWeights[filterIndex][d][r][c];
                 }
             }
         }
@@ -1333,6 +1573,10 @@ extern "C" {
                 }
             }
         }
+
+        layer->winogradStale = true;
+        layer->winogradErrorStale = true;
+        layer->fftStale = true;
     }
 
     EMSCRIPTEN_KEEPALIVE
@@ -1353,12 +1597,12 @@ extern "C" {
 
         int weightsDepth = layer->filterDeltaWeights[filterIndex].size();
         int weightsSpan = layer->filterDeltaWeights[filterIndex][0].size();
-        double deltaWeights[weightsDepth * weightsSpan * weightsSpan];
+        double* deltaWeights = returnBuffer(weightsDepth * weightsSpan * weightsSpan);
 
         for (int d=0; d<weightsDepth; d++) {
             for (int r=0; r<weightsSpan; r++) {
                 for (int c=0; c<weightsSpan; c++) {
-                    deltaWeights[d*weightsSpan + r*weightsSpan + c] = layer->filterDeltaWeights[filterIndex][d][r][c];
+                    deltaWeights[d*weightsSpan*weightsSpan + r*weightsSpan + c] = layer->filterDeltaWeights[filterIndex][d][r][c];
                 }
             }
         }
@@ -1399,12 +1643,12 @@ extern "C" {
 
         int weightsDepth = filter->weightGain.size();
         int weightsSpan = filter->weightGain[0].size();
-        double weightGain[weightsDepth * weightsSpan * weightsSpan];
+        double* weightGain = returnBuffer(weightsDepth * weightsSpan * weightsSpan);
 
         for (int d=0; d<weightsDepth; d++) {
             for (int r=0; r<weightsSpan; r++) {
                 for (int c=0; c<weightsSpan; c++) {
-                    weightGain[d*weightsSpan + r*weightsSpan + c] = filter->weightGain[d][r][c];
+                    weightGain[d*weightsSpan*weightsSpan + r*weightsSpan + c] = filter->weightGain[d][r][c];
                 }
             }
         }
@@ -1445,12 +1689,12 @@ extern "C" {
 
         int weightsDepth = filter->weightsCache.size();
         int weightsSpan = filter->weightsCache[0].size();
-        double weightsCache[weightsDepth * weightsSpan * weightsSpan];
+        double* weightsCache = returnBuffer(weightsDepth * weightsSpan * weightsSpan);
 
         for (int d=0; d<weightsDepth; d++) {
             for (int r=0; r<weightsSpan; r++) {
                 for (int c=0; c<weightsSpan; c++) {
-                    weightsCache[d*weightsSpan + r*weightsSpan + c] = filter->weightsCache[d][r][c];
+                    weightsCache[d*weightsSpan*weightsSpan + r*weightsSpan + c] = filter->weightsCache[d][r][c];
                 }
             }
         }
@@ -1491,12 +1735,12 @@ extern "C" {
 
         int weightsDepth = filter->adadeltaCache.size();
         int weightsSpan = filter->adadeltaCache[0].size();
-        double adadeltaCache[weightsDepth * weightsSpan * weightsSpan];
+        double* adadeltaCache = returnBuffer(weightsDepth * weightsSpan * weightsSpan);
 
         for (int d=0; d<weightsDepth; d++) {
             for (int r=0; r<weightsSpan; r++) {
                 for (int c=0; c<weightsSpan; c++) {
-                    adadeltaCache[d*weightsSpan + r*weightsSpan + c] = filter->adadeltaCache[d][r][c];
+                    adadeltaCache[d*weightsSpan*weightsSpan + r*weightsSpan + c] = filter->adadeltaCache[d][r][c];
                 }
             }
         }
@@ -1546,7 +1790,7 @@ extern "C" {
 
         int activationMapDepth = layer->activations[filterIndex].size();
         int activationMapSpan = layer->activations[filterIndex][0].size();
-        double activationMap[activationMapDepth * activationMapSpan * activationMapSpan];
+        double* activationMap = returnBuffer(activationMapDepth * activationMapSpan * activationMapSpan);
 
         for (int r=0; r<activationMapSpan; r++) {
             for (int c=0; c<activationMapSpan; c++) {
@@ -1577,7 +1821,7 @@ extern "C" {
 
         int errorMapDepth = layer->errors[filterIndex].size();
         int errorMapSpan = layer->errors[filterIndex][0].size();
-        double errorMap[errorMapDepth * errorMapSpan * errorMapSpan];
+        double* errorMap = returnBuffer(errorMapDepth * errorMapSpan * errorMapSpan);
 
         for (int r=0; r<errorMapSpan; r++) {
             for (int c=0; c<errorMapSpan; c++) {
@@ -1608,7 +1852,7 @@ extern "C" {
 
         int sumMapDepth = filter->sumMap.size();
         int sumMapSpan = filter->sumMap[0].size();
-        double sumMap[sumMapDepth * sumMapSpan * sumMapSpan];
+        double* sumMap = returnBuffer(sumMapDepth * sumMapSpan * sumMapSpan);
 
         for (int r=0; r<sumMapSpan; r++) {
             for (int c=0; c<sumMapSpan; c++) {
@@ -1639,7 +1883,7 @@ extern "C" {
 
         int dropoutMapDepth = filter->dropoutMap.size();
         int dropoutMapSpan = filter->dropoutMap[0].size();
-        double dropoutMap[dropoutMapDepth * dropoutMapSpan * dropoutMapSpan];
+        double* dropoutMap = returnBuffer(dropoutMapDepth * dropoutMapSpan * dropoutMapSpan);
 
         for (int r=0; r<dropoutMapSpan; r++) {
             for (int c=0; c<dropoutMapSpan; c++) {
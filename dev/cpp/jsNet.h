@@ -1,16 +1,101 @@
 #include <vector>
+#include <memory>
 #include <tuple>
 #include <map>
+#include <complex>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <random>
 #include <tgmath.h>
 
 // For easier debugging
 // #include "printv.h"
 
+// Hot kernels are compiled for several instruction sets, with the best one picked at load time via CPUID (through an ifunc
+// resolver), and a baseline x86-64 fallback. Emscripten and other platforms just get the one plain version.
+// Define JSNET_NO_KERNEL_DISPATCH to turn this off. The versions add up in different orders, so deterministic training
+// only repeats bit for bit on machines running the same version (and with the same WebAssembly build).
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(__EMSCRIPTEN__) && !defined(JSNET_NO_KERNEL_DISPATCH)
+    #define JSNET_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+    #define JSNET_KERNEL_DISPATCH
+#else
+    #define JSNET_KERNEL
+#endif
+
+// The SIMD128 WebAssembly build (emcc -msimd128) vectorizes the same kernels with f64x2 intrinsics instead
+#ifdef __wasm_simd128__
+    #include <wasm_simd128.h>
+#endif
+
 class Layer;
 class Neuron;
 class Filter;
 class NetMath;
 class NetUtil;
+class ThreadPool;
+class Prefetcher;
+class Sweep;
+class Ensemble;
+
+// A data set's samples, as floats in one contiguous block. Each sample is its input values, followed by its expected
+// values, stride values apart. Classification data sets can instead store each sample's class index as its one
+// expected value. Once shared, the values are read-only, and copies of the data set all read the same ones
+class Dataset {
+public:
+    std::vector<float> values;
+    std::shared_ptr<std::vector<float> > shared; // The values, once shared, instead of values
+    int inputSize=0;
+    int expectedSize=0;
+    int stride=0;
+    int classes=0; // How many classes there are, for class index (label) samples. 0 for expected values
+
+    Dataset () {}
+
+    void load (const float* buf, int total, int sampleSize, int dimension, int classCount);
+
+    void push_back (std::vector<double> input, std::vector<double> expected);
+
+    void push_back (std::vector<double> input, int label);
+
+    int size (void);
+
+    void clear (void);
+
+    void share (void);
+
+    float* data (void);
+
+    float* input (int index);
+
+    float* expected (int index);
+
+    std::vector<double> expectedValues (int index);
+
+    int label (int index);
+};
+
+// Random changes made to training samples' inputs as they're loaded, so every epoch sees new variants of the same
+// stored data. Shifts, flips and rotations need channels x span x span (image) inputs. Noise works on any
+class Augmentation {
+public:
+    int shift=0; // Max pixels to shift by, along each axis
+    bool flip=false; // Mirrors horizontally, half the time
+    float rotation=0; // Max degrees to rotate by, either way
+    float noise=0; // Standard deviation of the gaussian noise added to each value
+    std::mt19937 rng;
+
+    Augmentation () {}
+
+    bool enabled (void);
+
+    void apply (float* input, int size, int channels, std::vector<float>& scratch);
+
+    static void transform (float* input, int channels, int span, int dx, int dy, bool mirror, double angle,
+        std::vector<float>& scratch);
+};
 
 class Network {
 public:
@@ -47,13 +132,15 @@ public:
     int earlyStoppingPatience=0;
     int earlyStoppingPatienceCounter=0;
     float earlyStoppingPercent=0;
+    bool validationBackedUp=false; // Whether there's a back-up that restoreValidation() hasn't swapped in yet
     std::vector<Layer*> layers;
-    std::vector<std::tuple<std::vector<double>, std::vector<double> > > trainingData;
-    std::vector<std::tuple<std::vector<double>, std::vector<double> > > validationData;
-    std::vector<std::tuple<std::vector<double>, std::vector<double> > > testData;
+    Dataset trainingData;
+    Dataset validationData;
+    Dataset testData;
     std::map<std::string, float> weightsConfig;
     double (*activation)(double, bool, Neuron*);
     double (*costFunction)(std::vector<double> calculated, std::vector<double> desired);
+    double (*labelCostFunction)(int label, const std::vector<double>& output)=0;
     std::vector<double> (*weightInitFn)(int netInstance, int layerIndex, int size);
 
     std::vector<std::vector<int>> trainingConfusionMatrix;
@@ -67,6 +154,37 @@ public:
 
     int updateFnIndex;
 
+    bool profiling=false;
+    int profiledForwards=0;
+    int profiledBackwards=0;
+
+    int threads=1; // Training/validation threads. Each one past the first gets a replica of the network
+    bool hogwild=false; // Train the threads' slices asynchronously, updating the shared weights without locking
+    bool pipeline=false; // Split the layers across the threads instead of the mini batches, pipelining the samples
+    std::vector<Network*> replicas;
+    ThreadPool* threadPool=0; // The shared pool, once threads are used
+    double priority=1; // This network's share of the shared pool's workers, relative to the other networks'
+    double parallelThreshold=65536; // Roughly how many multiply-adds a layer pass needs, to be split across the threads
+    bool deterministic=false; // Repeat seeded multi-threaded runs bit for bit, on the same instruction set, at some cost to throughput
+    unsigned int seed=0; // The last shuffle seed, which deterministic networks' layers seed their streams from
+
+    std::vector<int> trainingOrder; // Indeces into trainingData, in the order they're trained in, once shuffled
+    std::mt19937 shuffleRNG;
+
+    int prefetch=0; // Mini batches to load ahead on a background thread, while training. 0 to load them in place
+    Prefetcher* prefetcher=0;
+    Augmentation augmentation;
+
+    bool backgroundValidation=false; // Validate a snapshot of the weights on a background thread, while training carries on
+    Network* validator=0; // Holds the snapshot
+    std::thread validationThread;
+    std::atomic<bool> validationDone{false};
+    bool validationPending=false; // Started, and not yet collected
+    double backgroundValidationError=0;
+
+    int trainingCursor=0; // Next training item for trainFor(), back to 0 once an epoch is done
+    double epochTrainingError=0; // Summed training error so far in the trainFor() epoch
+
     Network () {}
 
     ~Network ();
@@ -83,14 +201,80 @@ public:
 
     std::vector<double> forward (std::vector<double> input);
 
+    void forwardLayers (void);
+
     void backward (void);
 
     void train (int iterations, int startIndex);
 
+    void trainParallel (int iterations, int startIndex);
+
+    void trainPipelined (int batchStart, int batchSize, double& batchError, std::vector<double>& batchCollectedErrors);
+
+    void trainHogwild (int iterations, int startIndex);
+
+    void applyHogwildDeltas (Network* worker);
+
+    int trainFor (double budgetMs);
+
+    int trainingIndex (int iteration);
+
+    void shuffleTrainingOrder (void);
+
+    Dataset& trainingSample (int iteration, int& index);
+
+    void startPrefetching (void);
+
+    void stopPrefetching (void);
+
+    std::vector<double> forwardItem (Dataset& data, int index);
+
+    std::vector<double> forwardTrainingItem (Dataset& data, int index);
+
+    void outputErrors (Dataset& data, int index, const std::vector<double>& output);
+
     double validate (void);
 
+    bool startBackgroundValidation (void);
+
+    bool finishBackgroundValidation (bool wait);
+
+    void cancelBackgroundValidation (void);
+
+    void finishEpochValidation (int end);
+
+    static void joinBackgroundValidations (void);
+
+    bool validated (Network* snapshot);
+
+    double evaluateItem (Dataset& data, int index, std::vector<std::vector<int> >& confusionMatrix);
+
+    double sampleCost (Dataset& data, int index, const std::vector<double>& output);
+
+    void createReplicas (void);
+
+    void createThreadPool (void);
+
+    void parallelFor (int count, double work, const std::function<void(int, int)>& fn);
+
+    Network* createReplica (void);
+
+    void syncReplicas (void);
+
+    void syncReplica (Network* replica);
+
+    void reduceReplicas (void);
+
+    void addDeltas (Network* source);
+
+    void seedStreams (void);
+
+    double dropoutDraw (Layer* layer);
+
     bool checkEarlyStopping (void);
 
+    bool checkEarlyStopping (Network* validated);
+
     double test (int iterations, int startIndex);
 
     void resetDeltaWeights (void);
@@ -99,6 +283,163 @@ public:
 
     void restoreValidation (void);
 
+    void prune (double threshold, float sparsity);
+
+    void densify (void);
+
+    void printProfile (void);
+
+    void tune (std::string cachePath);
+
+    int stateValuesCount (int weightsCount);
+
+    std::vector<int> parametersLayout (void);
+
+    void exportParameters (double* values);
+
+    void importParameters (double* values);
+
+    void transferParameters (double* values, bool exporting);
+
+};
+
+
+// A set of worker threads, which calling threads join in on, for running jobs of indexed tasks. One of them is shared by
+// all the network instances, which get fair shares of its workers, weighted by their priority
+class ThreadPool {
+public:
+    struct Job {
+        std::function<void(int)> fn;
+        int count=0;
+        int next=0; // The next task to be claimed
+        int remaining=0; // Tasks not yet finished
+        int running=0; // Threads working on its tasks
+        double priority=1;
+        bool gang=false; // The tasks wait on each other, so they all need a thread at once
+        bool admitted=true;
+        int reserved=0; // Idle workers set aside for its unclaimed tasks
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<Job*> jobs;
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable tasksDone;
+    int idleWorkers=0;
+    int reservedWorkers=0;
+    bool stopping=false;
+    static thread_local bool inTask; // Whether this thread is running one of a pool's tasks
+
+    ThreadPool (int threadCount);
+
+    ~ThreadPool (void);
+
+    static ThreadPool* shared (int threadCount);
+
+    void grow (int threadCount);
+
+    void run (int count, std::function<void(int)> fn, double priority=1, bool gang=false);
+
+    void admitGangs (void);
+
+    Job* nextJob (void);
+
+    void runTask (Job* job, std::unique_lock<std::mutex>& lock);
+
+    void work (void);
+};
+
+// Loads upcoming training mini batches, in training order, into a ring of batch sized data sets, on a background
+// thread, while the current one trains. Samples get augmented as they're loaded. Without the background thread,
+// each batch is loaded in place, when first asked for
+class Prefetcher {
+public:
+    Network* net;
+    bool background=true;
+    bool running=false;
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable slotFree;
+    std::condition_variable batchReady;
+    std::vector<Dataset> slots;
+    std::vector<int> slotBatches; // The batch each slot holds, or -1 while it's empty or being loaded
+    int batchSize=0;
+    int batchCount=0;
+    int currentBatch=0; // The batch being trained. The loader doesn't touch its slot
+    int nextBatch=0;
+    bool stopping=false;
+    int channels=1; // Of the input images, for augmenting them
+    std::vector<float> scratch;
+
+    double stallTime=0; // ms the training thread spent waiting on the loader
+    int stalls=0;
+    double loadTime=0; // ms the loader spent loading batches
+    int batchesLoaded=0;
+
+    Prefetcher (Network* net, int slotCount);
+
+    ~Prefetcher (void);
+
+    void start (void);
+
+    void stop (void);
+
+    Dataset& batch (int iteration);
+
+    void loadBatch (Dataset& slot, int batchIndex);
+
+    std::vector<double> stats (void);
+
+    void work (void);
+};
+
+// Trains several network instances side by side, one per thread of the shared pool, on one shared copy of the first
+// one's training and validation data. Uses successive halving: after each round of epochs, only the networks with the
+// lowest validation errors carry on training, until one is left
+class Sweep {
+public:
+    std::vector<Network*> nets;
+    int roundEpochs=1;
+    double keep=0.5; // The fraction of the networks carrying on after each round
+    int threads=1;
+    bool shuffle=false;
+
+    // The results, per network
+    std::vector<double> trainingErrors;
+    std::vector<double> validationErrors;
+    std::vector<int> epochs;
+    std::vector<int> rounds; // How many rounds each one trained for
+
+    Sweep (std::vector<Network*> networks);
+
+    void run (void);
+
+    std::vector<int> ranking (void);
+
+    std::vector<std::vector<double> > results (void);
+};
+
+// Several network instances with the same input and output sizes, run over a shared batch of inputs, with their
+// outputs combined into one per input: averaged, weighted averaged, or as the share of the networks voting for each class
+class Ensemble {
+public:
+    static std::vector<Ensemble*> ensembleInstances;
+    int instanceIndex;
+    std::vector<int> networks; // The networks' instance indeces
+    std::vector<double> weights; // Per network, for the weighted average
+    int combine=0; // 0 for the mean, 1 for the weighted mean, 2 for votes
+    int threads=1;
+    std::vector<std::vector<double> > outputs; // Each network's outputs for the last batch
+
+    static int newEnsemble (std::vector<int> instances);
+
+    static void deleteEnsemble (int index);
+
+    static Ensemble* getInstance (int index);
+
+    std::vector<double> forward (const float* inputs, int count);
+
+    std::vector<double> combineOutputs (int count, int outputSize);
 };
 
 
@@ -140,6 +481,28 @@ public:
     std::vector<double> errs; // FC
     std::vector<double> actvns; // FC
 
+    bool pruned=false; // FC. Each neuron's weights, deltas, back-up and optimizer state rows then only hold the values in its surviving columns
+    std::vector<int> sparseRowStarts; // FC, CSR row offsets into sparseColumns, per neuron
+    std::vector<int> sparseColumns; // FC, indeces of the weights which survived pruning
+    int denseRowSize=0; // FC, how many weights each neuron had before pruning
+
+    bool winogradStale=true; // Conv, set whenever the filterWeights change
+    bool winogradErrorStale=true; // Conv
+    int winogradTile=0; // Conv, output tile size m of the cached F(mxm, 3x3) transforms
+    int winogradErrorTile=0; // Conv
+    std::vector<double> winogradWeights; // Conv, transformed filterWeights, [filter][channel][tile value]
+    std::vector<double> winogradErrorWeights; // Conv, transformed rotated filterWeights, [channel][filter][tile value]
+
+    int convAlgorithm=-1; // Conv, 0 direct, 1 Winograd, 2 FFT, 3 im2col + GEMM, or -1 until picked by NetUtil::pickConvAlgorithm / Network::tune
+    bool fftStale=true; // Conv
+    int fftSize=0; // Conv, width of the (power of 2) grid the cached spectra were computed on
+    std::vector<std::vector<std::complex<double> > > fftWeights; // Conv, filterWeights spectra, [filter*channels + channel]
+
+    double forwardTime=0; // Total ms spent in forward, while profiling
+    double backwardTime=0;
+
+    std::mt19937 rng; // Dropout draws, when the network is deterministic
+
     Layer* nextLayer;
     Layer* prevLayer;
     double (*activation)(double, bool, Neuron*);
@@ -194,6 +557,22 @@ public:
     void backUpValidation (void);
 
     void restoreValidation (void);
+
+    void prune (double threshold);
+
+    void pruneToSparsity (float sparsity);
+
+    void pruneMask (const double* mask);
+
+    void densify (void);
+
+    void pack (void);
+
+    std::vector<double> expandRow (const std::vector<double>& row, int n, double fill);
+
+    std::vector<double> packRow (const double* values, int n);
+
+    std::vector<double> sparseWeightedErrors (void);
 };
 
 class ConvLayer : public Layer {
@@ -333,6 +712,10 @@ public:
 
     static double crossentropy (std::vector<double> target, std::vector<double> output);
 
+    static double meansquarederror (int label, const std::vector<double>& output);
+
+    static double crossentropy (int label, const std::vector<double>& output);
+
     static double vanillasgd (int netInstance, double value, double deltaValue);
 
     static double gain(int netInstance, double value, double deltaValue, Neuron* neuron, int weightIndex);
@@ -378,12 +761,20 @@ public:
     static void maxNorm(int netInstance);
 
     static double sech (double value);
+
+    JSNET_KERNEL static double dot (const double* a, const double* b, int n);
+
+    JSNET_KERNEL static void axpy (double alpha, const double* x, double* y, int n);
+
+    JSNET_KERNEL static void multiplyAccumulate (const double* a, const double* b, double* out, int n);
+
+    JSNET_KERNEL static double sgdUpdate (double* values, const double* deltaValues, int n, double learningRate, double l2, double l1, int miniBatchSize);
 };
 
 class NetUtil {
 public:
 
-    static void shuffle (std::vector<std::tuple<std::vector<double>, std::vector<double> > > &values);
+    static void shuffle (std::vector<int>& indeces, std::mt19937& rng);
 
     static std::vector<std::vector<double> > addZeroPadding (std::vector<std::vector<double> > map, int zP);
 
@@ -399,8 +790,57 @@ public:
 
     static std::vector<std::vector<double> > buildConvErrorMap (int paddedLength, Layer* nextLayer, int filterI);
 
+    static std::vector<std::vector<std::vector<double> > > buildConvErrorMaps (int mapSize, Layer* nextLayer, int channels);
+
+    static int winogradTileSize (int outSize);
+
+    static void winogradTransform (const double* transform, int rows, int columns, const double* values, double* out);
+
+    static std::vector<double> winogradFilters (const std::vector<std::vector<std::vector<std::vector<double> > > > &weights, int tile, bool rotate);
+
+    static std::vector<std::vector<std::vector<double> > > winogradConvolve (const std::vector<std::vector<std::vector<double> > > &input, int zP,
+        const std::vector<double> &filters, int outMaps, int tile);
+
+    static int pickConvAlgorithm (int filters, int channels, int filterSize, int stride, int zeroPadding, int inSize);
+
+    static int getConvAlgorithm (Layer* layer, int inSize);
+
+    static int fftGridSize (int size);
+
+    static void fft (std::complex<double>* values, int n, int step, bool inverse);
+
+    static void fft2D (std::vector<std::complex<double> > &values, int n, bool inverse);
+
+    static std::vector<std::complex<double> > mapSpectrum (const std::vector<std::vector<double> > &map, int n, int offset);
+
+    static void updateFFTWeights (Layer* layer, int n);
+
+    static std::vector<std::vector<std::vector<double> > > fftConvolve (const std::vector<std::vector<std::vector<double> > > &input, Layer* layer);
+
+    static std::vector<std::vector<std::vector<double> > > fftConvErrorMaps (int mapSize, Layer* nextLayer, int channels);
+
+    static void fftConvDWeights (ConvLayer* layer);
+
+    static void gemm (const double* a, const double* b, double* c, int m, int n, int k, bool transposeA, bool transposeB);
+
+    static std::vector<double> im2col (const std::vector<std::vector<std::vector<double> > > &input, int filterSize, int zP, int stride);
+
+    static std::vector<double> flattenFilters (const std::vector<std::vector<std::vector<std::vector<double> > > > &weights);
+
+    static std::vector<std::vector<std::vector<double> > > gemmConvolve (const std::vector<std::vector<std::vector<double> > > &input, Layer* layer);
+
+    static std::vector<std::vector<std::vector<double> > > gemmConvErrorMaps (int mapSize, Layer* nextLayer, int channels);
+
+    static void gemmConvDWeights (ConvLayer* layer);
+
+    static int benchmarkConvAlgorithms (ConvLayer* layer, int iterations);
+
+    static std::string machineTag (void);
+
     static void buildConvDWeights (ConvLayer* layer);
 
     static std::vector<double> getActivations (Layer* layer, int mapStartI, int mapSize);
 
+    static std::vector<double> flattenVolume (const std::vector<std::vector<std::vector<double> > > &volume);
+
 };
@@ -119,7 +119,29 @@ class ConvLayer {
         })
     }
 
-    toJSON () {
+    // The params are this layer's biases and weights views, from net.exportParameters(), if given
+    toJSON (params) {
+
+        if (params) {
+            const filterSize = this.filterSize
+            const filterWeightsCount = params.weights.length / this.filters.length
+            const channels = filterWeightsCount / filterSize**2
+
+            return {
+                weights: this.filters.map((filter, fi) => {
+                    return {
+                        bias: params.biases[fi],
+                        weights: [...new Array(channels)].map((_, c) => {
+                            return [...new Array(filterSize)].map((_, r) => {
+                                const start = fi*filterWeightsCount + (c*filterSize + r)*filterSize
+                                return Array.from(params.weights.subarray(start, start+filterSize))
+                            })
+                        })
+                    }
+                })
+            }
+        }
+
         return {
             weights: this.filters.map(filter => {
                 return {
@@ -130,7 +152,34 @@ class ConvLayer {
         }
     }
 
-    fromJSON (data, layerIndex) {
+    fromJSON (data, layerIndex, params) {
+
+        if (params) {
+            const filterSize = this.filterSize
+            const filterWeightsCount = params.weights.length / this.filters.length
+            const channels = filterWeightsCount / filterSize**2
+
+            this.filters.forEach((filter, fi) => {
+
+                if (data.weights[fi].weights.length != channels) {
+                    throw new Error(`Mismatched weights depth. Given: ${data.weights[fi].weights.length} Existing: ${channels}. At: layers[${layerIndex}], filters[${fi}]`)
+                }
+
+                if (data.weights[fi].weights[0].length != filterSize) {
+                    throw new Error(`Mismatched weights size. Given: ${data.weights[fi].weights[0].length} Existing: ${filterSize}. At: layers[${layerIndex}], filters[${fi}]`)
+                }
+
+                params.biases[fi] = data.weights[fi].bias
+
+                for (let c=0; c<channels; c++) {
+                    for (let r=0; r<filterSize; r++) {
+                        params.weights.set(data.weights[fi].weights[c][r], fi*filterWeightsCount + (c*filterSize + r)*filterSize)
+                    }
+                }
+            })
+            return
+        }
+
         this.filters.forEach((filter, fi) => {
 
             if (data.weights[fi].weights.length != filter.weights.length) {
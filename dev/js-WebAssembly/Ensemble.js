@@ -0,0 +1,84 @@
+"use strict"
+
+class Ensemble {
+
+    constructor ({Module, networks=[], combine="mean", weights, threads=1}={}) {
+
+        if (!Module) {
+            throw new Error("WASM module not provided")
+        }
+
+        if (!networks.length) {
+            throw new Error("No networks provided")
+        }
+
+        if (networks.some(net => net.state!="initialised")) {
+            throw new Error("The network layers have not been initialised.")
+        }
+
+        const [inputSize, outputSize] = Ensemble.sizes(networks[0])
+
+        if (networks.some(net => Ensemble.sizes(net)[0]!=inputSize || Ensemble.sizes(net)[1]!=outputSize)) {
+            throw new Error("The networks' input and output sizes must match.")
+        }
+
+        NetUtil.Module = Module
+        this.Module = Module
+        this.networks = networks
+        this.inputSize = inputSize
+        this.outputSize = outputSize
+        this.ensembleInstance = NetUtil.ccallArrays("newEnsemble", "number", ["array"], [networks.map(net => net.netInstance)], {heapIn: "HEAP32"})
+
+        this.combine = NetUtil.format(combine)
+
+        if (!["mean", "weighted", "vote"].includes(this.combine)) {
+            throw new Error(`Unknown ensemble combination: ${combine}`)
+        }
+
+        this.Module.ccall("set_ensemble_combine", null, ["number", "number"], [this.ensembleInstance, ["mean", "weighted", "vote"].indexOf(this.combine)])
+
+        if (weights) {
+            NetUtil.ccallArrays("set_ensemble_weights", null, ["number", "array"], [this.ensembleInstance, weights], {heapIn: "HEAPF64"})
+        }
+
+        this.Module.ccall("set_ensemble_threads", null, ["number", "number"], [this.ensembleInstance, threads])
+    }
+
+    static sizes (net) {
+        return [net.layers[0].size, net.layers[net.layers.length-1].size]
+    }
+
+    // Runs all the networks over a batch of inputs, copied into the WASM memory once, and returns their combined
+    // output for each one
+    forward (inputs) {
+
+        if (inputs === undefined || inputs === null) {
+            throw new Error("No data passed to Ensemble.forward()")
+        }
+
+        const flat = new Float32Array(inputs.length * this.inputSize)
+
+        for (let i=0; i<inputs.length; i++) {
+            // Volume inputs get flattened
+            const input = Array.isArray(inputs[i][0]) ? [].concat(...inputs[i].map(map => [].concat(...map))) : inputs[i]
+            flat.set(input, i * this.inputSize)
+        }
+
+        const pointer = NetUtil.ccallArrays("ensemble_forward", "number", ["number", "array"], [this.ensembleInstance, flat])
+        const outputs = []
+
+        for (let i=0; i<inputs.length; i++) {
+            outputs.push(Array.from(this.Module.HEAPF64.subarray(pointer/8 + i*this.outputSize, pointer/8 + (i+1)*this.outputSize)))
+        }
+
+        return outputs
+    }
+
+    delete () {
+        this.Module.ccall("deleteEnsemble", null, ["number"], [this.ensembleInstance])
+    }
+}
+
+/* istanbul ignore next */
+typeof window!="undefined" && (window.Ensemble = Ensemble)
+exports.Ensemble = Ensemble
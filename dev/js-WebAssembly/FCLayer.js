@@ -59,7 +59,23 @@ class FCLayer {
         })
     }
 
-    toJSON () {
+    // The params are this layer's biases and weights views, from net.exportParameters(), if given
+    toJSON (params) {
+
+        if (params) {
+            const weightsCount = params.weights.length / this.neurons.length
+
+            return {
+                weights: this.neurons.map((neuron, ni) => {
+                    // The input layer has no parameters
+                    return params.biases.length ? {
+                        bias: params.biases[ni],
+                        weights: Array.from(params.weights.subarray(ni*weightsCount, (ni+1)*weightsCount))
+                    } : {}
+                })
+            }
+        }
+
         return {
             weights: this.neurons.map(neuron => {
                 return {
@@ -70,7 +86,22 @@ class FCLayer {
         }
     }
 
-    fromJSON (data, layerIndex) {
+    fromJSON (data, layerIndex, params) {
+
+        if (params) {
+            const weightsCount = params.weights.length / this.neurons.length
+
+            this.neurons.forEach((neuron, ni) => {
+
+                if (data.weights[ni].weights.length!=weightsCount) {
+                    throw new Error(`Mismatched weights count. Given: ${data.weights[ni].weights.length} Existing: ${weightsCount}. At layers[${layerIndex}], neurons[${ni}]`)
+                }
+
+                params.biases[ni] = data.weights[ni].bias
+                params.weights.set(data.weights[ni].weights, ni*weightsCount)
+            })
+            return
+        }
 
         this.neurons.forEach((neuron, ni) => {
 
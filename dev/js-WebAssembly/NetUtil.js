@@ -14,62 +14,60 @@ class NetUtil {
         heapMap.HEAPF32 = Float32Array // float
         heapMap.HEAPF64 = Float64Array // double
 
-        let res
-        let error
         paramTypes = paramTypes || []
         const returnTypeParam = returnType=="array" ? "number" : returnType
         const parameters = []
         const parameterTypes = []
-        const bufs = []
 
-        try {
-            if (params) {
-                for (let p=0; p<params.length; p++) {
-
-                    if (paramTypes[p] == "array" || Array.isArray(params[p])) {
-
-                        const typedArray = new heapMap[heapIn](params[p])
-                        const buf = NetUtil.Module._malloc(typedArray.length * typedArray.BYTES_PER_ELEMENT)
-
-                        switch (heapIn) {
-                            case "HEAP8": case "HEAPU8":
-                                NetUtil.Module[heapIn].set(typedArray, buf)
-                                break
-                            case "HEAP16": case "HEAPU16":
-                                NetUtil.Module[heapIn].set(typedArray, buf >> 1)
-                                break
-                            case "HEAP32": case "HEAPU32": case "HEAPF32":
-                                NetUtil.Module[heapIn].set(typedArray, buf >> 2)
-                                break
-                            case "HEAPF64":
-                                NetUtil.Module[heapIn].set(typedArray, buf >> 3)
-                                break
-                        }
+        if (params) {
 
-                        bufs.push(buf)
-                        parameters.push(buf)
-                        parameters.push(params[p].length)
-                        parameterTypes.push("number")
-                        parameterTypes.push("number")
+            // Array parameters get copied into the one reused scratch allocation, one after the other
+            let scratchBytes = 0
 
-                    } else {
-                        parameters.push(params[p])
-                        parameterTypes.push(paramTypes[p]==undefined ? "number" : paramTypes[p])
-                    }
+            for (let p=0; p<params.length; p++) {
+                if (paramTypes[p] == "array" || Array.isArray(params[p])) {
+                    scratchBytes += Math.ceil(params[p].length * heapMap[heapIn].BYTES_PER_ELEMENT / 8) * 8
                 }
             }
 
-            res = NetUtil.Module.ccall(func, returnTypeParam, parameterTypes, parameters)
-        } catch (e) {
-            error = e
-        } finally {
-            for (let b=0; b<bufs.length; b++) {
-                NetUtil.Module._free(bufs[b])
+            let buf = scratchBytes ? NetUtil.scratchBuffer(scratchBytes) : 0
+
+            for (let p=0; p<params.length; p++) {
+
+                if (paramTypes[p] == "array" || Array.isArray(params[p])) {
+
+                    const typedArray = new heapMap[heapIn](params[p])
+
+                    switch (heapIn) {
+                        case "HEAP8": case "HEAPU8":
+                            NetUtil.Module[heapIn].set(typedArray, buf)
+                            break
+                        case "HEAP16": case "HEAPU16":
+                            NetUtil.Module[heapIn].set(typedArray, buf >> 1)
+                            break
+                        case "HEAP32": case "HEAPU32": case "HEAPF32":
+                            NetUtil.Module[heapIn].set(typedArray, buf >> 2)
+                            break
+                        case "HEAPF64":
+                            NetUtil.Module[heapIn].set(typedArray, buf >> 3)
+                            break
+                    }
+
+                    parameters.push(buf)
+                    parameters.push(params[p].length)
+                    parameterTypes.push("number")
+                    parameterTypes.push("number")
+
+                    buf += Math.ceil(typedArray.length * typedArray.BYTES_PER_ELEMENT / 8) * 8
+
+                } else {
+                    parameters.push(params[p])
+                    parameterTypes.push(paramTypes[p]==undefined ? "number" : paramTypes[p])
+                }
             }
         }
 
-        if (error) throw error
-
+        const res = NetUtil.Module.ccall(func, returnTypeParam, parameterTypes, parameters)
 
         if (returnType=="array") {
             const returnData = []
@@ -92,6 +90,42 @@ class NetUtil {
         }
     }
 
+    // A block of WASM memory kept between ccallArrays calls, instead of a _malloc and _free every call. It's only
+    // re-allocated when a call needs more room than it has
+    static scratchBuffer (bytes) {
+        if (!NetUtil.scratch || NetUtil.scratch.Module !== NetUtil.Module || NetUtil.scratch.bytes < bytes) {
+
+            if (NetUtil.scratch && NetUtil.scratch.Module === NetUtil.Module) {
+                NetUtil.Module._free(NetUtil.scratch.pointer)
+            }
+
+            NetUtil.scratch = {Module: NetUtil.Module, bytes, pointer: NetUtil.Module._malloc(bytes)}
+        }
+        return NetUtil.scratch.pointer
+    }
+
+    // Whether the runtime can validate a module using SIMD128 instructions (an i8x16.splat followed by an i8x16.popcnt),
+    // for picking between the NetWASM.simd.js and NetWASM.js builds. Set global.jsNetWASMSIMD to false to always use
+    // the scalar build
+    static simdSupported () {
+
+        if (global.jsNetWASMSIMD===false || typeof WebAssembly!="object") {
+            return false
+        }
+
+        try {
+            return WebAssembly.validate(new Uint8Array([0,97,115,109,1,0,0,0,1,5,1,96,0,1,123,3,2,1,0,10,10,1,8,0,65,0,253,15,253,98,11]))
+        } catch (e) {
+            return false
+        }
+    }
+
+    // Whether the runtime can run the pthreads build (NetWASM.threads.js), which needs SharedArrayBuffer. Browsers only
+    // offer it on cross-origin isolated pages. Node has no crossOriginIsolated, and always can
+    static threadsSupported () {
+        return typeof SharedArrayBuffer=="function" && (typeof crossOriginIsolated=="undefined" || crossOriginIsolated===true)
+    }
+
     static ccallVolume (func, returnType, paramTypes=[], params=[], {heapIn="HEAPF32", heapOut="HEAPF32", depth=1, rows=1, columns=rows}={}) {
 
         const totalValues = depth * rows * columns
@@ -1,3 +1,19 @@
 // This will get concatentated to the end of the file generated by emscripten,
 // to fix Webpack loading issues. (https://github.com/DanRuta/jsNet/issues/41)
-typeof window!="undefined" && (window.Module = Module)
\ No newline at end of file
+typeof window!="undefined" && (window.Module = Module)
+
+// The emscripten code asks this for the .wasm file path. Being a function declaration, it is hoisted, so
+// it's already available there, even though it gets concatenated after it.
+// The SIMD128 (NetWASM.simd.js) and pthreads (NetWASM.threads.js) builds have glue code of their own, which asks for
+// their "simd" and "threads" variants of the .wasm file, next to the NetWASM.wasm path. Set global.jsNetWASMSIMDPath
+// if the SIMD .wasm file is somewhere else.
+function jsNetWASMFile (variant) {
+
+    const path = global.jsNetWASMPath || "NetWASM.wasm"
+
+    if (variant=="simd" && global.jsNetWASMSIMDPath) {
+        return global.jsNetWASMSIMDPath
+    }
+
+    return variant ? path.replace(/\.wasm$/, `.${variant}.wasm`) : path
+}
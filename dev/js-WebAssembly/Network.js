@@ -31,6 +31,12 @@ class Network {
         NetUtil.defineProperty(this, "dropout", ["number"], [this.netInstance])
         this.dropout = dropout==false ? 1 : dropout
 
+        // How much work a layer's loop needs, to be split across the threads
+        NetUtil.defineProperty(this, "parallelThreshold", ["number"], [this.netInstance])
+
+        // This network's share of the threads, when training side by side with other networks
+        NetUtil.defineProperty(this, "priority", ["number"], [this.netInstance])
+
         if (l2) {
             NetUtil.defineProperty(this, "l2", ["number"], [this.netInstance])
             NetUtil.defineProperty(this, "l2Error", ["number"], [this.netInstance])
@@ -223,12 +229,14 @@ class Network {
         NetUtil.defineProperty(this, "validationInterval", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "trainingLogging", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "stoppedEarly", ["number"], [this.netInstance])
+        NetUtil.defineProperty(this, "trainingCursor", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "earlyStoppingType", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "earlyStoppingThreshold", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "earlyStoppingBestError", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "earlyStoppingPatienceCounter", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "earlyStoppingPatience", ["number"], [this.netInstance])
         NetUtil.defineProperty(this, "earlyStoppingPercent", ["number"], [this.netInstance])
+        NetUtil.defineProperty(this, "profiling", ["number"], [this.netInstance])
 
         this.collectedErrors = {}
         NetUtil.defineArrayProperty(this.collectedErrors, "training", ["number"], [this.netInstance], "auto", {pre: "collected_"})
@@ -298,6 +306,7 @@ class Network {
         }
 
         this.Module.ccall("initLayers", null, ["number"], [this.netInstance])
+        this.inputBuffer = this.outputBuffer = undefined
         const outSize = this.layers[this.layers.length-1].size
         const floorFunc = map => map.map(row => row.map(v => Math.floor(v)))
 
@@ -346,16 +355,47 @@ class Network {
             console.warn("Input data length did not match input layer neurons count.")
         }
 
-        return NetUtil.ccallArrays("forward", "array", ["number", "array"], [this.netInstance, data], {
-            heapOut: "HEAPF64",
-            returnArraySize: this.layers[this.layers.length-1].neurons.length
-        })
+        // Extra values are dropped, and missing ones are 0, rather than left over from the previous input
+        const input = this.inputView()
+        input.set(data.length > input.length ? data.slice(0, input.length) : data)
+        input.fill(0, data.length)
+        this.Module.ccall("forward_buffer", "number", ["number"], [this.netInstance])
+
+        return Array.from(this.outputView())
+    }
+
+    // A Float64Array view straight onto the input layer's values, in the WASM memory. Values written into it
+    // are used by the next forward pass. It is re-created if the WASM memory has grown, which detaches old views
+    inputView () {
+        if (!this.inputBuffer || this.inputBuffer.buffer !== this.Module.HEAPF64.buffer) {
+            const pointer = this.Module.ccall("get_input_buffer", "number", ["number"], [this.netInstance])
+            this.inputBuffer = this.Module.HEAPF64.subarray(pointer/8, pointer/8 + this.layers[0].neurons.length)
+        }
+        return this.inputBuffer
+    }
+
+    // Same, for the output layer's activations, from the last forward pass
+    outputView () {
+        if (!this.outputBuffer || this.outputBuffer.buffer !== this.Module.HEAPF64.buffer) {
+            const pointer = this.Module.ccall("get_output_buffer", "number", ["number"], [this.netInstance])
+            this.outputBuffer = this.Module.HEAPF64.subarray(pointer/8, pointer/8 + this.layers[this.layers.length-1].neurons.length)
+        }
+        return this.outputBuffer
     }
 
-    train (data, {epochs=1, callback, callbackInterval=1, collectErrors, miniBatchSize=1, log=true, shuffle=false, validation}={}) {
+    train (data, {augmentation={}, epochs=1, callback, callbackInterval=1, collectErrors, deterministic=false, hogwild=false, miniBatchSize=1, log=true, pipeline=false, prefetch=0, seed, shuffle=false, threads=1, timeBudget, validation}={}) {
 
-        miniBatchSize = typeof miniBatchSize=="boolean" && miniBatchSize ? data[0].expected.length : miniBatchSize
+        miniBatchSize = typeof miniBatchSize=="boolean" && miniBatchSize ? this.labelClasses(data) || data[0].expected.length : miniBatchSize
         this.Module.ccall("set_miniBatchSize", null, ["number", "number"], [this.netInstance, miniBatchSize])
+        this.Module.ccall("set_threads", null, ["number", "number"], [this.netInstance, threads])
+        this.Module.ccall("set_prefetch", null, ["number", "number"], [this.netInstance, prefetch])
+        this.Module.ccall("set_hogwild", null, ["number", "number"], [this.netInstance, hogwild ? 1 : 0])
+        this.Module.ccall("set_pipeline", null, ["number", "number"], [this.netInstance, pipeline ? 1 : 0])
+        this.Module.ccall("set_deterministic", null, ["number", "number"], [this.netInstance, deterministic ? 1 : 0])
+
+        const {shift=0, flip=false, rotation=0, noise=0} = augmentation
+        this.Module.ccall("set_augmentation", null, ["number", "number", "number", "number", "number"],
+                                                    [this.netInstance, shift, flip ? 1 : 0, rotation, noise])
         this.validation = validation
         this.trainingLogging = log
         this.stoppedEarly = false
@@ -366,14 +406,21 @@ class Network {
                 return void reject("No data provided")
             }
 
+            if (hogwild && !deterministic && (prefetch || shift || flip || rotation || noise)) {
+                return void reject("Hogwild training can't be used with prefetching or augmentation")
+            }
+
+            const classes = this.labelClasses(data)
+
             if (this.state != "initialised") {
-                this.initLayers(data[0].input.length, (data[0].expected || data[0].output).length)
+                this.initLayers(data[0].input.length, classes || (data[0].expected || data[0].output).length)
             }
 
             const startTime = Date.now()
+            const startIterations = this.iterations
 
             const dimension = this.layers[0].size
-            const itemSize = dimension + (data[0].expected || data[0].output).length
+            const itemSize = dimension + (classes ? 1 : (data[0].expected || data[0].output).length)
             const itemsCount = itemSize * data.length
 
             if (log) {
@@ -389,22 +436,31 @@ class Network {
 
             let elapsed
 
-            this.Module.ccall("loadTrainingData", "number", ["number", "number", "number", "number", "number"],
-                                                      [this.netInstance, buf, itemsCount, itemSize, dimension])
+            this.Module.ccall("loadTrainingData", "number", ["number", "number", "number", "number", "number", "number"],
+                                                      [this.netInstance, buf, itemsCount, itemSize, dimension, classes])
+
+            // The data set gets copied into one contiguous block, so the buffer is no longer needed
+            this.Module._free(buf)
+
+            if (seed!=undefined) {
+                this.Module.ccall("set_shuffleSeed", null, ["number", "number"], [this.netInstance, seed])
+            }
 
-            if (shuffle) {
-                this.Module.ccall("shuffleTrainingData", null, ["number"], [this.netInstance])
+            // Only the order the data is trained in gets shuffled, natively, at the start of every epoch
+            const shuffleEpoch = () => {
+                if (shuffle) {
+                    this.Module.ccall("shuffleTrainingData", null, ["number"], [this.netInstance])
+                }
             }
 
             if (collectErrors) {
                 this.Module.ccall("collectErrors", null, ["number"], [this.netInstance])
             }
 
-            let validationBuf
-
             if (this.validation) {
 
                 this.validationInterval = this.validation.interval || data.length // Default to 1 epoch
+                this.Module.ccall("set_backgroundValidation", null, ["number", "number"], [this.netInstance, this.validation.background ? 1 : 0])
 
                 if (this.validation.earlyStopping) {
                     switch (this.validation.earlyStopping.type) {
@@ -432,31 +488,103 @@ class Network {
 
                 // Load validation data
                 if (this.validation.data) {
-                    const typedArray = new Float32Array(this.validation.data.length)
-                    this.loadData(this.validation.data, typedArray, itemSize , reject)
-                    validationBuf = this.Module._malloc(typedArray.length*typedArray.BYTES_PER_ELEMENT)
-                    this.Module.HEAPF32.set(typedArray, buf >> 2)
-
-                    this.Module.ccall("loadValidationData", "number", ["number", "number", "number", "number", "number"],
-                                                    [this.netInstance, buf, itemsCount, itemSize, dimension])
+                    const validationClasses = this.labelClasses(this.validation.data)
+                    const validationItem = this.validation.data[0]
+                    const validationItemSize = dimension + (validationClasses ? 1 : (validationItem.expected || validationItem.output).length)
+                    const typedArray = new Float32Array(validationItemSize * this.validation.data.length)
+                    this.loadData(this.validation.data, typedArray, validationItemSize, reject)
+                    const validationBuf = this.Module._malloc(typedArray.length*typedArray.BYTES_PER_ELEMENT)
+                    this.Module.HEAPF32.set(typedArray, validationBuf >> 2)
+
+                    this.Module.ccall("loadValidationData", "number", ["number", "number", "number", "number", "number", "number"],
+                                                    [this.netInstance, validationBuf, typedArray.length, validationItemSize, dimension, validationClasses])
+                    this.Module._free(validationBuf)
                 }
             }
 
             const logAndResolve = () => {
-                this.Module._free(buf)
-                this.Module._free(validationBuf)
-
                 if (this.validation && this.validation.earlyStopping && (this.validation.earlyStopping.type == "patience" || this.validation.earlyStopping.type == "divergence")) {
                     this.Module.ccall("restoreValidation", null, ["number"], [this.netInstance])
                 }
 
                 if (log) {
                     console.log(`Training finished. Total time: ${NetUtil.format(elapsed, "time")}`)
+
+                    // For comparing the multi-threaded modes, alongside the epochs' errors
+                    if (threads > 1) {
+                        const throughput = Math.round((this.iterations - startIterations) / Math.max(elapsed, 1) * 1000)
+                        console.log(`${hogwild && !deterministic ? "Hogwild" : pipeline ? "Pipelined" : "Synchronous"} training throughput: ${throughput} items/s`)
+                    }
+
+                    if (prefetch) {
+                        const {stalls, stallTime} = this.prefetchStats()
+                        console.log(`Waited on prefetching ${stalls} times, for ${NetUtil.format(stallTime, "time")}`)
+                    }
                 }
                 resolve()
             }
 
-            if (callback) {
+            if (timeBudget) {
+
+                let epochIndex = 0
+                let cursor = 0
+                this.trainingCursor = 0
+
+                // Each step trains for about timeBudget ms natively, then hands control back to the event loop
+                const doStep = () => {
+
+                    if (!cursor) {
+                        if (this.l2) this.l2Error = 0
+                        if (this.l1) this.l1Error = 0
+                        shuffleEpoch()
+                    }
+
+                    const trained = this.Module.ccall("trainFor", "number", ["number", "number"], [this.netInstance, timeBudget])
+                    cursor = this.trainingCursor
+
+                    if (callback) {
+                        callback({
+                            iterations: (this.iterations),
+                            validations: (this.validations),
+                            trainingError: this.error,
+                            validationError: this.validationError,
+                            elapsed: Date.now() - startTime,
+                            epoch: epochIndex + 1,
+                            trained
+                        })
+                    }
+
+                    if (cursor) {
+                        return void setTimeout(doStep, 0)
+                    }
+
+                    epochIndex++
+                    elapsed = Date.now() - startTime
+
+                    if (log) {
+                        let text = `Epoch: ${epochIndex}\nTraining Error: ${this.error}`
+
+                        if (this.validation) {
+                            text += `\nValidation Error: ${this.lastValidationError}`
+                        }
+
+                        if (this.l2Error!=undefined) {
+                            text += `\nL2 Error: ${this.l2Error/data.length}`
+                        }
+
+                        text += `\nElapsed: ${NetUtil.format(elapsed, "time")} Average Duration: ${NetUtil.format(elapsed/epochIndex, "time")}`
+                        console.log(text)
+                    }
+
+                    if (epochIndex < epochs && !this.stoppedEarly) {
+                        setTimeout(doStep, 0)
+                    } else {
+                        logAndResolve()
+                    }
+                }
+                doStep()
+
+            } else if (callback) {
 
                 let epochIndex = 0
                 let iterationIndex = 0
@@ -465,6 +593,7 @@ class Network {
 
                     if (this.l2) this.l2Error = 0
                     if (this.l1) this.l1Error = 0
+                    shuffleEpoch()
 
                     iterationIndex = 0
                     doIteration()
@@ -527,6 +656,7 @@ class Network {
 
                     if (this.l2) this.l2Error = 0
                     if (this.l1) this.l1Error = 0
+                    shuffleEpoch()
 
                     this.Module.ccall("train", "number", ["number", "number", "number"], [this.netInstance, -1, 0])
                     elapsed = Date.now() - startTime
@@ -582,14 +712,55 @@ class Network {
                 }
             }
 
-            for (let ei=0; ei<(data[di].expected || data[di].output).length; ei++) {
-                typedArray[index] = (data[di].expected || data[di].output)[ei]
-                index++
+            const expected = data[di].hasOwnProperty("expected") ? data[di].expected : data[di].output
+
+            // Class index
+            if (typeof expected=="number") {
+                typedArray[index] = expected
+            } else {
+                for (let ei=0; ei<expected.length; ei++) {
+                    typedArray[index] = expected[ei]
+                    index++
+                }
             }
         }
     }
 
-    test (data, {log=true, collectErrors, callback}={}) {
+    // Copies a data set into the WASM memory, for the given load function to store natively
+    loadDataSet (fnName, data, reject) {
+        const classes = this.labelClasses(data)
+        const dimension = this.layers[0].size
+        const itemSize = dimension + (classes ? 1 : (data[0].expected || data[0].output).length)
+        const typedArray = new Float32Array(itemSize * data.length)
+        this.loadData(data, typedArray, itemSize, reject)
+
+        const buf = this.Module._malloc(typedArray.length*typedArray.BYTES_PER_ELEMENT)
+        this.Module.HEAPF32.set(typedArray, buf >> 2)
+        this.Module.ccall(fnName, "number", ["number", "number", "number", "number", "number", "number"],
+                                            [this.netInstance, buf, typedArray.length, itemSize, dimension, classes])
+        this.Module._free(buf)
+    }
+
+    // Classification samples can give just their class index as the expected value, instead of one-hot values. It is
+    // stored as that one value. Returns the classes count for these, or 0
+    labelClasses (data) {
+        const expected = data[0].hasOwnProperty("expected") ? data[0].expected : data[0].output
+
+        if (typeof expected!="number") {
+            return 0
+        }
+
+        if (this.layers.length) {
+            return this.layers[this.layers.length-1].size
+        }
+
+        return data.reduce((max, item) => Math.max(max, (item.hasOwnProperty("expected") ? item.expected : item.output) + 1), 0)
+    }
+
+    test (data, {log=true, collectErrors, callback, threads=1}={}) {
+
+        this.Module.ccall("set_threads", null, ["number", "number"], [this.netInstance, threads])
+
         return new Promise((resolve, reject) => {
 
             if (data === undefined || data === null) {
@@ -602,7 +773,8 @@ class Network {
 
             const startTime = Date.now()
             const dimension = data[0].input.length
-            const itemSize = dimension + (data[0].expected || data[0].output).length
+            const classes = this.labelClasses(data)
+            const itemSize = dimension + (classes ? 1 : (data[0].expected || data[0].output).length)
             const itemsCount = itemSize * data.length
             const typedArray = new Float32Array(itemsCount)
 
@@ -611,8 +783,9 @@ class Network {
             const buf = this.Module._malloc(typedArray.length*typedArray.BYTES_PER_ELEMENT)
             this.Module.HEAPF32.set(typedArray, buf >> 2)
 
-            this.Module.ccall("loadTestingData", "number", ["number", "number", "number", "number", "number"],
-                                            [this.netInstance, buf, itemsCount, itemSize, dimension])
+            this.Module.ccall("loadTestingData", "number", ["number", "number", "number", "number", "number", "number"],
+                                            [this.netInstance, buf, itemsCount, itemSize, dimension, classes])
+            this.Module._free(buf)
 
             if (collectErrors) {
                 this.Module.ccall("collectErrors", null, ["number"], [this.netInstance])
@@ -642,7 +815,6 @@ class Network {
                         const elapsed = Date.now() - startTime
                         log && console.log(`Testing finished. Total time: ${NetUtil.format(elapsed, "time")}  Average iteration time: ${NetUtil.format(elapsed/iterationIndex, "time")}`)
 
-                        this.Module._free(buf)
                         resolve(totalError/data.length)
                     }
                 }
@@ -652,7 +824,6 @@ class Network {
             } else {
 
                 const avgError = this.Module.ccall("test", "number", ["number", "number"], [this.netInstance, -1, 0])
-                this.Module._free(buf)
 
                 const elapsed = Date.now() - startTime
 
@@ -666,8 +837,12 @@ class Network {
     }
 
     toJSON () {
+
+        // Initialised networks read all their parameters out of the WASM memory in one go
+        const params = this.state=="initialised" ? this.exportParameters() : undefined
+
         return {
-            layers: this.layers.map(layer => layer.toJSON())
+            layers: this.layers.map((layer, li) => layer.toJSON(params && this.layerParameters(params, li)))
         }
     }
 
@@ -681,10 +856,74 @@ class Network {
             throw new Error(`Mismatched layers (${data.layers.length} layers in import data, but ${this.layers.length} configured)`)
         }
 
+        if (this.state=="initialised") {
+            // The layers write into a copy of the current parameters, which then goes back in one call, keeping the
+            // optimizer state which the JSON doesn't have
+            const params = this.exportParameters()
+            this.layers.forEach((layer, li) => li && layer.fromJSON(data.layers[li], li, this.layerParameters(params, li)))
+            this.importParameters(params)
+            return
+        }
+
         this.Module.ccall("resetDeltaWeights", null, ["number"], [this.netInstance])
         this.layers.forEach((layer, li) => li && layer.fromJSON(data.layers[li], li))
     }
 
+    // All the weights, biases, optimizer state and pruning masks, copied out of the WASM memory in one call. The layout
+    // has five values per layer: its offset into the values, then its biases, weights, optimizer state and mask counts
+    exportParameters () {
+
+        if (this.state!="initialised") {
+            throw new Error("The network layers have not been initialised.")
+        }
+
+        const layoutPointer = this.Module.ccall("get_parametersLayout", "number", ["number"], [this.netInstance])
+        const layout = Array.from(this.Module.HEAP32.subarray(layoutPointer/4, layoutPointer/4 + this.layers.length*5))
+        const valuesCount = layout.slice(-5).reduce((total, count) => total + count, 0)
+
+        const pointer = this.Module.ccall("exportParameters", "number", ["number"], [this.netInstance])
+        const values = this.Module.HEAPF64.slice(pointer/8, pointer/8 + valuesCount)
+
+        return {layout, values}
+    }
+
+    importParameters ({layout, values}={}) {
+
+        if (this.state!="initialised") {
+            throw new Error("The network layers have not been initialised.")
+        }
+
+        if (!layout || !values) {
+            throw new Error("No parameters given to import.")
+        }
+
+        const layoutPointer = this.Module.ccall("get_parametersLayout", "number", ["number"], [this.netInstance])
+        const existing = this.Module.HEAP32.subarray(layoutPointer/4, layoutPointer/4 + this.layers.length*5)
+        const valuesCount = existing.slice(-5).reduce((total, count) => total + count, 0)
+
+        if (layout.length!=existing.length || existing.some((value, v) => value!=layout[v])) {
+            throw new Error("Mismatched parameters layout. The network's layers or update function differ from the exported ones.")
+        }
+
+        if (values.length!=valuesCount) {
+            throw new Error(`Mismatched parameters count. Given: ${values.length} Existing: ${valuesCount}`)
+        }
+
+        NetUtil.ccallArrays("importParameters", "number", ["number", "array"], [this.netInstance, values], {heapIn: "HEAPF64"})
+    }
+
+    // Views onto one layer's biases, weights, optimizer state and pruning mask, in exportParameters() data
+    layerParameters ({layout, values}, layerIndex) {
+        const [offset, biasesCount, weightsCount, stateCount, maskCount] = layout.slice(layerIndex*5, layerIndex*5 + 5)
+        const stateStart = offset + biasesCount + weightsCount
+        return {
+            biases: values.subarray(offset, offset + biasesCount),
+            weights: values.subarray(offset + biasesCount, stateStart),
+            state: values.subarray(stateStart, stateStart + stateCount),
+            mask: values.subarray(stateStart + stateCount, stateStart + stateCount + maskCount)
+        }
+    }
+
     toIMG (IMGArrays, opts={}) {
 
         if (!IMGArrays) {
@@ -693,6 +932,27 @@ class Network {
 
         const data = []
 
+        // Initialised networks lay their parameters out in the same per neuron/filter bias then weights order
+        if (this.state=="initialised") {
+            const params = this.exportParameters()
+
+            for (let l=1; l<this.layers.length; l++) {
+
+                const {biases, weights} = this.layerParameters(params, l)
+                const weightsCount = weights.length / biases.length
+
+                for (let b=0; b<biases.length; b++) {
+                    data.push(biases[b])
+
+                    for (let w=b*weightsCount; w<(b+1)*weightsCount; w++) {
+                        data.push(weights[w])
+                    }
+                }
+            }
+
+            return IMGArrays.toIMG(data, opts)
+        }
+
         for (let l=1; l<this.layers.length; l++) {
 
             const layerData = this.layers[l].toIMG()
@@ -713,6 +973,25 @@ class Network {
         let valI = 0
         const data = IMGArrays.fromIMG(rawData, opts)
 
+        if (this.state=="initialised") {
+            const params = this.exportParameters()
+
+            for (let l=1; l<this.layers.length; l++) {
+
+                const {biases, weights} = this.layerParameters(params, l)
+                const weightsCount = weights.length / biases.length
+
+                for (let b=0; b<biases.length; b++) {
+                    biases[b] = data[valI++]
+                    weights.set(data.slice(valI, valI+weightsCount), b*weightsCount)
+                    valI += weightsCount
+                }
+            }
+
+            this.importParameters(params)
+            return
+        }
+
         for (let l=1; l<this.layers.length; l++) {
 
             const dataCount = this.layers[l].getDataSize()
@@ -720,6 +999,104 @@ class Network {
         }
     }
 
+    prune ({threshold=0, sparsity=0}={}) {
+
+        if (this.state!="initialised") {
+            throw new Error("The network layers have not been initialised.")
+        }
+
+        if (sparsity < 0 || sparsity > 1) {
+            throw new Error("The pruning sparsity must be between 0 and 1.")
+        }
+
+        this.Module.ccall("prune", null, ["number", "number", "number"], [this.netInstance, threshold, sparsity])
+    }
+
+    densify () {
+
+        if (this.state!="initialised") {
+            throw new Error("The network layers have not been initialised.")
+        }
+
+        this.Module.ccall("densify", null, ["number"], [this.netInstance])
+    }
+
+    tune ({cache="jsNet-tuning.cache"}={}) {
+
+        if (this.state!="initialised") {
+            throw new Error("The network layers have not been initialised.")
+        }
+
+        this.Module.ccall("tune", null, ["number", "string"], [this.netInstance, cache])
+    }
+
+    // How long, and how many times, training waited on the prefetch loader, and how long it spent loading batches
+    prefetchStats () {
+        const pointer = this.Module.ccall("get_prefetchStats", "number", ["number"], [this.netInstance])
+        const [stallTime, stalls, loadTime, batches] = this.Module.HEAPF64.slice(pointer/8, pointer/8 + 4)
+        return {stallTime, stalls, loadTime, batches}
+    }
+
+    // Trains the networks side by side, natively, on one shared copy of the data, as a successive halving sweep. After
+    // each round of epochs, only the better half, by validation error, carry on. Resolves with a row per network, best first
+    static sweep (networks, data, {epochs=1, keep=0.5, log=true, miniBatchSize=1, seed, shuffle=false, threads=1, validation}={}) {
+        return new Promise((resolve, reject) => {
+
+            if (!networks || !networks.length) {
+                return void reject("No networks provided")
+            }
+
+            if (data === undefined || data === null) {
+                return void reject("No data provided")
+            }
+
+            const startTime = Date.now()
+            const classes = networks[0].labelClasses(data)
+
+            for (let n=0; n<networks.length; n++) {
+                const net = networks[n]
+
+                if (net.state != "initialised") {
+                    net.initLayers(data[0].input.length, classes || (data[0].expected || data[0].output).length)
+                }
+
+                net.Module.ccall("set_miniBatchSize", null, ["number", "number"], [net.netInstance, miniBatchSize])
+
+                if (seed!=undefined) {
+                    net.Module.ccall("set_shuffleSeed", null, ["number", "number"], [net.netInstance, seed])
+                }
+            }
+
+            // Only the first network gets the data, which the others then share
+            networks[0].loadDataSet("loadTrainingData", data, reject)
+
+            if (validation && validation.data) {
+                networks[0].loadDataSet("loadValidationData", validation.data, reject)
+            }
+
+            const pointer = NetUtil.ccallArrays("sweep", "number", ["array", "number", "number", "number", "number"],
+                [networks.map(net => net.netInstance), epochs, keep, threads, shuffle ? 1 : 0], {heapIn: "HEAP32"})
+            const values = networks[0].Module.HEAPF64.slice(pointer/8, pointer/8 + networks.length*5)
+            const results = []
+
+            for (let r=0; r<networks.length; r++) {
+                const [instance, validationError, trainingError, epochsTrained, rounds] = values.slice(r*5, r*5+5)
+                const network = networks.find(net => net.netInstance==instance)
+                results.push({network, validationError, trainingError, epochs: epochsTrained, rounds})
+            }
+
+            if (log) {
+                console.log(`Sweep finished. Total time: ${NetUtil.format(Date.now() - startTime, "time")}`)
+            }
+
+            resolve(results)
+        })
+    }
+
+    printProfile () {
+        this.Module.ccall("printProfile", null, ["number"], [this.netInstance])
+    }
+
     printConfusionMatrix (type) {
         if (type) {
             NetUtil.printConfusionMatrix(NetUtil.makeConfusionMatrix(this[`${type}ConfusionMatrix`]))
@@ -1,9 +1,16 @@
 "use strict"
 
 exports.js = () => require("./jsNetJS.min.js")
-exports.webassembly = (path="./node_modules/jsnet/dist/NetWASM.wasm") => {
+exports.webassembly = (path="./node_modules/jsnet/dist/NetWASM.wasm", {threads=false}={}) => {
     global.jsNetWASMPath = path
     const jsNet = require("./jsNetWebAssembly.min.js")
-    jsNet.Module = require("./NetWASM.js")
+
+    if (threads && !jsNet.NetUtil.threadsSupported()) {
+        console.warn("SharedArrayBuffer is not available, so the pthreads build can't be used. Training will use 1 thread.")
+        threads = false
+    }
+
+    // The SIMD and pthreads builds' .wasm files only work with their own glue code
+    jsNet.Module = require(threads ? "./NetWASM.threads.js" : (jsNet.NetUtil.simdSupported() ? "./NetWASM.simd.js" : "./NetWASM.js"))
     return jsNet
 }
@@ -0,0 +1,56 @@
+"use strict"
+
+// Compares running an Ensemble over a batch of inputs against calling forward() on each network in turn, for each
+// input, and averaging their outputs in JS. Run from this folder, once the dist files are built:
+//     node benchmark.js [threads]
+
+global.jsNetWASMPath = "../../dist/NetWASM.wasm"
+const {Network, FCLayer, Ensemble} = require("../../dist/jsNetWebAssembly.min.js")
+const Module = require("../../dist/NetWASM.threads.js")
+
+const threads = parseInt(process.argv[2]) || 4
+const modelCount = 8
+const batchSize = 500
+const repeats = 5
+
+const timed = (label, fn) => {
+    // One warm up run
+    let outputs = fn()
+    const start = Date.now()
+
+    for (let r=0; r<repeats; r++) {
+        outputs = fn()
+    }
+
+    const elapsed = (Date.now() - start) / repeats
+    console.log(`${label}: ${elapsed.toFixed(1)}ms per batch, ${Math.round(batchSize / elapsed * 1000)} items/s`)
+    return outputs
+}
+
+global.onWASMLoaded = () => {
+
+    const networks = [...new Array(modelCount)].map(() => new Network({
+        Module: Module,
+        layers: [new FCLayer(784), new FCLayer(256), new FCLayer(128), new FCLayer(10)]
+    }))
+    const batch = [...new Array(batchSize)].map(() => [...new Array(784)].map(() => Math.random()))
+
+    console.log(`${modelCount} networks, ${batchSize} inputs`)
+
+    const sequential = timed("Sequential forward() calls", () => batch.map(input => {
+        const outputs = networks.map(net => net.forward(input))
+        return outputs[0].map((v, o) => outputs.reduce((sum, output) => sum + output[o], 0) / outputs.length)
+    }))
+
+    for (const t of [1, threads]) {
+        const ensemble = new Ensemble({Module, networks, threads: t})
+        const outputs = timed(`Ensemble, ${t} thread${t==1 ? "" : "s"}`, () => ensemble.forward(batch))
+
+        const difference = Math.max(...outputs.map((output, i) => Math.max(...output.map((v, o) => Math.abs(v - sequential[i][o])))))
+        console.log(`    Largest difference from the sequential outputs: ${difference}`)
+        ensemble.delete()
+    }
+
+    // The pthreads workers would otherwise keep node running
+    process.exit()
+}
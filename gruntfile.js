@@ -1,4 +1,8 @@
 module.exports = function(grunt){
+
+    const emsdk = process.platform=="win32" ? "C:/emsdk/emsdk_env.bat & " : ""
+    const emccFlags = "-O3 -s ALLOW_MEMORY_GROWTH=1 -s WASM=1 -s NO_EXIT_RUNTIME=1 -std=c++14"
+
     grunt.initConfig({
         concat: {
             options: {
@@ -19,6 +23,14 @@ module.exports = function(grunt){
             "NetWASM.js": {
                 src: ["dist/NetWASM.js", "dev/js-WebAssembly/NetWASM.js"],
                 dest: "dist/NetWASM.js"
+            },
+            "NetWASM.simd.js": {
+                src: ["dist/NetWASM.simd.js", "dev/js-WebAssembly/NetWASM.js"],
+                dest: "dist/NetWASM.simd.js"
+            },
+            "NetWASM.threads.js": {
+                src: ["dist/NetWASM.threads.js", "dev/js-WebAssembly/NetWASM.js"],
+                dest: "dist/NetWASM.threads.js"
             }
         },
 
@@ -38,8 +50,13 @@ module.exports = function(grunt){
         },
 
         exec: {
-            build: "C:/emsdk/emsdk_env.bat & echo Building... & emcc -o ./dist/NetWASM.js ./dev/cpp/emscripten.cpp -O3 -s ALLOW_MEMORY_GROWTH=1 -s WASM=1 -s NO_EXIT_RUNTIME=1 -std=c++14",
-            emscriptenTests: "C:/emsdk/emsdk_env.bat & echo Building... & emcc -o ./test/emscriptenTests.js ./test/emscriptenTests.cpp -O3 -s ALLOW_MEMORY_GROWTH=1 -s WASM=1 -s NO_EXIT_RUNTIME=1 -std=c++14"
+            build: `${emsdk}echo Building... && emcc -o ./dist/NetWASM.js ./dev/cpp/emscripten.cpp ${emccFlags}`,
+            // The SIMD128 build ships with its own glue code, as two separate links' glue isn't guaranteed to match
+            buildSIMD: `${emsdk}echo Building SIMD... && emcc -o ./dist/NetWASM.simd.js ./dev/cpp/emscripten.cpp ${emccFlags} -msimd128`,
+            // Network.threads is capped to 1 in the other builds
+            buildThreads: `${emsdk}echo Building pthreads... && emcc -o ./dist/NetWASM.threads.js ./dev/cpp/emscripten.cpp ${emccFlags} -pthread -s PTHREAD_POOL_SIZE=10`,
+            emscriptenTests: `${emsdk}echo Building... && emcc -o ./test/emscriptenTests.js ./test/emscriptenTests.cpp ${emccFlags}`,
+            emscriptenTestsSIMD: `${emsdk}echo Building SIMD... && emcc -o ./test/emscriptenTests.simd.js ./test/emscriptenTests.cpp ${emccFlags} -msimd128`
         },
 
         watch: {
@@ -49,7 +66,8 @@ module.exports = function(grunt){
             },
             cpp: {
                 files: ["dev/cpp/*.cpp", "dev/cpp/*.h"],
-                tasks: ["exec:build", "concat:NetWASM.js", "concat:js-WebAssembly", "uglify", "replace:emscriptenWASMPath"]
+                tasks: ["exec:build", "exec:buildSIMD", "exec:buildThreads", "concat:NetWASM.js", "concat:NetWASM.simd.js", "concat:NetWASM.threads.js",
+                        "concat:js-WebAssembly", "uglify", "replace:emscriptenWASMPath", "replace:emscriptenSIMDWASMPath", "replace:emscriptenThreadsWASMPath"]
             },
             js: {
                 files: ["dev/js/*.js"],
@@ -61,7 +79,7 @@ module.exports = function(grunt){
             },
             emscriptenTests: {
                 files: ["test/emscriptenTests.cpp"],
-                tasks: ["exec:emscriptenTests", "replace:emscriptenTestsFilePath"]
+                tasks: ["exec:emscriptenTests", "exec:emscriptenTestsSIMD", "replace:emscriptenTestsFilePath", "replace:emscriptenTestsSIMDFilePath"]
             }
         },
 
@@ -74,12 +92,36 @@ module.exports = function(grunt){
                     to: "test/emscriptenTests.wasm"
                 }]
             },
+            emscriptenTestsSIMDFilePath: {
+                src: ["test/emscriptenTests.simd.js"],
+                dest: "test/emscriptenTests.simd.js",
+                replacements: [{
+                    from: "emscriptenTests.simd.wasm",
+                    to: "test/emscriptenTests.simd.wasm"
+                }]
+            },
             emscriptenWASMPath: {
                 src: ["dist/NetWASM.js"],
                 dest: ["dist/NetWASM.js"],
                 replacements: [{
                     from: `"NetWASM.wasm"`,
-                    to: "global.jsNetWASMPath"
+                    to: "jsNetWASMFile()"
+                }]
+            },
+            emscriptenSIMDWASMPath: {
+                src: ["dist/NetWASM.simd.js"],
+                dest: ["dist/NetWASM.simd.js"],
+                replacements: [{
+                    from: `"NetWASM.simd.wasm"`,
+                    to: `jsNetWASMFile("simd")`
+                }]
+            },
+            emscriptenThreadsWASMPath: {
+                src: ["dist/NetWASM.threads.js"],
+                dest: ["dist/NetWASM.threads.js"],
+                replacements: [{
+                    from: `"NetWASM.threads.wasm"`,
+                    to: `jsNetWASMFile("threads")`
                 }]
             }
         }
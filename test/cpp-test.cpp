@@ -235,14 +235,8 @@ namespace Network_cpp {
             net->costFunction = mockCostFunction;
             net->miniBatchSize = 1;
 
-            std::vector<std::tuple<std::vector<double>, std::vector<double> > > trainingData = {};
-            std::tuple<std::vector<double>, std::vector<double> > data;
-            std::get<0>(data) = {};
-            std::get<1>(data) = {};
-            trainingData.push_back(data);
-            trainingData.push_back(data);
-
-            net->trainingData = trainingData;
+            net->trainingData.push_back({}, {});
+            net->trainingData.push_back({}, {});
 
             net->trainingConfusionMatrix = {};
             for (int r=0; r<3; r++) {
@@ -295,10 +289,9 @@ namespace Network_cpp {
 
     // Populates the confusion matrix data
     TEST_F(TrainFixture, train_2) {
-        std::get<0>(net->trainingData[0]) = {1,0};
-        std::get<0>(net->trainingData[1]) = {1,0};
-        std::get<1>(net->trainingData[0]) = {0,1};
-        std::get<1>(net->trainingData[1]) = {0,1};
+        net->trainingData.clear();
+        net->trainingData.push_back({1,0}, {0,1});
+        net->trainingData.push_back({1,0}, {0,1});
 
         l3->errs = {1,0};
         l3->actvns = {1,0};
@@ -324,10 +317,9 @@ namespace Network_cpp {
 
     // Collects training errors when configured to do so
     TEST_F(TrainFixture, train_3) {
-        std::get<0>(net->trainingData[0]) = {1,0};
-        std::get<0>(net->trainingData[1]) = {1,0};
-        std::get<1>(net->trainingData[0]) = {0,1};
-        std::get<1>(net->trainingData[1]) = {0,1};
+        net->trainingData.clear();
+        net->trainingData.push_back({1,0}, {0,1});
+        net->trainingData.push_back({1,0}, {0,1});
 
         l3->errs = {1,0};
         l3->actvns = {1,0};
@@ -360,14 +352,8 @@ namespace Network_cpp {
             net->weightInitFn = &NetMath::uniform;
             net->costFunction = mockCostFunction;
 
-            std::vector<std::tuple<std::vector<double>, std::vector<double> > > testData = {};
-            std::tuple<std::vector<double>, std::vector<double> > data;
-            std::get<0>(data) = {};
-            std::get<1>(data) = {};
-            testData.push_back(data);
-            testData.push_back(data);
-
-            net->testData = testData;
+            net->testData.push_back({}, {});
+            net->testData.push_back({}, {});
 
             net->testConfusionMatrix = {};
             for (int r=0; r<3; r++) {
@@ -413,10 +399,9 @@ namespace Network_cpp {
 
     // Populates the confusion matrix data
     TEST_F(TestFixture, test_2) {
-        std::get<0>(net->testData[0]) = {1,0};
-        std::get<0>(net->testData[1]) = {1,0};
-        std::get<1>(net->testData[0]) = {0,1};
-        std::get<1>(net->testData[1]) = {0,1};
+        net->testData.clear();
+        net->testData.push_back({1,0}, {0,1});
+        net->testData.push_back({1,0}, {0,1});
 
         l3->actvns = {1,0};
 
@@ -436,10 +421,9 @@ namespace Network_cpp {
     // Collects error values when configured to
     TEST_F(TestFixture, test_3) {
 
-        std::get<0>(net->testData[0]) = {1,0};
-        std::get<0>(net->testData[1]) = {1,0};
-        std::get<1>(net->testData[0]) = {0,1};
-        std::get<1>(net->testData[1]) = {0,1};
+        net->testData.clear();
+        net->testData.push_back({1,0}, {0,1});
+        net->testData.push_back({1,0}, {0,1});
 
         l3->sums = {1,0};
 
@@ -500,7 +484,7 @@ namespace Network_cpp {
         delete l3;
     }
 
-    // Calls every layer's (except the first) restoreValidation function
+    // Calls every layer's (except the first) restoreValidation function, once per back-up
     TEST(Network, restoreValidation) {
         Network::deleteNetwork();
         Network::newNetwork();
@@ -510,18 +494,106 @@ namespace Network_cpp {
         Network::getInstance(0)->layers.push_back(l1);
         Network::getInstance(0)->layers.push_back(l2);
         Network::getInstance(0)->layers.push_back(l3);
+        Network::getInstance(0)->validationBackedUp = true;
 
         EXPECT_CALL(*l1, restoreValidation()).Times(0);
         EXPECT_CALL(*l2, restoreValidation()).Times(1);
         EXPECT_CALL(*l3, restoreValidation()).Times(1);
 
         Network::getInstance(0)->restoreValidation();
+        Network::getInstance(0)->restoreValidation();
+
+        EXPECT_FALSE( Network::getInstance(0)->validationBackedUp );
+
+        delete l1;
+        delete l2;
+        delete l3;
+    }
+
+
+    // Times each layer's forward and backward calls, when profiling
+    TEST(Network, profiling) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        MockLayer* l1 = new MockLayer(0, 3);
+        MockLayer* l2 = new MockLayer(0, 3);
+        MockLayer* l3 = new MockLayer(0, 3);
+        Network* net = Network::getInstance(0);
+        net->layers.push_back(l1);
+        net->layers.push_back(l2);
+        net->layers.push_back(l3);
+
+        EXPECT_CALL(*l2, forward()).Times(2);
+        EXPECT_CALL(*l3, forward()).Times(2);
+        EXPECT_CALL(*l2, backward(false)).Times(1);
+        EXPECT_CALL(*l3, backward(true)).Times(1);
+
+        net->forward({1,2,3});
+        EXPECT_EQ( net->profiledForwards, 0 );
+
+        net->profiling = true;
+        net->forward({1,2,3});
+        net->backward();
+
+        EXPECT_EQ( net->profiledForwards, 1 );
+        EXPECT_EQ( net->profiledBackwards, 1 );
+        EXPECT_GE( l2->forwardTime, 0 );
+        EXPECT_GE( l3->backwardTime, 0 );
 
         delete l1;
         delete l2;
         delete l3;
     }
 
+    // Benchmarks the ConvLayers, saving the decisions to the tuning cache, and reads them back on later calls
+    TEST(Network, tune) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        Network* net = Network::getInstance(0);
+        net->weightInitFn = &NetMath::uniform;
+        net->weightsConfig["limit"] = 0.1;
+        net->updateFnIndex = 0;
+        net->dropout = 1;
+        net->isTraining = false;
+
+        ConvLayer* conv = new ConvLayer(0, 2);
+        conv->channels = 2;
+        conv->filterSize = 3;
+        conv->zeroPadding = 1;
+        conv->stride = 1;
+        conv->outMapSize = 8;
+        conv->inMapValuesCount = 64;
+        conv->hasActivation = false;
+
+        net->layers.push_back(new FCLayer(0, 128));
+        net->layers.push_back(conv);
+        net->layers.push_back(new FCLayer(0, 3));
+        net->joinLayers();
+
+        std::remove("tuning-test.cache");
+        net->tune("tuning-test.cache");
+
+        EXPECT_GE( conv->convAlgorithm, 0 );
+        EXPECT_LE( conv->convAlgorithm, 3 );
+
+        std::ifstream cacheFile("tuning-test.cache");
+        std::string key;
+        int algorithm;
+        cacheFile >> key >> algorithm;
+        cacheFile.close();
+
+        EXPECT_EQ( key, NetUtil::machineTag() + "-conv-2-2-3-1-1-8" );
+        EXPECT_EQ( algorithm, conv->convAlgorithm );
+
+        std::ofstream outFile("tuning-test.cache");
+        outFile << NetUtil::machineTag() << "-conv-2-2-3-1-1-8 3\n";
+        outFile.close();
+
+        net->tune("tuning-test.cache");
+        EXPECT_EQ( conv->convAlgorithm, 3 );
+
+        std::remove("tuning-test.cache");
+    }
 
     class CheckEarlyStoppingFixture : public ::testing::Test {
     public:
@@ -669,14 +741,8 @@ namespace Network_cpp {
         l2->sums = {1,2,3};
         l2->actvns = NetMath::softmax({1,2,3});
 
-        std::vector<std::tuple<std::vector<double>, std::vector<double> > > validationData = {};
-        std::tuple<std::vector<double>, std::vector<double> > data;
-        std::get<0>(data) = {1,2,3};
-        std::get<1>(data) = {1,2,3};
-        validationData.push_back(data);
-        validationData.push_back(data);
-
-        net->validationData = validationData;
+        net->validationData.push_back({1,2,3}, {1,2,3});
+        net->validationData.push_back({1,2,3}, {1,2,3});
         net->validations = 0;
 
         double result = net->validate();
@@ -687,218 +753,1757 @@ namespace Network_cpp {
         delete l2;
         Network::deleteNetwork();
     }
-}
 
-namespace FCLayer_cpp {
+    // Builds a small FC network with fixed weights, and some training and validation data
+    Network* buildThreadsTestNetwork (int threads) {
+        int index = Network::newNetwork();
+        Network* net = Network::getInstance(index);
+        net->weightInitFn = &NetMath::uniform;
+        net->weightsConfig["limit"] = 0.1;
+        net->costFunction = NetMath::meansquarederror;
+        net->updateFnIndex = 0;
+        net->learningRate = 0.2;
+        net->dropout = 1;
+        net->miniBatchSize = 4;
+        net->validationInterval = 0;
+        net->trainingLogging = false;
+        net->threads = threads;
+
+        net->layers.push_back(new FCLayer(index, 4));
+        net->layers.push_back(new FCLayer(index, 5));
+        net->layers.push_back(new FCLayer(index, 3));
+        net->joinLayers();
+
+        for (int l=1; l<3; l++) {
+            net->layers[l]->hasActivation = false;
+
+            for (int n=0; n<net->layers[l]->weights.size(); n++) {
+                for (int w=0; w<net->layers[l]->weights[n].size(); w++) {
+                    net->layers[l]->weights[n][w] = sin(l*31 + n*7 + w) * 0.5;
+                }
+            }
+        }
 
-    // Assigns the type as FC
-    TEST(FCLayer, constructor) {
-        FCLayer* layer = new FCLayer(0, 1);
-        EXPECT_EQ(layer->type, "FC");
+        for (int i=0; i<10; i++) {
+            std::vector<double> expected = {0, 0, 0};
+            expected[i%3] = 1;
+            net->trainingData.push_back({cos(i), sin(i), cos(2*i), sin(3*i)}, expected);
+            net->validationData.push_back({cos(i), sin(i), cos(2*i), sin(3*i)}, expected);
+        }
+
+        return net;
     }
 
-    // Assigns the given layer pointer to this layer's nextLayer
-    TEST(FCLayer, assignNext) {
-        FCLayer* l1 = new FCLayer(0, 1);
-        FCLayer* l2 = new FCLayer(0, 1);
+    // Splitting mini batches across replicas trains the same weights as training on one thread
+    TEST(Network, train_threads) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* parallel = buildThreadsTestNetwork(3);
 
-        l1->assignNext(l2);
-        EXPECT_EQ(l1->nextLayer, l2);
+        serial->train(10, 0);
+        parallel->train(10, 0);
 
-        delete l1;
-        delete l2;
-    }
+        EXPECT_NE( serial->layers[2]->weights[0][0], sin(62) * 0.5 );
+        EXPECT_EQ( parallel->replicas.size(), 2 );
+        EXPECT_EQ( parallel->iterations, serial->iterations );
+        EXPECT_NEAR( parallel->error, serial->error, 1e-12 );
+        EXPECT_EQ( parallel->trainingConfusionMatrix, serial->trainingConfusionMatrix );
 
-    // Assigns the given layer pointer to this layer's prevLayer
-    TEST(FCLayer, assignPrev) {
-        FCLayer* l1 = new FCLayer(0, 1);
-        FCLayer* l2 = new FCLayer(0, 1);
+        for (int l=1; l<3; l++) {
+            for (int n=0; n<serial->layers[l]->weights.size(); n++) {
+                EXPECT_NEAR( parallel->layers[l]->biases[n], serial->layers[l]->biases[n], 1e-12 );
 
-        l2->assignPrev(l1);
-        EXPECT_EQ(l2->prevLayer, l1);
+                for (int w=0; w<serial->layers[l]->weights[n].size(); w++) {
+                    EXPECT_NEAR( parallel->layers[l]->weights[n][w], serial->layers[l]->weights[n][w], 1e-12 );
+                }
+            }
+        }
 
-        delete l1;
-        delete l2;
+        Network::deleteNetwork();
     }
 
-    class InitFixture : public ::testing::Test {
-    public:
-        virtual void SetUp() {
-            Network::deleteNetwork();
-            Network::newNetwork();
-            net = Network::getInstance(0);
-            net->weightInitFn = &NetMath::uniform;
-            l1 = new FCLayer(0, 2);
-            l2 = new FCLayer(0, 5);
-            net->layers.push_back(l1);
-            net->layers.push_back(l2);
-            l2->prevLayer = l1;
-            l2->netInstance = 0;
-        }
+    // Splits validation across the replicas, with the same result as on one thread
+    TEST(Network, validate_threads) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* parallel = buildThreadsTestNetwork(4);
 
-        virtual void TearDown() {
-            delete l1;
-            delete l2;
-            Network::deleteNetwork();
-        }
+        double serialError = serial->validate();
+        double parallelError = parallel->validate();
 
-        Network* net;
-        FCLayer* l1;
-        FCLayer* l2;
-    };
+        EXPECT_EQ( parallel->replicas.size(), 3 );
+        EXPECT_EQ( parallel->validations, 10 );
+        EXPECT_NEAR( parallelError, serialError, 1e-12 );
+        EXPECT_EQ( parallel->validationConfusionMatrix, serial->validationConfusionMatrix );
 
-    // Fills the layers' neurons vectors with as many neurons as the layers' sizes
-    TEST_F(InitFixture, init_1) {
-        EXPECT_NE( l2->neurons.size(), 5 );
-        l2->init(1);
-        EXPECT_EQ( l2->neurons.size(), 5 );
+        Network::deleteNetwork();
     }
 
-    // Sets the bias of every neuron to 0
-    TEST_F(InitFixture, init_2) {
-        l2->init(1);
-
-        for (int n=0; n<5; n++) {
-            EXPECT_EQ( l2->biases[n], 1 );
-        }
-    }
+    // Validating while training one item at a time sees the new weights, not the ones the replicas were made with
+    TEST(Network, validate_threads_2) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* parallel = buildThreadsTestNetwork(3);
+        serial->miniBatchSize = parallel->miniBatchSize = 1;
 
-    // Inits the neurons' weights vector with as many weights as there are neurons in the prev layer. (none in first layer)
-    TEST_F(InitFixture, init_3) {
-        l1->init(0);
-        l2->init(1);
+        parallel->validate();
+        serial->train(10, 0);
+        parallel->train(10, 0);
+        serial->isTraining = parallel->isTraining = true;
 
-        EXPECT_EQ( l1->weights.size(), 0 );
+        EXPECT_NEAR( parallel->validate(), serial->validate(), 1e-12 );
 
-        for (int n=0; n<5; n++) {
-            EXPECT_EQ( l2->weights[n].size(), 2 );
-        }
+        Network::deleteNetwork();
     }
 
-    // Inits the neurons' weights vector with as many weights as there are outgoing values in every filter in a prev Conv layer
-    TEST_F(InitFixture, init_4) {
+    // Splits testing across the replicas, merging their confusion matrices, and their collected errors in order
+    TEST(Network, test_threads) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* parallel = buildThreadsTestNetwork(4);
+        serial->testData = serial->trainingData;
+        parallel->testData = parallel->trainingData;
+        serial->collectErrors = parallel->collectErrors = true;
 
-        ConvLayer* c = new ConvLayer(0, 2);
-        c->outMapSize = 3;
-        c->filters = {};
-        c->filters.push_back(new Filter());
-        c->filters.push_back(new Filter());
-        c->size = 2;
+        double serialError = serial->test(9, 1);
+        double parallelError = parallel->test(9, 1);
 
-        l2->prevLayer = c;
-        l2->init(1);
+        EXPECT_EQ( parallel->replicas.size(), 3 );
+        EXPECT_NEAR( parallelError, serialError, 1e-12 );
+        EXPECT_EQ( parallel->testConfusionMatrix, serial->testConfusionMatrix );
+        EXPECT_EQ( parallel->collectedTestErrors.size(), 9 );
 
-        for (int n=0; n<5; n++) {
-            EXPECT_EQ( l2->weights[n].size(), 18 );
+        for (int i=0; i<9; i++) {
+            EXPECT_NEAR( parallel->collectedTestErrors[i], serial->collectedTestErrors[i], 1e-12 );
         }
 
-        delete c;
+        Network::deleteNetwork();
     }
 
-    // Inits the neurons' weights vector with as many weights as there are outgoing values in a prev Pool layer
-    TEST_F(InitFixture, init_5) {
+    // Pipelining the samples through the layers, split across the threads, trains the same weights as one thread
+    TEST(Network, train_pipeline) {
+        for (int threads : {2, 3}) {
+            Network::deleteNetwork();
+            Network* serial = buildThreadsTestNetwork(1);
+            Network* pipelined = buildThreadsTestNetwork(threads);
+            pipelined->pipeline = true;
+            serial->collectErrors = pipelined->collectErrors = true;
+
+            for (int epoch=0; epoch<3; epoch++) {
+                serial->train(10, 0);
+                pipelined->train(10, 0);
+                EXPECT_NEAR( pipelined->error, serial->error, 1e-12 );
+            }
 
-        PoolLayer* p = new PoolLayer(0, 2);
-        p->outMapSize = 3;
-        std::vector<std::vector<double> > testData = {{1}};
-        p->activations = {testData, testData, testData, testData, testData};
+            for (int l=1; l<3; l++) {
+                for (int n=0; n<serial->layers[l]->weights.size(); n++) {
+                    for (int w=0; w<serial->layers[l]->weights[n].size(); w++) {
+                        EXPECT_NEAR( pipelined->layers[l]->weights[n][w], serial->layers[l]->weights[n][w], 1e-12 );
+                    }
+                    EXPECT_NEAR( pipelined->layers[l]->biases[n], serial->layers[l]->biases[n], 1e-12 );
+                }
+            }
 
-        l2->prevLayer = p;
-        l2->init(1);
+            EXPECT_EQ( pipelined->iterations, serial->iterations );
+            EXPECT_EQ( pipelined->trainingConfusionMatrix, serial->trainingConfusionMatrix );
+            EXPECT_EQ( pipelined->collectedTrainingErrors.size(), 30 );
 
-        for (int n=0; n<5; n++) {
-            EXPECT_EQ( l2->weights[n].size(), 45 );
+            for (int i=0; i<30; i++) {
+                EXPECT_NEAR( pipelined->collectedTrainingErrors[i], serial->collectedTrainingErrors[i], 1e-12 );
+            }
         }
 
-        delete p;
+        Network::deleteNetwork();
     }
 
+    // Conv stages hand their maps over between threads too. ConvLayers add up their errors over a mini batch, so with
+    // one sample per thread, in whole mini batches, data parallel training is what trains the same weights
+    TEST(Network, train_pipeline_conv) {
+        Network::deleteNetwork();
+        std::vector<Network*> nets;
 
-    class FCForwardFixture : public ::testing::Test {
-    public:
-        virtual void SetUp() {
-            Network::deleteNetwork();
-            Network::newNetwork();
-            Network::newNetwork();
-            net = Network::getInstance(1);
+        for (bool pipeline : {false, true}) {
+            int index = Network::newNetwork();
+            Network* net = Network::getInstance(index);
             net->weightInitFn = &NetMath::uniform;
-            l1 = new FCLayer(1, 2);
-            l2 = new FCLayer(1, 5);
-            net->layers.push_back(l1);
-            net->layers.push_back(l2);
-            l2->hasActivation = true;
-            l2->prevLayer = l1;
-            l2->netInstance = 1;
-            l2->softmax = false;
-            l1->init(0);
-            l2->init(1);
-            l2->activation = &NetMath::sigmoid<Neuron>;
-            l1->actvns = {1,2};
+            net->weightsConfig["limit"] = 0.1;
+            net->costFunction = NetMath::meansquarederror;
+            net->updateFnIndex = 0;
+            net->learningRate = 0.1;
+            net->dropout = 1;
+            net->miniBatchSize = 3;
+            net->validationInterval = 0;
+            net->trainingLogging = false;
+            net->threads = 3;
+            net->pipeline = pipeline;
+
+            ConvLayer* conv = new ConvLayer(index, 2);
+            conv->channels = 2;
+            conv->filterSize = 3;
+            conv->zeroPadding = 1;
+            conv->stride = 1;
+            conv->outMapSize = 6;
+            conv->inMapValuesCount = 36;
+            conv->hasActivation = false;
+
+            net->layers.push_back(new FCLayer(index, 72));
+            net->layers.push_back(conv);
+            net->layers.push_back(new FCLayer(index, 6));
+            net->layers.push_back(new FCLayer(index, 3));
+            net->joinLayers();
+            net->layers[2]->hasActivation = false;
+            net->layers[3]->hasActivation = false;
+
+            for (int i=0; i<9; i++) {
+                std::vector<double> input(72);
+                for (int v=0; v<72; v++) {
+                    input[v] = sin(i*13 + v);
+                }
+                net->trainingData.push_back(input, i%3);
+            }
+            net->trainingData.classes = 3;
+            nets.push_back(net);
         }
 
-        virtual void TearDown() {
-            delete l1;
-            delete l2;
-            Network::deleteNetwork();
+        for (int l=1; l<4; l++) {
+            nets[1]->layers[l]->weights = nets[0]->layers[l]->weights;
+            nets[1]->layers[l]->filterWeights = nets[0]->layers[l]->filterWeights;
+            nets[1]->layers[l]->biases = nets[0]->layers[l]->biases;
         }
 
-        Network* net;
-        FCLayer* l1;
-        FCLayer* l2;
-    };
-
-    // SETS the neurons' sum to their bias + weighted activations of last layer's neurons
-    TEST_F(FCForwardFixture, forward_1) {
-
-        for (int n=0; n<3; n++) {
-            l2->weights[n] = {1,2};
+        for (int epoch=0; epoch<2; epoch++) {
+            nets[0]->train(9, 0);
+            nets[1]->train(9, 0);
+            EXPECT_NEAR( nets[1]->error, nets[0]->error, 1e-12 );
         }
-        l2->biases = {0,1,2,1,1};
-
-        net->isTraining= false;
-        net->dropout = 1;
-
-        l2->forward();
 
-        std::vector<double> expected = {5,6,7,1,1};
+        for (int f=0; f<2; f++) {
+            for (int c=0; c<2; c++) {
+                for (int r=0; r<3; r++) {
+                    for (int v=0; v<3; v++) {
+                        EXPECT_NEAR( nets[1]->layers[1]->filterWeights[f][c][r][v], nets[0]->layers[1]->filterWeights[f][c][r][v], 1e-12 );
+                    }
+                }
+            }
+        }
 
-        EXPECT_EQ( l2->sums, expected );
+        Network::deleteNetwork();
+    }
 
-        // Check that it SETS it, and doesn't increment it
-        l2->forward();
+    // Splitting the layers' neurons across the threads, one sample at a time, trains the same weights as one thread
+    TEST(Network, train_parallelLayers) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* parallel = buildThreadsTestNetwork(3);
+        serial->miniBatchSize = 1;
+        parallel->miniBatchSize = 1;
+        parallel->parallelThreshold = 0;
+
+        serial->train(10, 0);
+        parallel->train(10, 0);
+
+        EXPECT_NEAR( parallel->error, serial->error, 1e-12 );
+        EXPECT_EQ( parallel->replicas.size(), 0 );
+
+        for (int l=1; l<3; l++) {
+            for (int n=0; n<serial->layers[l]->weights.size(); n++) {
+                EXPECT_EQ( parallel->layers[l]->biases[n], serial->layers[l]->biases[n] );
+                EXPECT_EQ( parallel->layers[l]->weights[n], serial->layers[l]->weights[n] );
+            }
+        }
 
-        EXPECT_FALSE( net->isTraining );
-        EXPECT_EQ( l2->sums, expected );
+        Network::deleteNetwork();
     }
 
-    // Sets the layer's neurons' activation to the result of the activation function
-    TEST_F(FCForwardFixture, forward_2) {
+    // Same for the filters of a ConvLayer, using the direct convolution
+    TEST(Network, train_parallelLayers_conv) {
+        Network::deleteNetwork();
+        std::vector<Network*> nets;
 
-        for (int n=0; n<3; n++) {
-            l2->weights[n] = {1,2};
+        for (int threads : {1, 3}) {
+            int index = Network::newNetwork();
+            Network* net = Network::getInstance(index);
+            net->weightInitFn = &NetMath::uniform;
+            net->weightsConfig["limit"] = 0.1;
+            net->costFunction = NetMath::meansquarederror;
+            net->updateFnIndex = 0;
+            net->learningRate = 0.1;
+            net->dropout = 1;
+            net->miniBatchSize = 1;
+            net->validationInterval = 0;
+            net->trainingLogging = false;
+            net->threads = threads;
+            net->parallelThreshold = 0;
+
+            ConvLayer* conv = new ConvLayer(index, 4);
+            conv->channels = 2;
+            conv->filterSize = 3;
+            conv->zeroPadding = 1;
+            conv->stride = 1;
+            conv->outMapSize = 6;
+            conv->inMapValuesCount = 36;
+            conv->convAlgorithm = 0;
+
+            net->layers.push_back(new FCLayer(index, 72));
+            net->layers.push_back(conv);
+            net->layers.push_back(new FCLayer(index, 3));
+            net->joinLayers();
+            net->layers[2]->hasActivation = false;
+
+            for (int i=0; i<6; i++) {
+                std::vector<double> input(72);
+                for (int v=0; v<72; v++) {
+                    input[v] = sin(i*13 + v);
+                }
+                net->trainingData.push_back(input, i%3);
+            }
+            net->trainingData.classes = 3;
+            nets.push_back(net);
         }
-        l2->biases = {0,1,2};
 
-        net->isTraining = false;
-        net->dropout = 1;
-        l2->forward();
+        for (int l=1; l<3; l++) {
+            nets[1]->layers[l]->weights = nets[0]->layers[l]->weights;
+            nets[1]->layers[l]->filterWeights = nets[0]->layers[l]->filterWeights;
+            nets[1]->layers[l]->biases = nets[0]->layers[l]->biases;
+        }
 
-        EXPECT_FALSE( net->isTraining );
+        nets[0]->train(6, 0);
+        nets[1]->train(6, 0);
 
-        EXPECT_DOUBLE_EQ( l2->actvns[0], 0.9933071490757153 );
-        EXPECT_DOUBLE_EQ( l2->actvns[1], 0.9975273768433653 );
-        EXPECT_DOUBLE_EQ( l2->actvns[2], 0.9990889488055994 );
-    }
+        EXPECT_NEAR( nets[1]->error, nets[0]->error, 1e-12 );
+        EXPECT_EQ( nets[1]->layers[1]->filterWeights, nets[0]->layers[1]->filterWeights );
+        EXPECT_EQ( nets[1]->layers[1]->biases, nets[0]->layers[1]->biases );
 
-    // Sets the layer's neurons' activation to the sum when there is no activation function
-    TEST_F(FCForwardFixture, forward_3) {
+        Network::deleteNetwork();
+    }
 
-        l2->hasActivation = false;
+    // Networks training side by side, on the shared pool, train the same weights as each one would on its own
+    TEST(Network, train_threads_concurrent) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        std::vector<Network*> nets;
 
         for (int n=0; n<3; n++) {
-            l2->weights[n] = {1,2};
+            nets.push_back(buildThreadsTestNetwork(3));
+            nets[n]->priority = n+1;
+            // Replicas get registered as network instances, so they're created before training starts
+            nets[n]->createReplicas();
         }
-        l2->biases = {0,1,2};
+        nets[1]->pipeline = true;
+
+        serial->train(10, 0);
+
+        std::vector<std::thread> trainers;
+        for (int n=0; n<3; n++) {
+            trainers.push_back(std::thread([&, n] {
+                nets[n]->train(10, 0);
+            }));
+        }
+        for (int n=0; n<3; n++) {
+            trainers[n].join();
+        }
+
+        for (int n=0; n<3; n++) {
+            EXPECT_NEAR( nets[n]->error, serial->error, 1e-12 );
+
+            for (int l=1; l<3; l++) {
+                for (int w=0; w<serial->layers[l]->weights.size(); w++) {
+                    for (int v=0; v<serial->layers[l]->weights[w].size(); v++) {
+                        EXPECT_NEAR( nets[n]->layers[l]->weights[w][v], serial->layers[l]->weights[w][v], 1e-12 );
+                    }
+                }
+            }
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // A worker's deltas land in the shared weights the same as applying them with plain SGD, and get read back
+    TEST(Network, applyHogwildDeltas) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* hogwild = buildThreadsTestNetwork(2);
+        hogwild->createReplicas();
+        hogwild->syncReplicas();
+        Network* worker = hogwild->replicas[0];
+
+        for (int i=0; i<3; i++) {
+            serial->forwardTrainingItem(serial->trainingData, i);
+            serial->backward();
+            worker->forwardTrainingItem(hogwild->trainingData, i);
+            worker->backward();
+        }
+
+        serial->applyDeltaWeights();
+        hogwild->applyHogwildDeltas(worker);
+
+        for (int l=1; l<3; l++) {
+            for (int n=0; n<serial->layers[l]->weights.size(); n++) {
+                for (int w=0; w<serial->layers[l]->weights[n].size(); w++) {
+                    EXPECT_NEAR( hogwild->layers[l]->weights[n][w], serial->layers[l]->weights[n][w], 1e-12 );
+                }
+            }
+            EXPECT_EQ( worker->layers[l]->weights, hogwild->layers[l]->weights );
+            EXPECT_EQ( worker->layers[l]->biases, hogwild->layers[l]->biases );
+            EXPECT_EQ( worker->layers[l]->deltaWeights[0][0], 0 );
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // Each thread trains its own slice, every item getting trained once, and the error still comes down
+    TEST(Network, train_hogwild) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(3);
+        net->hogwild = true;
+        net->miniBatchSize = 1;
+        net->learningRate = 0.05;
+        net->collectErrors = true;
+        net->l2 = 0.001;
+        net->l1 = 0.005;
+
+        // Each update adds up the regularization errors of the weights it changes, as synchronous training does
+        Network* synchronous = buildThreadsTestNetwork(1);
+        synchronous->miniBatchSize = 1;
+        synchronous->learningRate = 0.05;
+        synchronous->l2 = net->l2;
+        synchronous->l1 = net->l1;
+        synchronous->train(10, 0);
+
+        net->train(10, 0);
+        double firstError = net->error;
+
+        EXPECT_GT( net->l2Error, 0 );
+        EXPECT_NEAR( net->l2Error, synchronous->l2Error, synchronous->l2Error * 0.05 );
+        EXPECT_NEAR( net->l1Error, synchronous->l1Error, synchronous->l1Error * 0.05 );
+
+        for (int epoch=0; epoch<30; epoch++) {
+            net->train(10, 0);
+        }
+
+        EXPECT_EQ( net->replicas.size(), 2 );
+        EXPECT_EQ( net->iterations, 310 );
+        EXPECT_EQ( net->collectedTrainingErrors.size(), 310 );
+        EXPECT_LT( net->error, firstError );
+
+        int trained = 0;
+        for (int row=0; row<3; row++) {
+            trained += std::accumulate(net->trainingConfusionMatrix[row].begin(), net->trainingConfusionMatrix[row].end(), 0);
+        }
+        EXPECT_EQ( trained, 310 );
+
+        Network::deleteNetwork();
+    }
+
+    // Hogwild training, in mini batches, lowers the error on data it hasn't been changing the weights for
+    TEST(Network, train_hogwild_converges) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(2);
+        net->hogwild = true;
+        net->learningRate = 0.05;
+
+        double firstError = net->validate();
+
+        for (int epoch=0; epoch<50; epoch++) {
+            net->train(10, 0);
+        }
+
+        EXPECT_EQ( net->replicas.size(), 1 );
+        EXPECT_LT( net->validate(), firstError * 0.8 );
+
+        Network::deleteNetwork();
+    }
+
+    // Max norm needs all the weights at once, so it trains synchronously, instead of hogwild skipping it
+    TEST(Network, train_hogwild_maxNorm) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(2);
+        net->hogwild = true;
+        net->miniBatchSize = 1;
+        net->maxNorm = 0.5;
+
+        net->train(10, 0);
+
+        double squares = 0;
+        for (int l=1; l<3; l++) {
+            for (int n=0; n<net->layers[l]->weights.size(); n++) {
+                for (double weight : net->layers[l]->weights[n]) {
+                    squares += weight * weight;
+                }
+            }
+        }
+
+        EXPECT_LE( sqrt(squares), 0.5 + 1e-6 );
+        EXPECT_EQ( net->iterations, 10 );
+
+        Network::deleteNetwork();
+    }
+
+    // Augmented training goes through the prefetcher, synchronously, instead of hogwild skipping the augmentation
+    TEST(Network, train_hogwild_augmentation) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(2);
+        net->hogwild = true;
+        net->augmentation.noise = 0.01;
+
+        net->train(10, 0);
+
+        EXPECT_TRUE( net->prefetcher != nullptr );
+        EXPECT_EQ( net->iterations, 10 );
+
+        Network::deleteNetwork();
+    }
+
+    // Sums every worker's deltas into the network, as a tree, also for thread counts other than powers of 2
+    TEST(Network, reduceReplicas) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(6);
+        net->createReplicas();
+
+        for (int w=0; w<6; w++) {
+            Network* worker = w ? net->replicas[w-1] : net;
+            worker->layers[1]->deltaWeights[2][3] = w+1;
+            worker->layers[2]->deltaBiases[1] = 10*(w+1);
+            worker->trainingConfusionMatrix[0][1] = 1;
+        }
+
+        net->reduceReplicas();
+
+        EXPECT_EQ( net->layers[1]->deltaWeights[2][3], 21 );
+        EXPECT_EQ( net->layers[2]->deltaBiases[1], 210 );
+        EXPECT_EQ( net->trainingConfusionMatrix[0][1], 6 );
+
+        for (int r=0; r<5; r++) {
+            EXPECT_EQ( net->replicas[r]->layers[1]->deltaWeights[2][3], 0 );
+            EXPECT_EQ( net->replicas[r]->layers[2]->deltaBiases[1], 0 );
+            EXPECT_EQ( net->replicas[r]->trainingConfusionMatrix[0][1], 0 );
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // Seeded deterministic runs with dropout train exactly the same weights, both data parallel (instead of hogwild)
+    // and pipelined
+    TEST(Network, train_deterministic) {
+        for (bool pipeline : {false, true}) {
+            Network::deleteNetwork();
+            std::vector<Network*> nets = {buildThreadsTestNetwork(3), buildThreadsTestNetwork(3)};
+
+            for (Network* net : nets) {
+                net->dropout = 0.5;
+                net->learningRate = 0.02;
+                net->hogwild = !pipeline;
+                net->pipeline = pipeline;
+                net->deterministic = true;
+                net->seed = 7;
+                net->seedStreams();
+
+                for (int epoch=0; epoch<5; epoch++) {
+                    net->train(10, 0);
+                }
+            }
+
+            EXPECT_EQ( nets[0]->replicas.size(), 2 );
+            EXPECT_EQ( nets[0]->error, nets[1]->error );
+            EXPECT_NE( nets[0]->layers[1]->deltaWeights.size(), 0 );
+
+            for (int l=1; l<3; l++) {
+                EXPECT_EQ( nets[0]->layers[l]->biases, nets[1]->layers[l]->biases );
+                EXPECT_EQ( nets[0]->layers[l]->weights, nets[1]->layers[l]->weights );
+            }
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // Each layer draws from its own seeded stream, so the replicas don't drop out the same neurons
+    TEST(Network, seedStreams) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(2);
+        net->deterministic = true;
+        net->seed = 3;
+        net->createReplicas();
+
+        std::mt19937 expected;
+        std::seed_seq sequence{3u, 1u, 2u};
+        expected.seed(sequence);
+
+        EXPECT_EQ( net->dropoutDraw(net->replicas[0]->layers[2]), expected() / 4294967295.0 );
+        EXPECT_NE( net->layers[2]->rng(), net->replicas[0]->layers[2]->rng() );
+        EXPECT_NE( net->layers[1]->rng(), net->layers[2]->rng() );
+
+        Network::deleteNetwork();
+    }
+
+    // Validates a copy of the weights, so training can carry on in the meantime, and collects it like validate()
+    TEST(Network, backgroundValidation) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* background = buildThreadsTestNetwork(1);
+        serial->train(10, 0);
+        background->train(10, 0);
+
+        double serialError = serial->validate();
+
+        EXPECT_TRUE( background->startBackgroundValidation() );
+        EXPECT_FALSE( background->startBackgroundValidation() );
+        background->train(4, 0);
+        EXPECT_TRUE( background->finishBackgroundValidation(true) );
+        EXPECT_FALSE( background->finishBackgroundValidation(true) );
+
+        EXPECT_NEAR( background->validationError, serialError, 1e-12 );
+        EXPECT_NEAR( background->lastValidationError, serialError, 1e-12 );
+        EXPECT_EQ( background->validations, serial->validations );
+        EXPECT_EQ( background->validationConfusionMatrix, serial->validationConfusionMatrix );
+
+        Network::deleteNetwork();
+    }
+
+    // Deleting the networks stops their background validations first, dropping the results
+    TEST(Network, backgroundValidation_deleteNetwork) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+
+        EXPECT_TRUE( net->startBackgroundValidation() );
+        Network::deleteNetwork();
+
+        EXPECT_FALSE( net->validationThread.joinable() );
+        EXPECT_FALSE( net->validationPending );
+        EXPECT_EQ( Network::netInstances.size(), 0 );
+    }
+
+    // The epoch waits for the validation, which backs up the weights it validated, not the ones trained since
+    TEST(Network, train_backgroundValidation) {
+        Network::deleteNetwork();
+        Network* serial = buildThreadsTestNetwork(1);
+        Network* background = buildThreadsTestNetwork(1);
+        background->backgroundValidation = true;
+
+        for (Network* net : {serial, background}) {
+            net->validationInterval = 5;
+            net->collectErrors = true;
+            net->earlyStoppingType = 2;
+            net->earlyStoppingBestError = std::numeric_limits<double>::infinity();
+            net->earlyStoppingPatience = 10;
+            net->train(10, 0);
+        }
+
+        EXPECT_FALSE( background->validationPending );
+        EXPECT_FALSE( background->stoppedEarly );
+        EXPECT_EQ( background->collectedValidationErrors.size(), 1 );
+        EXPECT_NEAR( background->collectedValidationErrors[0], serial->collectedValidationErrors[0], 1e-12 );
+        EXPECT_NEAR( background->earlyStoppingBestError, serial->earlyStoppingBestError, 1e-12 );
+        EXPECT_EQ( background->layers[1]->validationWeights, serial->layers[1]->validationWeights );
+        EXPECT_EQ( background->layers[2]->validationBiases, serial->layers[2]->validationBiases );
+        EXPECT_NE( background->layers[1]->weights, background->layers[1]->validationWeights );
+
+        Network::deleteNetwork();
+    }
+
+    // Restoring twice in a row leaves the best weights in, rather than swapping the replaced ones back
+    TEST(Network, restoreValidation_twice) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+        net->validationInterval = 5;
+        net->earlyStoppingType = 2;
+        net->earlyStoppingBestError = std::numeric_limits<double>::infinity();
+        net->earlyStoppingPatience = 10;
+        net->train(10, 0);
+
+        std::vector<std::vector<double> > best = net->layers[1]->validationWeights;
+
+        EXPECT_TRUE( net->validationBackedUp );
+        EXPECT_NE( net->layers[1]->weights, best );
+
+        net->restoreValidation();
+        EXPECT_EQ( net->layers[1]->weights, best );
+
+        net->restoreValidation();
+        EXPECT_EQ( net->layers[1]->weights, best );
+
+        Network::deleteNetwork();
+    }
+
+    // A train() which doesn't beat the best validation error so far keeps its own weights, when restoring afterwards
+    TEST(Network, restoreValidation_noNewBackUp) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+        net->validationInterval = 5;
+        net->earlyStoppingType = 2;
+        net->earlyStoppingBestError = std::numeric_limits<double>::infinity();
+        net->earlyStoppingPatience = 10;
+        net->train(10, 0);
+        net->restoreValidation();
+
+        net->earlyStoppingBestError = 0;
+        net->train(10, 0);
+
+        std::vector<std::vector<double> > trained = net->layers[1]->weights;
+        std::vector<double> trainedBiases = net->layers[2]->biases;
+        net->restoreValidation();
+
+        EXPECT_FALSE( net->validationBackedUp );
+        EXPECT_EQ( net->layers[1]->weights, trained );
+        EXPECT_EQ( net->layers[2]->biases, trainedBiases );
+
+        Network::deleteNetwork();
+    }
+
+    // Trains in whole mini batches until the time budget runs out, picking up where it left off, the same as train()
+    TEST(Network, trainFor) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+        Network* stepped = buildThreadsTestNetwork(1);
+
+        net->train(10, 0);
+
+        EXPECT_EQ( stepped->trainFor(0), 4 );
+        EXPECT_EQ( stepped->trainingCursor, 4 );
+        EXPECT_EQ( stepped->trainFor(0), 4 );
+        EXPECT_EQ( stepped->trainingCursor, 8 );
+        EXPECT_EQ( stepped->trainFor(0), 2 );
+        EXPECT_EQ( stepped->trainingCursor, 0 );
+
+        EXPECT_EQ( stepped->iterations, net->iterations );
+        EXPECT_NEAR( stepped->error, net->error, 1e-12 );
+
+        for (int l=1; l<3; l++) {
+            for (int n=0; n<net->layers[l]->weights.size(); n++) {
+                for (int w=0; w<net->layers[l]->weights[n].size(); w++) {
+                    EXPECT_NEAR( stepped->layers[l]->weights[n][w], net->layers[l]->weights[n][w], 1e-12 );
+                }
+            }
+        }
+
+        // A whole epoch fits in a large enough budget
+        EXPECT_EQ( stepped->trainFor(60000), 10 );
+        EXPECT_EQ( stepped->trainingCursor, 0 );
+
+        Network::deleteNetwork();
+    }
+
+    // Shuffles the order the training data is trained in, without moving the data
+    TEST(Network, shuffleTrainingOrder) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+        std::vector<float> data = net->trainingData.values;
+
+        net->shuffleTrainingOrder();
+
+        std::vector<int> sorted = net->trainingOrder;
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<int> expected = {0,1,2,3,4,5,6,7,8,9};
+
+        EXPECT_EQ( sorted, expected );
+        EXPECT_NE( net->trainingOrder, expected );
+        EXPECT_EQ( net->trainingData.values, data );
+        EXPECT_EQ( net->trainingIndex(3), net->trainingOrder[3] );
+
+        Network::deleteNetwork();
+    }
+
+    // Trains on the samples in the shuffled order, the same as training on the moved samples
+    TEST(Network, train_trainingOrder) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+        Network* reordered = buildThreadsTestNetwork(1);
+
+        net->trainingOrder = {9,8,7,6,5,4,3,2,1,0};
+        reordered->trainingData.clear();
+
+        for (int i=9; i>=0; i--) {
+            std::vector<double> expected = {0, 0, 0};
+            expected[i%3] = 1;
+            reordered->trainingData.push_back({cos(i), sin(i), cos(2*i), sin(3*i)}, expected);
+        }
+
+        net->train(10, 0);
+        reordered->train(10, 0);
+
+        EXPECT_NEAR( net->error, reordered->error, 1e-12 );
+
+        for (int l=1; l<3; l++) {
+            for (int n=0; n<net->layers[l]->weights.size(); n++) {
+                for (int w=0; w<net->layers[l]->weights[n].size(); w++) {
+                    EXPECT_NEAR( net->layers[l]->weights[n][w], reordered->layers[l]->weights[n][w], 1e-12 );
+                }
+            }
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // Training off prefetched batches trains the same weights as training off the data set, across train() calls
+    TEST(Network, train_prefetch) {
+        Network::deleteNetwork();
+
+        for (int threads=1; threads<=3; threads+=2) {
+            Network* net = buildThreadsTestNetwork(threads);
+            Network* prefetched = buildThreadsTestNetwork(threads);
+
+            net->trainingOrder = {3,1,4,9,5,2,6,0,8,7};
+            prefetched->trainingOrder = net->trainingOrder;
+            prefetched->prefetch = 2;
+
+            net->train(10, 0);
+            prefetched->train(4, 0);
+            prefetched->train(4, 4);
+            prefetched->train(2, 8);
+
+            EXPECT_EQ( prefetched->prefetcher->stats()[3], 3 );
+            EXPECT_EQ( prefetched->trainingConfusionMatrix, net->trainingConfusionMatrix );
+
+            for (int l=1; l<3; l++) {
+                for (int n=0; n<net->layers[l]->weights.size(); n++) {
+                    for (int w=0; w<net->layers[l]->weights[n].size(); w++) {
+                        EXPECT_NEAR( prefetched->layers[l]->weights[n][w], net->layers[l]->weights[n][w], 1e-12 );
+                    }
+                }
+            }
+
+            // Shuffling stops the loader, and the next train() call starts it again
+            prefetched->shuffleTrainingOrder();
+            EXPECT_FALSE( prefetched->prefetcher->loader.joinable() );
+            prefetched->train(10, 0);
+            EXPECT_TRUE( prefetched->prefetcher->loader.joinable() );
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // Class index data sets train, validate and test the same as their one-hot versions
+    TEST(Network, train_labels) {
+        Network::deleteNetwork();
+
+        for (int cost=0; cost<2; cost++) {
+            Network* net = buildThreadsTestNetwork(1);
+            Network* labelled = buildThreadsTestNetwork(1);
+
+            if (cost) {
+                net->layers[2]->softmax = labelled->layers[2]->softmax = true;
+                net->costFunction = labelled->costFunction = NetMath::crossentropy;
+                labelled->labelCostFunction = NetMath::crossentropy;
+            } else {
+                labelled->labelCostFunction = NetMath::meansquarederror;
+            }
+
+            labelled->trainingData.clear();
+            labelled->trainingData.classes = 3;
+
+            for (int i=0; i<10; i++) {
+                labelled->trainingData.push_back({cos(i), sin(i), cos(2*i), sin(3*i)}, i%3);
+            }
+            labelled->validationData = labelled->trainingData;
+            labelled->testData = labelled->trainingData;
+            net->testData = net->trainingData;
+
+            net->train(10, 0);
+            labelled->train(10, 0);
+
+            EXPECT_NEAR( labelled->error, net->error, 1e-12 );
+            EXPECT_EQ( labelled->trainingConfusionMatrix, net->trainingConfusionMatrix );
+            EXPECT_NEAR( labelled->validate(), net->validate(), 1e-12 );
+            EXPECT_EQ( labelled->validationConfusionMatrix, net->validationConfusionMatrix );
+            EXPECT_NEAR( labelled->test(10, 0), net->test(10, 0), 1e-12 );
+            EXPECT_EQ( labelled->testConfusionMatrix, net->testConfusionMatrix );
+
+            for (int l=1; l<3; l++) {
+                for (int n=0; n<net->layers[l]->weights.size(); n++) {
+                    for (int w=0; w<net->layers[l]->weights[n].size(); w++) {
+                        EXPECT_NEAR( labelled->layers[l]->weights[n][w], net->layers[l]->weights[n][w], 1e-12 );
+                    }
+                }
+            }
+        }
+
+        Network::deleteNetwork();
+    }
+
+    // Offset, then biases, weights and optimizer state counts, for every layer
+    TEST(Network, parametersLayout) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+
+        std::vector<int> expected = {0,0,0,0,0, 0,5,20,0,20, 45,3,15,0,15};
+        EXPECT_EQ( net->parametersLayout(), expected );
+
+        net->updateFnIndex = 5;
+        expected = {0,0,0,0,0, 0,5,20,50,20, 95,3,15,36,15};
+        EXPECT_EQ( net->parametersLayout(), expected );
+
+        net->updateFnIndex = 4;
+        expected = {0,0,0,0,0, 0,5,20,10,20, 55,3,15,6,15};
+        EXPECT_EQ( net->parametersLayout(), expected );
+
+        Network::deleteNetwork();
+    }
+
+    // Moves the weights, biases and optimizer state from one network into another, through one buffer
+    TEST(Network, exportParameters_importParameters) {
+        Network::deleteNetwork();
+        Network* net = buildThreadsTestNetwork(1);
+        Network* other = buildThreadsTestNetwork(1);
+        net->updateFnIndex = other->updateFnIndex = 4;
+
+        for (int n=0; n<3; n++) {
+            net->layers[2]->biases[n] = n + 0.5;
+            net->layers[2]->neurons[n]->m = n;
+            net->layers[2]->neurons[n]->v = n * 2;
+            other->layers[2]->weights[n][0] = 9;
+            other->layers[2]->deltaWeights[n][0] = 1;
+        }
+
+        std::vector<int> layout = net->parametersLayout();
+        std::vector<double> values(layout[10] + layout[11] + layout[12] + layout[13] + layout[14]);
+        net->exportParameters(values.data());
+
+        EXPECT_EQ( values.size(), 94 );
+        EXPECT_EQ( values[5], net->layers[1]->weights[0][0] );
+        EXPECT_EQ( values[55], 0.5 );
+        EXPECT_EQ( values[58], net->layers[2]->weights[0][0] );
+        EXPECT_EQ( values[75], 1 );
+        EXPECT_EQ( values[76], 2 );
+        EXPECT_EQ( values[79], 1 );
+
+        other->importParameters(values.data());
+
+        for (int l=1; l<3; l++) {
+            EXPECT_EQ( other->layers[l]->biases, net->layers[l]->biases );
+            EXPECT_EQ( other->layers[l]->weights, net->layers[l]->weights );
+        }
+
+        for (int n=0; n<3; n++) {
+            EXPECT_EQ( other->layers[2]->neurons[n]->m, n );
+            EXPECT_EQ( other->layers[2]->neurons[n]->v, n * 2 );
+            EXPECT_EQ( other->layers[2]->deltaWeights[n][0], 0 );
+        }
+
+        Network::deleteNetwork();
+    }
+}
+
+namespace ThreadPool_cpp {
+
+    // Runs every task exactly once, across the pool and the calling thread
+    TEST(ThreadPool, run) {
+        ThreadPool pool(3);
+        std::vector<int> counts(50, 0);
+
+        pool.run(50, [&](int i) {
+            counts[i]++;
+        });
+        pool.run(50, [&](int i) {
+            counts[i]++;
+        });
+
+        EXPECT_EQ( counts, std::vector<int>(50, 2) );
+    }
+
+    // Runs tasks started from inside a task on that same thread, as the other threads are busy
+    TEST(ThreadPool, run_nested) {
+        ThreadPool pool(2);
+        std::vector<std::vector<int> > counts(6, std::vector<int>(4, 0));
+
+        pool.run(6, [&](int i) {
+            std::thread::id id = std::this_thread::get_id();
+
+            pool.run(4, [&](int j) {
+                EXPECT_EQ( std::this_thread::get_id(), id );
+                counts[i][j]++;
+            });
+        });
+
+        EXPECT_EQ( counts, std::vector<std::vector<int> >(6, std::vector<int>(4, 1)) );
+        EXPECT_FALSE( ThreadPool::inTask );
+    }
+
+    // Jobs from several threads at once all get run, sharing the workers
+    TEST(ThreadPool, run_concurrent) {
+        ThreadPool pool(2);
+        std::vector<std::vector<int> > counts(4, std::vector<int>(30, 0));
+        std::vector<std::thread> callers;
+
+        for (int c=0; c<4; c++) {
+            callers.push_back(std::thread([&, c] {
+                for (int r=0; r<5; r++) {
+                    pool.run(30, [&](int i) {
+                        counts[c][i]++;
+                    }, c+1);
+                }
+            }));
+        }
+        for (int c=0; c<4; c++) {
+            callers[c].join();
+        }
+
+        EXPECT_EQ( counts, std::vector<std::vector<int> >(4, std::vector<int>(30, 5)) );
+        EXPECT_EQ( pool.jobs.size(), 0 );
+        EXPECT_EQ( pool.reservedWorkers, 0 );
+    }
+
+    // Gang jobs' tasks all run at once, even with other gang jobs competing for the workers
+    TEST(ThreadPool, run_gang) {
+        ThreadPool pool(0);
+        std::vector<std::thread> callers;
+        std::vector<int> done(3, 0);
+
+        for (int c=0; c<3; c++) {
+            callers.push_back(std::thread([&, c] {
+                std::atomic<int> arrived{0};
+
+                pool.run(3, [&](int i) {
+                    arrived++;
+                    while (arrived < 3) {
+                        std::this_thread::yield();
+                    }
+                }, 1, true);
+
+                done[c] = arrived;
+            }));
+        }
+        for (int c=0; c<3; c++) {
+            callers[c].join();
+        }
+
+        EXPECT_EQ( pool.workers.size(), 2 );
+        EXPECT_EQ( done, std::vector<int>(3, 3) );
+        EXPECT_EQ( pool.reservedWorkers, 0 );
+    }
+
+    // Gang jobs started from inside tasks still get all of their tasks running at once, on workers added for them
+    TEST(ThreadPool, run_gang_nested) {
+        ThreadPool pool(1);
+        std::vector<int> done(2, 0);
+
+        pool.run(2, [&](int i) {
+            std::atomic<int> arrived{0};
+
+            pool.run(3, [&](int j) {
+                arrived++;
+                while (arrived < 3) {
+                    std::this_thread::yield();
+                }
+            }, 1, true);
+
+            done[i] = arrived;
+            EXPECT_TRUE( ThreadPool::inTask );
+        });
+
+        EXPECT_EQ( done, std::vector<int>(2, 3) );
+        EXPECT_GE( pool.workers.size(), 3 );
+        EXPECT_EQ( pool.reservedWorkers, 0 );
+        EXPECT_FALSE( ThreadPool::inTask );
+    }
+
+    // Workers go to the job with the fewest threads on it for its priority, and to let in gang jobs first
+    TEST(ThreadPool, nextJob) {
+        ThreadPool pool(0);
+        ThreadPool::Job a, b, gang;
+        a.count = b.count = gang.count = 4;
+        a.running = 2;
+        b.running = 3;
+        b.priority = 2;
+        pool.jobs = {&a, &b};
+
+        EXPECT_EQ( pool.nextJob(), &b );
+
+        b.running = 5;
+        EXPECT_EQ( pool.nextJob(), &a );
+
+        a.next = 4;
+        EXPECT_EQ( pool.nextJob(), &b );
+
+        gang.gang = true;
+        gang.admitted = false;
+        pool.jobs.push_back(&gang);
+        EXPECT_EQ( pool.nextJob(), (ThreadPool::Job*) 0 );
+
+        gang.admitted = true;
+        EXPECT_EQ( pool.nextJob(), &gang );
+        pool.jobs.clear();
+    }
+
+    // Every network instance uses the same pool, sized for the most threads asked for
+    TEST(ThreadPool, shared) {
+        Network::deleteNetwork();
+        Network* a = Network_cpp::buildThreadsTestNetwork(3);
+        Network* b = Network_cpp::buildThreadsTestNetwork(2);
+        a->createThreadPool();
+        b->createThreadPool();
+
+        EXPECT_EQ( a->threadPool, b->threadPool );
+        EXPECT_EQ( a->threadPool, ThreadPool::shared(0) );
+        EXPECT_GE( a->threadPool->workers.size(), 2 );
+        Network::deleteNetwork();
+    }
+}
+
+namespace Dataset_cpp {
+
+    // Copies the samples in, with the input and expected value counts
+    TEST(Dataset, load) {
+        float buf[] = {1,2,3, 4,5,6};
+        Dataset data;
+        data.load(buf, 6, 3, 2, 0);
+
+        std::vector<float> expected = {1,2,3,4,5,6};
+        EXPECT_EQ( data.values, expected );
+        EXPECT_EQ( data.size(), 2 );
+        EXPECT_EQ( data.inputSize, 2 );
+        EXPECT_EQ( data.expectedSize, 1 );
+        EXPECT_EQ( data.input(1)[1], 5 );
+        EXPECT_EQ( data.expected(1)[0], 6 );
+    }
+
+    // Replaces what was there before
+    TEST(Dataset, load_2) {
+        float buf[] = {1,2,3,4};
+        Dataset data;
+        data.push_back({9}, {9});
+        data.load(buf, 4, 4, 3, 0);
+
+        EXPECT_EQ( data.size(), 1 );
+        EXPECT_EQ( data.expectedValues(0), std::vector<double>({4}) );
+    }
+
+    // Stores class index samples with just the one expected value, building one-hot values only when asked for
+    TEST(Dataset, load_labels) {
+        float buf[] = {1,2,3, 4,5,0};
+        Dataset data;
+        data.load(buf, 6, 3, 2, 4);
+
+        EXPECT_EQ( data.size(), 2 );
+        EXPECT_EQ( data.classes, 4 );
+        EXPECT_EQ( data.label(0), 3 );
+        EXPECT_EQ( data.label(1), 0 );
+        EXPECT_EQ( data.expectedValues(0), std::vector<double>({0,0,0,1}) );
+
+        data.load(buf, 6, 3, 2, 0);
+        EXPECT_EQ( data.label(0), -1 );
+        EXPECT_EQ( data.expectedValues(0), std::vector<double>({3}) );
+    }
+
+    // Appends class index samples
+    TEST(Dataset, push_back_label) {
+        Dataset data;
+        data.classes = 3;
+        data.push_back({1,2}, 2);
+        data.push_back({3,4}, 1);
+
+        EXPECT_EQ( data.stride, 3 );
+        EXPECT_EQ( data.label(1), 1 );
+        EXPECT_EQ( data.expectedValues(0), std::vector<double>({0,0,1}) );
+    }
+
+    // Appends samples one at a time, counting samples with no values too
+    TEST(Dataset, push_back) {
+        Dataset data;
+        data.push_back({1,2}, {3});
+        data.push_back({4,5}, {6});
+
+        EXPECT_EQ( data.size(), 2 );
+        EXPECT_EQ( data.stride, 3 );
+        EXPECT_EQ( data.expectedValues(1), std::vector<double>({6}) );
+
+        Dataset empty;
+        empty.push_back({}, {});
+        empty.push_back({}, {});
+        EXPECT_EQ( empty.size(), 2 );
+
+        empty.clear();
+        EXPECT_EQ( empty.size(), 0 );
+    }
+
+    // Copies of a shared data set read the same values, until one of them is appended to, or loaded into
+    TEST(Dataset, share) {
+        Dataset data;
+        data.push_back({1,2}, {3});
+        data.push_back({4,5}, {6});
+        data.share();
+
+        Dataset copy = data;
+        EXPECT_EQ( data.values.size(), 0 );
+        EXPECT_EQ( copy.input(1), data.input(1) );
+        EXPECT_EQ( copy.size(), 2 );
+        EXPECT_EQ( copy.expected(1)[0], 6 );
+
+        copy.push_back({7,8}, {9});
+        EXPECT_EQ( copy.size(), 3 );
+        EXPECT_EQ( data.size(), 2 );
+        EXPECT_NE( copy.input(1), data.input(1) );
+        EXPECT_EQ( copy.input(1)[0], 4 );
+
+        float buf[] = {1,2,3};
+        data.load(buf, 3, 3, 2, 0);
+        EXPECT_FALSE( data.shared );
+        EXPECT_EQ( data.size(), 1 );
+    }
+}
+
+namespace Sweep_cpp {
+
+    // Successive halving keeps the networks with the lowest validation errors training, on the first one's data
+    TEST(Sweep, run) {
+        Network::deleteNetwork();
+        std::vector<Network*> nets;
+        std::vector<Network*> references;
+        std::vector<float> learningRates = {0.01, 0.4, 0.2, 0.05};
+
+        for (int n=0; n<4; n++) {
+            nets.push_back(Network_cpp::buildThreadsTestNetwork(1));
+            references.push_back(Network_cpp::buildThreadsTestNetwork(1));
+            nets[n]->learningRate = learningRates[n];
+            references[n]->learningRate = learningRates[n];
+
+            if (n) {
+                nets[n]->trainingData.clear();
+                nets[n]->validationData.clear();
+            }
+        }
+
+        Sweep sweep(nets);
+        sweep.threads = 3;
+        sweep.run();
+
+        for (int n=1; n<4; n++) {
+            EXPECT_EQ( nets[n]->trainingData.input(0), nets[0]->trainingData.input(0) );
+            EXPECT_EQ( nets[n]->validationData.input(0), nets[0]->validationData.input(0) );
+        }
+
+        std::vector<int> rounds = sweep.rounds;
+        std::sort(rounds.begin(), rounds.end());
+        EXPECT_EQ( rounds, std::vector<int>({1, 1, 2, 3}) );
+        EXPECT_EQ( sweep.epochs, sweep.rounds );
+
+        // The networks trained the same as they would have alone, for their epochs
+        for (int n=0; n<4; n++) {
+            for (int e=0; e<sweep.epochs[n]; e++) {
+                references[n]->train(10, 0);
+            }
+
+            EXPECT_NEAR( sweep.trainingErrors[n], references[n]->error, 1e-12 );
+            EXPECT_NEAR( sweep.validationErrors[n], references[n]->validate(), 1e-12 );
+        }
+
+        std::vector<std::vector<double> > results = sweep.results();
+        EXPECT_EQ( results.size(), 4 );
+        EXPECT_EQ( results[0][4], 3 );
+        EXPECT_EQ( results[1][4], 2 );
+        EXPECT_LE( results[2][1], results[3][1] );
+
+        Network::deleteNetwork();
+    }
+
+    // Gives every network its own prefetching, threads and validation settings back, eliminated early or not
+    TEST(Sweep, run_settings) {
+        Network::deleteNetwork();
+        std::vector<Network*> nets;
+
+        for (int n=0; n<3; n++) {
+            nets.push_back(Network_cpp::buildThreadsTestNetwork(n+2));
+            nets[n]->learningRate = 0.1 * (n+1);
+            nets[n]->prefetch = n+1;
+            nets[n]->backgroundValidation = n==1;
+            nets[n]->validationInterval = 5 * (n+1);
+        }
+
+        Sweep sweep(nets);
+        sweep.run();
+
+        for (int n=0; n<3; n++) {
+            EXPECT_EQ( nets[n]->threads, n+2 );
+            EXPECT_EQ( nets[n]->prefetch, n+1 );
+            EXPECT_EQ( nets[n]->backgroundValidation, n==1 );
+            EXPECT_EQ( nets[n]->validationInterval, 5 * (n+1) );
+        }
+
+        Network::deleteNetwork();
+    }
+}
+
+namespace Ensemble_cpp {
+
+    // Builds 3 networks with different weights, and an ensemble of them
+    Ensemble* buildEnsemble (void) {
+        Network::deleteNetwork();
+        std::vector<int> instances;
+
+        for (int n=0; n<3; n++) {
+            Network* net = Network_cpp::buildThreadsTestNetwork(1);
+            instances.push_back(net->instanceIndex);
+
+            for (int w=0; w<net->layers[2]->weights[0].size(); w++) {
+                net->layers[2]->weights[n][w] += 0.3;
+            }
+        }
+
+        return Ensemble::getInstance(Ensemble::newEnsemble(instances));
+    }
+
+    // Each network's outputs for the inputs, one at a time
+    std::vector<std::vector<double> > forwardEach (Ensemble* ensemble, const std::vector<float>& inputs, int n) {
+        std::vector<std::vector<double> > outputs;
+        Network* net = Network::getInstance(ensemble->networks[n]);
+
+        for (int i=0; i<inputs.size()/4; i++) {
+            outputs.push_back(net->forward(std::vector<double>(inputs.begin() + i*4, inputs.begin() + (i+1)*4)));
+        }
+        return outputs;
+    }
+
+    // The mean of the networks' outputs, the same across threads
+    TEST(Ensemble, forward) {
+        Ensemble* ensemble = buildEnsemble();
+        std::vector<float> inputs = {0.1, 0.2, 0.3, 0.4, -0.5, 0.6, 0.7, -0.8};
+
+        std::vector<double> combined = ensemble->forward(inputs.data(), 2);
+        EXPECT_EQ( combined.size(), 6 );
+
+        std::vector<std::vector<std::vector<double> > > outputs;
+        for (int n=0; n<3; n++) {
+            outputs.push_back(forwardEach(ensemble, inputs, n));
+        }
+
+        for (int i=0; i<2; i++) {
+            for (int o=0; o<3; o++) {
+                EXPECT_NEAR( combined[i*3 + o], (outputs[0][i][o] + outputs[1][i][o] + outputs[2][i][o]) / 3, 1e-12 );
+            }
+        }
+
+        ensemble->threads = 3;
+        EXPECT_EQ( ensemble->forward(inputs.data(), 2), combined );
+
+        Ensemble::deleteEnsemble(ensemble->instanceIndex);
+        Network::deleteNetwork();
+    }
+
+    // Weighted means, and votes for each network's highest output
+    TEST(Ensemble, combineOutputs) {
+        Ensemble ensemble;
+        ensemble.outputs = {{1, 2, 0, 0, 0, 1}, {3, 1, 0, 1, 0, 0}};
+        ensemble.weights = {3, 1};
+
+        ensemble.combine = 1;
+        EXPECT_EQ( ensemble.combineOutputs(2, 3), std::vector<double>({1.5, 1.75, 0, 0.25, 0, 0.75}) );
+
+        ensemble.combine = 2;
+        EXPECT_EQ( ensemble.combineOutputs(2, 3), std::vector<double>({0.5, 0.5, 0, 0.5, 0, 0.5}) );
+
+        ensemble.combine = 0;
+        EXPECT_EQ( ensemble.combineOutputs(2, 3), std::vector<double>({2, 1.5, 0, 0.5, 0, 0.5}) );
+    }
+}
+
+namespace Prefetcher_cpp {
+
+    class PrefetcherFixture : public ::testing::Test {
+    public:
+        Network* net;
+        Prefetcher* prefetcher;
+
+        virtual void SetUp() {
+            Network::deleteNetwork();
+            net = new Network();
+            net->miniBatchSize = 4;
+
+            for (int i=0; i<10; i++) {
+                net->trainingData.push_back({(double) i, (double) -i}, std::vector<double>({(double) i*10}));
+            }
+            net->trainingOrder = {9,8,7,6,5,4,3,2,1,0};
+
+            prefetcher = new Prefetcher(net, 2);
+            prefetcher->start();
+        }
+
+        virtual void TearDown() {
+            delete prefetcher;
+            delete net;
+        }
+    };
+
+    // Batches hold their samples in training order, ending short at the end of the data
+    TEST_F(PrefetcherFixture, batch_1) {
+        Dataset& first = prefetcher->batch(0);
+        EXPECT_EQ( first.size(), 4 );
+        EXPECT_EQ( first.inputSize, 2 );
+        EXPECT_EQ( first.input(0)[0], 9 );
+        EXPECT_EQ( first.input(3)[1], -6 );
+        EXPECT_EQ( first.expected(3)[0], 60 );
+
+        Dataset& last = prefetcher->batch(9);
+        EXPECT_EQ( last.size(), 2 );
+        EXPECT_EQ( last.input(1)[0], 0 );
+    }
+
+    // Skipping back to an earlier batch loads it again
+    TEST_F(PrefetcherFixture, batch_2) {
+        prefetcher->batch(0);
+        prefetcher->batch(4);
+        prefetcher->batch(8);
+
+        Dataset& first = prefetcher->batch(2);
+        EXPECT_EQ( first.input(1)[0], 8 );
+        EXPECT_EQ( prefetcher->currentBatch, 0 );
+        EXPECT_EQ( prefetcher->stats()[3], 4 );
+    }
+
+    // Prefetching one batch loads the next one while the current one is trained
+    TEST_F(PrefetcherFixture, batch_3) {
+        net->prefetch = 1;
+        net->startPrefetching();
+        EXPECT_EQ( net->prefetcher->slots.size(), 2 );
+
+        net->prefetcher->batch(0);
+        std::unique_lock<std::mutex> lock(net->prefetcher->mutex);
+        EXPECT_TRUE( net->prefetcher->batchReady.wait_for(lock, std::chrono::seconds(1), [&]{ return net->prefetcher->slotBatches[1] == 1; }) );
+        EXPECT_EQ( net->prefetcher->currentBatch, 0 );
+        EXPECT_EQ( net->prefetcher->slotBatches[0], 0 );
+    }
+
+    // Waiting on a batch counts as a stall
+    TEST_F(PrefetcherFixture, stats) {
+        prefetcher->stop();
+
+        // Asked for before the loader has started
+        Prefetcher waiting(net, 1);
+        waiting.batchSize = 4;
+        waiting.slotBatches = {-1};
+        std::thread trainer([&]{ waiting.batch(0); });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        waiting.start();
+        trainer.join();
+
+        std::vector<double> stats = waiting.stats();
+        EXPECT_EQ( stats[1], 1 );
+        EXPECT_GE( stats[0], 10 );
+        EXPECT_EQ( stats[3], 1 );
+    }
+
+    // Stops the loader, which start() can start again
+    TEST_F(PrefetcherFixture, stop) {
+        prefetcher->stop();
+        EXPECT_FALSE( prefetcher->loader.joinable() );
+
+        prefetcher->start();
+        EXPECT_TRUE( prefetcher->loader.joinable() );
+        EXPECT_EQ( prefetcher->batch(5).input(0)[0], 5 );
+    }
+
+    // Without the background thread, batches are loaded when asked for, and augmented, leaving the data set as it was
+    TEST(Prefetcher, augment_inPlace) {
+        Network::deleteNetwork();
+        Network* net = Network_cpp::buildThreadsTestNetwork(1);
+        std::vector<float> original = net->trainingData.values;
+
+        net->augmentation.noise = 0.5;
+        net->train(10, 0);
+
+        EXPECT_FALSE( net->prefetcher->background );
+        EXPECT_FALSE( net->prefetcher->loader.joinable() );
+        EXPECT_EQ( net->prefetcher->stats()[3], 3 );
+        EXPECT_EQ( net->trainingData.values, original );
+        EXPECT_NE( net->prefetcher->slots[0].values[0], original[8*7] );
+        EXPECT_EQ( net->prefetcher->slots[0].values[4], original[8*7+4] );
+
+        // Turning it off reads the data set directly again
+        net->augmentation.noise = 0;
+        net->train(10, 0);
+        EXPECT_FALSE( net->prefetcher->running );
+
+        Network::deleteNetwork();
+    }
+}
+
+namespace Augmentation_cpp {
+
+    std::vector<float> map = {1,2,3,4,5,6,7,8,9};
+
+    // Shifts the map, filling in with 0s
+    TEST(Augmentation, transform_shift) {
+        std::vector<float> input = map;
+        std::vector<float> scratch;
+
+        Augmentation::transform(input.data(), 1, 3, 1, -1, false, 0, scratch);
+        EXPECT_EQ( input, std::vector<float>({0,4,5, 0,7,8, 0,0,0}) );
+    }
+
+    // Mirrors each row
+    TEST(Augmentation, transform_mirror) {
+        std::vector<float> input = map;
+        std::vector<float> scratch;
+
+        Augmentation::transform(input.data(), 1, 3, 0, 0, true, 0, scratch);
+        EXPECT_EQ( input, std::vector<float>({3,2,1, 6,5,4, 9,8,7}) );
+    }
+
+    // Rotates about the centre
+    TEST(Augmentation, transform_rotate) {
+        std::vector<float> input = map;
+        std::vector<float> scratch;
+        std::vector<float> expected = {7,4,1, 8,5,2, 9,6,3};
+
+        Augmentation::transform(input.data(), 1, 3, 0, 0, false, 3.14159265358979323846 / 2, scratch);
+
+        for (int i=0; i<9; i++) {
+            EXPECT_NEAR( input[i], expected[i], 1e-5 );
+        }
+    }
+
+    // Transforms every channel the same way
+    TEST(Augmentation, transform_channels) {
+        std::vector<float> input = {1,2,3,4, 5,6,7,8};
+        std::vector<float> scratch;
+
+        Augmentation::transform(input.data(), 2, 2, 1, 0, false, 0, scratch);
+        EXPECT_EQ( input, std::vector<float>({0,1,0,3, 0,5,0,7}) );
+    }
+
+    TEST(Augmentation, enabled) {
+        Augmentation augmentation;
+        EXPECT_FALSE( augmentation.enabled() );
+
+        augmentation.rotation = 10;
+        EXPECT_TRUE( augmentation.enabled() );
+    }
+
+    // Only adds noise to inputs that aren't channels x span x span, and seeded runs augment the same way
+    TEST(Augmentation, apply) {
+        Augmentation augmentation;
+        std::vector<float> scratch;
+        augmentation.shift = 1;
+        augmentation.flip = true;
+
+        std::vector<float> flat = {1,2,3,4,5};
+        augmentation.apply(flat.data(), 5, 1, scratch);
+        EXPECT_EQ( flat, std::vector<float>({1,2,3,4,5}) );
+
+        augmentation.noise = 0.1;
+        augmentation.apply(flat.data(), 5, 1, scratch);
+        EXPECT_NE( flat, std::vector<float>({1,2,3,4,5}) );
+
+        std::vector<float> first = map;
+        std::vector<float> second = map;
+
+        augmentation.rng.seed(7);
+        augmentation.apply(first.data(), 9, 1, scratch);
+        augmentation.rng.seed(7);
+        augmentation.apply(second.data(), 9, 1, scratch);
+
+        EXPECT_EQ( first, second );
+    }
+}
+
+namespace FCLayer_cpp {
+
+    // Assigns the type as FC
+    TEST(FCLayer, constructor) {
+        FCLayer* layer = new FCLayer(0, 1);
+        EXPECT_EQ(layer->type, "FC");
+    }
+
+    // Assigns the given layer pointer to this layer's nextLayer
+    TEST(FCLayer, assignNext) {
+        FCLayer* l1 = new FCLayer(0, 1);
+        FCLayer* l2 = new FCLayer(0, 1);
+
+        l1->assignNext(l2);
+        EXPECT_EQ(l1->nextLayer, l2);
+
+        delete l1;
+        delete l2;
+    }
+
+    // Assigns the given layer pointer to this layer's prevLayer
+    TEST(FCLayer, assignPrev) {
+        FCLayer* l1 = new FCLayer(0, 1);
+        FCLayer* l2 = new FCLayer(0, 1);
+
+        l2->assignPrev(l1);
+        EXPECT_EQ(l2->prevLayer, l1);
+
+        delete l1;
+        delete l2;
+    }
+
+    class InitFixture : public ::testing::Test {
+    public:
+        virtual void SetUp() {
+            Network::deleteNetwork();
+            Network::newNetwork();
+            net = Network::getInstance(0);
+            net->weightInitFn = &NetMath::uniform;
+            l1 = new FCLayer(0, 2);
+            l2 = new FCLayer(0, 5);
+            net->layers.push_back(l1);
+            net->layers.push_back(l2);
+            l2->prevLayer = l1;
+            l2->netInstance = 0;
+        }
+
+        virtual void TearDown() {
+            delete l1;
+            delete l2;
+            Network::deleteNetwork();
+        }
+
+        Network* net;
+        FCLayer* l1;
+        FCLayer* l2;
+    };
+
+    // Fills the layers' neurons vectors with as many neurons as the layers' sizes
+    TEST_F(InitFixture, init_1) {
+        EXPECT_NE( l2->neurons.size(), 5 );
+        l2->init(1);
+        EXPECT_EQ( l2->neurons.size(), 5 );
+    }
+
+    // Sets the bias of every neuron to 0
+    TEST_F(InitFixture, init_2) {
+        l2->init(1);
+
+        for (int n=0; n<5; n++) {
+            EXPECT_EQ( l2->biases[n], 1 );
+        }
+    }
+
+    // Inits the neurons' weights vector with as many weights as there are neurons in the prev layer. (none in first layer)
+    TEST_F(InitFixture, init_3) {
+        l1->init(0);
+        l2->init(1);
+
+        EXPECT_EQ( l1->weights.size(), 0 );
+
+        for (int n=0; n<5; n++) {
+            EXPECT_EQ( l2->weights[n].size(), 2 );
+        }
+    }
+
+    // Inits the neurons' weights vector with as many weights as there are outgoing values in every filter in a prev Conv layer
+    TEST_F(InitFixture, init_4) {
+
+        ConvLayer* c = new ConvLayer(0, 2);
+        c->outMapSize = 3;
+        c->filters = {};
+        c->filters.push_back(new Filter());
+        c->filters.push_back(new Filter());
+        c->size = 2;
+
+        l2->prevLayer = c;
+        l2->init(1);
+
+        for (int n=0; n<5; n++) {
+            EXPECT_EQ( l2->weights[n].size(), 18 );
+        }
+
+        delete c;
+    }
+
+    // Inits the neurons' weights vector with as many weights as there are outgoing values in a prev Pool layer
+    TEST_F(InitFixture, init_5) {
+
+        PoolLayer* p = new PoolLayer(0, 2);
+        p->outMapSize = 3;
+        std::vector<std::vector<double> > testData = {{1}};
+        p->activations = {testData, testData, testData, testData, testData};
+
+        l2->prevLayer = p;
+        l2->init(1);
+
+        for (int n=0; n<5; n++) {
+            EXPECT_EQ( l2->weights[n].size(), 45 );
+        }
+
+        delete p;
+    }
+
+
+    class FCForwardFixture : public ::testing::Test {
+    public:
+        virtual void SetUp() {
+            Network::deleteNetwork();
+            Network::newNetwork();
+            Network::newNetwork();
+            net = Network::getInstance(1);
+            net->weightInitFn = &NetMath::uniform;
+            l1 = new FCLayer(1, 2);
+            l2 = new FCLayer(1, 5);
+            net->layers.push_back(l1);
+            net->layers.push_back(l2);
+            l2->hasActivation = true;
+            l2->prevLayer = l1;
+            l2->netInstance = 1;
+            l2->softmax = false;
+            l1->init(0);
+            l2->init(1);
+            l2->activation = &NetMath::sigmoid<Neuron>;
+            l1->actvns = {1,2};
+        }
+
+        virtual void TearDown() {
+            delete l1;
+            delete l2;
+            Network::deleteNetwork();
+        }
+
+        Network* net;
+        FCLayer* l1;
+        FCLayer* l2;
+    };
+
+    // SETS the neurons' sum to their bias + weighted activations of last layer's neurons
+    TEST_F(FCForwardFixture, forward_1) {
+
+        for (int n=0; n<3; n++) {
+            l2->weights[n] = {1,2};
+        }
+        l2->biases = {0,1,2,1,1};
+
+        net->isTraining= false;
+        net->dropout = 1;
+
+        l2->forward();
+
+        std::vector<double> expected = {5,6,7,1,1};
+
+        EXPECT_EQ( l2->sums, expected );
+
+        // Check that it SETS it, and doesn't increment it
+        l2->forward();
+
+        EXPECT_FALSE( net->isTraining );
+        EXPECT_EQ( l2->sums, expected );
+    }
+
+    // Sets the layer's neurons' activation to the result of the activation function
+    TEST_F(FCForwardFixture, forward_2) {
+
+        for (int n=0; n<3; n++) {
+            l2->weights[n] = {1,2};
+        }
+        l2->biases = {0,1,2};
+
+        net->isTraining = false;
+        net->dropout = 1;
+        l2->forward();
+
+        EXPECT_FALSE( net->isTraining );
+
+        EXPECT_DOUBLE_EQ( l2->actvns[0], 0.9933071490757153 );
+        EXPECT_DOUBLE_EQ( l2->actvns[1], 0.9975273768433653 );
+        EXPECT_DOUBLE_EQ( l2->actvns[2], 0.9990889488055994 );
+    }
+
+    // Sets the layer's neurons' activation to the sum when there is no activation function
+    TEST_F(FCForwardFixture, forward_3) {
+
+        l2->hasActivation = false;
+
+        for (int n=0; n<3; n++) {
+            l2->weights[n] = {1,2};
+        }
+        l2->biases = {0,1,2};
 
         net->isTraining = false;
         net->dropout = 1;
@@ -1546,107 +3151,401 @@ namespace FCLayer_cpp {
         l2->neurons.push_back(new Neuron());
         l2->neurons.push_back(new Neuron());
 
-        l2->weights = {{1,2}, {1,2}, {1,2}};
-        l2->deltaWeights = {{1,2}, {1,2}, {1,2}};
-        std::vector<std::vector<double> > expected = {{0,0}, {0,0}, {0,0}};
+        l2->weights = {{1,2}, {1,2}, {1,2}};
+        l2->deltaWeights = {{1,2}, {1,2}, {1,2}};
+        std::vector<std::vector<double> > expected = {{0,0}, {0,0}, {0,0}};
+
+        l2->resetDeltaWeights();
+
+        EXPECT_EQ( l2->deltaWeights, expected );
+
+        delete l1;
+        delete l2;
+        Network::deleteNetwork();
+    }
+
+    // Copies the neuron weights to a 'validationWeights' array, for each neuron
+    TEST(FCLayer, backUpValidation_1) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        FCLayer* l1 = new FCLayer(0, 10);
+        FCLayer* l2 = new FCLayer(0, 10);
+        l1->prevLayer = l2;
+        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
+        l1->init(1);
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            EXPECT_EQ( l1->validationWeights.size(), 0 );
+        }
+
+        l1->backUpValidation();
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            EXPECT_EQ( l1->validationWeights[n], l1->weights[n] );
+        }
+    }
+
+    // Copies over the neuron biases into a 'validationBias' value
+    TEST(FCLayer, backUpValidation_2) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        FCLayer* l1 = new FCLayer(0, 10);
+        FCLayer* l2 = new FCLayer(0, 10);
+        l1->prevLayer = l2;
+        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
+        l1->init(1);
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            l1->biases[n] = n;
+            EXPECT_EQ( l1->validationBiases.size(), 0 );
+        }
+
+        l1->backUpValidation();
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            EXPECT_EQ( l1->validationBiases[n], l1->biases[n] );
+        }
+    }
+
+    // Copies backed up 'validationWeights' values into every neuron's weights arrays
+    TEST(FCLayer, restoreValidation_1) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        FCLayer* l1 = new FCLayer(0, 10);
+        FCLayer* l2 = new FCLayer(0, 10);
+        l1->prevLayer = l2;
+        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
+        std::vector<double> expected = {1,2,3};
+        l1->init(1);
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            l1->validationWeights.push_back({1,2,3});
+            l1->validationBiases.push_back(n+5);
+            l1->weights[n] = {0,0,0};
+            EXPECT_NE( l1->weights[n], expected );
+        }
+
+        l1->restoreValidation();
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            EXPECT_EQ( l1->weights[n], expected );
+        }
+    }
+
+    // Copies backed up 'validationBias' values into every neuron's bias values
+    TEST(FCLayer, restoreValidation_2) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        FCLayer* l1 = new FCLayer(0, 10);
+        FCLayer* l2 = new FCLayer(0, 10);
+        l1->prevLayer = l2;
+        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
+        l1->init(1);
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            l1->validationWeights.push_back({1,2,3});
+            l1->validationBiases.push_back(n+5);
+        }
+
+        l1->restoreValidation();
+
+        for (int n=0; n<l1->neurons.size(); n++) {
+            EXPECT_EQ( l1->biases[n], n+5 );
+        }
+    }
+
+    // Copies into the previous back-up's rows, instead of building new ones
+    TEST(FCLayer, backUpValidation_3) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        FCLayer* l1 = new FCLayer(0, 10);
+        FCLayer* l2 = new FCLayer(0, 10);
+        l1->prevLayer = l2;
+        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
+        l1->init(1);
+
+        l1->backUpValidation();
+        double* row = l1->validationWeights[3].data();
+        l1->weights[3][2] = 5;
+        l1->backUpValidation();
+
+        EXPECT_EQ( l1->validationWeights[3].data(), row );
+        EXPECT_EQ( l1->validationWeights[3][2], 5 );
+    }
+
+    // Swaps the back-up in, rather than copying it
+    TEST(FCLayer, restoreValidation_3) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        FCLayer* l1 = new FCLayer(0, 10);
+        FCLayer* l2 = new FCLayer(0, 10);
+        l1->prevLayer = l2;
+        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
+        l1->init(1);
+
+        l1->backUpValidation();
+        std::vector<double> expected = l1->weights[3];
+        double* row = l1->validationWeights[3].data();
+        l1->weights[3][2] = 5;
+        l1->restoreValidation();
+
+        EXPECT_EQ( l1->weights[3], expected );
+        EXPECT_EQ( l1->weights[3].data(), row );
+    }
+
+    class FCPruneFixture : public ::testing::Test {
+    public:
+        virtual void SetUp() {
+            Network::deleteNetwork();
+            Network::newNetwork();
+            net = Network::getInstance(0);
+            net->weightInitFn = &NetMath::uniform;
+            net->weightsConfig["limit"] = 0.1;
+            net->updateFnIndex = 0;
+            net->learningRate = 1;
+            net->miniBatchSize = 1;
+            net->dropout = 1;
+            net->isTraining = false;
+            net->l1 = 0;
+            net->l2 = 0;
+
+            l1 = new FCLayer(0, 4);
+            l2 = new FCLayer(0, 3);
+            l3 = new FCLayer(0, 2);
+            net->layers.push_back(l1);
+            net->layers.push_back(l2);
+            net->layers.push_back(l3);
+            net->joinLayers();
+
+            l2->weights = {{0.5, -0.01, 0.2, 0.001}, {-0.3, 0.02, -0.003, 0.4}, {0.005, -0.6, 0.7, -0.08}};
+            l3->weights = {{0.9, -0.002, 0.3}, {0.004, 0.6, -0.5}};
+            l1->actvns = {0.1, 0.2, 0.3, 0.4};
+        }
+
+        virtual void TearDown() {
+            Network::deleteNetwork();
+        }
+
+        Network* net;
+        FCLayer* l1;
+        FCLayer* l2;
+        FCLayer* l3;
+    };
+
+    // Only keeps the weights with a magnitude of at least the threshold, along with their deltas
+    TEST_F(FCPruneFixture, prune_1) {
+        l2->prune(0.05);
+
+        std::vector<std::vector<double> > expected = {{0.5, 0.2}, {-0.3, 0.4}, {-0.6, 0.7, -0.08}};
+        EXPECT_TRUE( l2->pruned );
+        EXPECT_EQ( l2->denseRowSize, 4 );
+        EXPECT_EQ( l2->weights, expected );
+
+        for (int n=0; n<3; n++) {
+            EXPECT_EQ( l2->deltaWeights[n].size(), expected[n].size() );
+        }
+    }
+
+    // Builds the CSR index of the surviving weights
+    TEST_F(FCPruneFixture, prune_2) {
+        l2->prune(0.05);
+
+        std::vector<int> expectedRowStarts = {0, 2, 4, 7};
+        std::vector<int> expectedColumns = {0, 2, 0, 3, 1, 2, 3};
+        EXPECT_EQ( l2->sparseRowStarts, expectedRowStarts );
+        EXPECT_EQ( l2->sparseColumns, expectedColumns );
+    }
+
+    // Prunes the smallest weights until the given sparsity is reached
+    TEST_F(FCPruneFixture, pruneToSparsity) {
+        l2->pruneToSparsity(0.5);
+
+        std::vector<std::vector<double> > expected = {{0.5, 0.2}, {-0.3, 0.4}, {-0.6, 0.7}};
+        EXPECT_EQ( l2->sparseColumns.size(), 6 );
+        EXPECT_EQ( l2->weights, expected );
+    }
+
+    // Shrinks the optimizer state and validation back-up rows down to the surviving weights, too
+    TEST_F(FCPruneFixture, prune_3) {
+        net->updateFnIndex = 5;
+        l2->backUpValidation();
+
+        for (int n=0; n<3; n++) {
+            l2->neurons[n]->weightsCache = {1, 2, 3, 4};
+            l2->neurons[n]->adadeltaCache = {5, 6, 7, 8};
+        }
+
+        l2->prune(0.05);
+
+        std::vector<double> expectedCache = {2, 3, 4};
+        std::vector<double> expectedAdadelta = {6, 7, 8};
+        std::vector<std::vector<double> > expectedBackUp = {{0.5, 0.2}, {-0.3, 0.4}, {-0.6, 0.7, -0.08}};
+        EXPECT_EQ( l2->neurons[2]->weightsCache, expectedCache );
+        EXPECT_EQ( l2->neurons[2]->adadeltaCache, expectedAdadelta );
+        EXPECT_EQ( l2->validationWeights, expectedBackUp );
+        EXPECT_EQ( l2->neurons[0]->weightsCache.size(), 2 );
+    }
+
+    // Pruning a pruned layer starts over from its full rows, where the previously pruned weights are 0
+    TEST_F(FCPruneFixture, prune_4) {
+        l2->prune(0.05);
+        l2->prune(0.45);
+
+        std::vector<std::vector<double> > expected = {{0.5}, {}, {-0.6, 0.7}};
+        std::vector<int> expectedColumns = {0, 1, 2};
+        EXPECT_EQ( l2->weights, expected );
+        EXPECT_EQ( l2->sparseColumns, expectedColumns );
+        EXPECT_EQ( l2->denseRowSize, 4 );
+    }
+
+    // Scatters the rows back out to their full width, with the pruned weights at 0, and clears the sparse structure
+    TEST_F(FCPruneFixture, densify) {
+        net->updateFnIndex = 1;
+
+        for (int n=0; n<3; n++) {
+            l2->neurons[n]->weightGain = {2, 3, 4, 5};
+        }
+
+        l2->prune(0.05);
+        l2->densify();
+
+        std::vector<std::vector<double> > expected = {{0.5, 0, 0.2, 0}, {-0.3, 0, 0, 0.4}, {0, -0.6, 0.7, -0.08}};
+        std::vector<double> expectedGain = {2, 1, 4, 1};
+        EXPECT_FALSE( l2->pruned );
+        EXPECT_EQ( l2->weights, expected );
+        EXPECT_EQ( l2->neurons[0]->weightGain, expectedGain );
+        EXPECT_TRUE( l2->sparseColumns.empty() );
+        EXPECT_TRUE( l2->sparseRowStarts.empty() );
 
-        l2->resetDeltaWeights();
+        for (int n=0; n<3; n++) {
+            EXPECT_EQ( l2->deltaWeights[n].size(), 4 );
+        }
+    }
 
-        EXPECT_EQ( l2->deltaWeights, expected );
+    // Restoring a back-up from before pruning still leaves only the surviving weights
+    TEST_F(FCPruneFixture, restoreValidation) {
+        l2->backUpValidation();
+        l2->prune(0.05);
+        l2->weights[0][0] = 1;
+        l2->restoreValidation();
 
-        delete l1;
-        delete l2;
-        Network::deleteNetwork();
+        std::vector<std::vector<double> > expected = {{0.5, 0.2}, {-0.3, 0.4}, {-0.6, 0.7, -0.08}};
+        EXPECT_EQ( l2->weights, expected );
     }
 
-    // Copies the neuron weights to a 'validationWeights' array, for each neuron
-    TEST(FCLayer, backUpValidation_1) {
-        Network::deleteNetwork();
-        Network::newNetwork();
-        FCLayer* l1 = new FCLayer(0, 10);
-        FCLayer* l2 = new FCLayer(0, 10);
-        l1->prevLayer = l2;
-        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
-        l1->init(1);
+    // The sparse forward pass matches the dense one, for the same (pruned) weights
+    TEST_F(FCPruneFixture, forward) {
+        l2->prune(0.05);
+        l2->forward();
+        std::vector<double> sparseSums = l2->sums;
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            EXPECT_EQ( l1->validationWeights.size(), 0 );
+        l2->densify();
+        l2->forward();
+
+        for (int n=0; n<3; n++) {
+            EXPECT_NEAR( sparseSums[n], l2->sums[n], 1e-12 );
         }
+    }
 
-        l1->backUpValidation();
+    // The previous layer's errors are computed the same way through a pruned next layer
+    TEST_F(FCPruneFixture, backward) {
+        l3->prune(0.05);
+        l2->forward();
+        l3->forward();
+        l3->errs = {0.5, -0.25};
+        l2->backward(false);
+        std::vector<double> sparseErrs = l2->errs;
+        std::vector<std::vector<double> > sparseDeltaWeights = l2->deltaWeights;
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            EXPECT_EQ( l1->validationWeights[n], l1->weights[n] );
+        l3->densify();
+        l2->resetDeltaWeights();
+        l2->backward(false);
+
+        for (int n=0; n<3; n++) {
+            EXPECT_NEAR( sparseErrs[n], l2->errs[n], 1e-12 );
+            for (int w=0; w<4; w++) {
+                EXPECT_NEAR( sparseDeltaWeights[n][w], l2->deltaWeights[n][w], 1e-12 );
+            }
         }
     }
 
-    // Copies over the neuron biases into a 'validationBias' value
-    TEST(FCLayer, backUpValidation_2) {
-        Network::deleteNetwork();
-        Network::newNetwork();
-        FCLayer* l1 = new FCLayer(0, 10);
-        FCLayer* l2 = new FCLayer(0, 10);
-        l1->prevLayer = l2;
-        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
-        l1->init(1);
+    // Pruned weights stay at 0 through weight updates, even with regularization
+    TEST_F(FCPruneFixture, applyDeltaWeights) {
+        net->l1 = 0.005;
+        net->l2 = 0.001;
+        l2->prune(0.05);
+        l2->deltaWeights = {{1, 1}, {1, 1}, {1, 1, 1}};
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            l1->biases[n] = n;
-            EXPECT_EQ( l1->validationBiases.size(), 0 );
-        }
+        l2->applyDeltaWeights();
+        l2->densify();
 
-        l1->backUpValidation();
+        EXPECT_EQ( l2->weights[0][1], 0 );
+        EXPECT_EQ( l2->weights[0][3], 0 );
+        EXPECT_EQ( l2->weights[1][2], 0 );
+        EXPECT_EQ( l2->weights[2][0], 0 );
+        EXPECT_NE( l2->weights[0][0], 0.5 );
+    }
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            EXPECT_EQ( l1->validationBiases[n], l1->biases[n] );
-        }
+    // Network.prune prunes every FC layer to the given sparsity, or by the given threshold
+    TEST_F(FCPruneFixture, Network_prune) {
+        net->prune(0, 0.5);
+        EXPECT_EQ( l2->sparseColumns.size(), 6 );
+        EXPECT_EQ( l3->sparseColumns.size(), 3 );
+        EXPECT_FALSE( l1->pruned );
+
+        net->prune(0.45, 0);
+        EXPECT_EQ( l2->sparseColumns.size(), 3 );
+
+        net->densify();
+        EXPECT_FALSE( l2->pruned );
+        EXPECT_FALSE( l3->pruned );
+        EXPECT_EQ( l2->weights[1].size(), 4 );
     }
 
-    // Copies backed up 'validationWeights' values into every neuron's weights arrays
-    TEST(FCLayer, restoreValidation_1) {
-        Network::deleteNetwork();
-        Network::newNetwork();
-        FCLayer* l1 = new FCLayer(0, 10);
-        FCLayer* l2 = new FCLayer(0, 10);
-        l1->prevLayer = l2;
-        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
-        std::vector<double> expected = {1,2,3};
-        l1->init(1);
+    // Pruned layers export full width rows, and masks of the weights they kept
+    TEST_F(FCPruneFixture, exportParameters) {
+        l2->prune(0.05);
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            l1->validationWeights.push_back({1,2,3});
-            l1->validationBiases.push_back(n+5);
-            l1->weights[n] = {0,0,0};
-            EXPECT_NE( l1->weights[n], expected );
-        }
+        std::vector<int> layout = net->parametersLayout();
+        std::vector<int> expectedLayout = {0,0,0,0,0, 0,3,12,0,12, 27,2,6,0,6};
+        EXPECT_EQ( layout, expectedLayout );
 
-        l1->restoreValidation();
+        std::vector<double> values(41);
+        net->exportParameters(values.data());
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            EXPECT_EQ( l1->weights[n], expected );
-        }
+        std::vector<double> expectedRow = {0, -0.6, 0.7, -0.08};
+        std::vector<double> expectedMask = {1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 1, 1};
+        EXPECT_EQ( std::vector<double>(values.begin()+3+8, values.begin()+3+12), expectedRow );
+        EXPECT_EQ( std::vector<double>(values.begin()+15, values.begin()+27), expectedMask );
+        EXPECT_EQ( std::vector<double>(values.begin()+35, values.begin()+41), std::vector<double>(6, 1) );
     }
 
-    // Copies backed up 'validationBias' values into every neuron's bias values
-    TEST(FCLayer, restoreValidation_2) {
-        Network::deleteNetwork();
-        Network::newNetwork();
-        FCLayer* l1 = new FCLayer(0, 10);
-        FCLayer* l2 = new FCLayer(0, 10);
-        l1->prevLayer = l2;
-        Network::getInstance(0)->weightInitFn = &NetMath::uniform;
-        l1->init(1);
+    // Imported masks prune the layers directly, keeping the kept weights which are exactly 0
+    TEST_F(FCPruneFixture, importParameters) {
+        l2->prune(0.05);
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            l1->validationWeights.push_back({1,2,3});
-            l1->validationBiases.push_back(n+5);
-        }
+        std::vector<double> values(41);
+        net->exportParameters(values.data());
 
-        l1->restoreValidation();
+        values[3] = 0.25;
+        values[15+1] = 1;
+        values[15+2] = 0;
+        net->importParameters(values.data());
 
-        for (int n=0; n<l1->neurons.size(); n++) {
-            EXPECT_EQ( l1->biases[n], n+5 );
-        }
+        std::vector<double> expected = {0.25, 0};
+        std::vector<int> expectedColumns = {0, 1, 0, 3, 1, 2, 3};
+        EXPECT_TRUE( l2->pruned );
+        EXPECT_EQ( l2->weights[0], expected );
+        EXPECT_EQ( l2->sparseColumns, expectedColumns );
+        EXPECT_EQ( l2->deltaWeights[0].size(), 2 );
+        EXPECT_FALSE( l3->pruned );
+
+        // Masks with nothing pruned leave layers dense
+        std::fill(values.begin()+15, values.begin()+27, 1);
+        net->importParameters(values.data());
+
+        EXPECT_FALSE( l2->pruned );
+        EXPECT_EQ( l2->weights[0].size(), 4 );
     }
 }
 
@@ -1921,6 +3820,58 @@ namespace ConvLayer_cpp {
         }
     }
 
+    // Computes the same sum maps as NetUtil::convolve through the Winograd path, caching the filter transforms
+    TEST_F(ConvForwardFixture, forward_8) {
+
+        for (int n=0; n<75; n++) {
+            prevLayer->actvns[n] = (double) rand() / (RAND_MAX);
+        }
+
+        net->dropout = 1;
+        layer->forward();
+
+        EXPECT_FALSE( layer->winogradStale );
+        EXPECT_EQ( layer->winogradTile, 2 );
+
+        std::vector<std::vector<std::vector<double> > > input = NetUtil::arrayToVolume(prevLayer->actvns, 3);
+
+        for (int f=0; f<layer->filters.size(); f++) {
+            std::vector<std::vector<double> > expected = NetUtil::convolve(input, 1, layer->filterWeights[f], 3, 1, layer->biases[f]);
+
+            for (int r=0; r<5; r++) {
+                for (int c=0; c<5; c++) {
+                    EXPECT_NEAR( layer->filters[f]->sumMap[r][c], expected[r][c], 1e-12 );
+                }
+            }
+        }
+    }
+
+    // Computes the same sum maps as NetUtil::convolve through the FFT path
+    TEST_F(ConvForwardFixture, forward_9) {
+
+        for (int n=0; n<75; n++) {
+            prevLayer->actvns[n] = (double) rand() / (RAND_MAX);
+        }
+
+        net->dropout = 1;
+        layer->convAlgorithm = 2;
+        layer->forward();
+
+        EXPECT_FALSE( layer->fftStale );
+
+        std::vector<std::vector<std::vector<double> > > input = NetUtil::arrayToVolume(prevLayer->actvns, 3);
+
+        for (int f=0; f<layer->filters.size(); f++) {
+            std::vector<std::vector<double> > expected = NetUtil::convolve(input, 1, layer->filterWeights[f], 3, 1, layer->biases[f]);
+
+            for (int r=0; r<5; r++) {
+                for (int c=0; c<5; c++) {
+                    EXPECT_NEAR( layer->filters[f]->sumMap[r][c], expected[r][c], 1e-12 );
+                }
+            }
+        }
+    }
+
     class ConvBackwardFixture : public ::testing::Test {
     public:
         virtual void SetUp () {
@@ -2050,6 +4001,59 @@ namespace ConvLayer_cpp {
         }
     }
 
+    // Creates the error maps through only the surviving weights of a pruned next FCLayer
+    TEST(ConvLayer, backward_1_pruned) {
+
+        Network::deleteNetwork();
+        Network::newNetwork();
+        Network* net = Network::getInstance(0);
+        net->weightInitFn = &NetMath::uniform;
+        net->weightsConfig["limit"] = 0.1;
+
+        FCLayer* fcLayer = new FCLayer(0, 4);
+        FCLayer* fcLayerPrev = new FCLayer(0, 18);
+        ConvLayer* convLayer = new ConvLayer(0, 2);
+        convLayer->channels = 1;
+        convLayer->filterSize = 3;
+        convLayer->stride = 1;
+        convLayer->zeroPadding = 0;
+        convLayer->outMapSize = 2;
+        convLayer->inMapValuesCount = 4;
+
+        convLayer->assignPrev(fcLayerPrev);
+        convLayer->assignNext(fcLayer);
+        fcLayer->assignPrev(convLayer);
+        convLayer->hasActivation = false;
+
+        fcLayerPrev->init(0);
+        convLayer->init(1);
+        fcLayer->init(2);
+
+        fcLayer->errs = {};
+        for (int n=0; n<fcLayer->neurons.size(); n++) {
+            fcLayer->errs.push_back(((double)n+1)/5);
+            fcLayer->weights[n] = {0.9,0.8,0.7,0.6,0.5,0.4,0.3,0.2};
+        }
+        fcLayer->prune(0.35);
+
+        convLayer->filters[0]->sumMap = {{0,0},{0,0}};
+        convLayer->filters[1]->sumMap = {{0,0},{0,0}};
+        convLayer->errors = {{{0,0},{0,0}}, {{0,0},{0,0}}};
+        convLayer->activations = { {{0.1,0.2},{0.3,0.4}}, {{0.5,0.6},{0.7,0.8}} };
+
+        std::vector<std::vector<std::vector<double> > > expected = { {{1.8, 1.6}, {1.4, 1.2}}, {{1, 0.8}, {0, 0}} };
+
+        convLayer->backward(false);
+
+        for (int f=0; f<convLayer->filters.size(); f++) {
+            for (int r=0; r<2; r++) {
+                for (int c=0; c<2; c++) {
+                    EXPECT_NEAR( convLayer->errors[f][r][c], expected[f][r][c], 1e-8 );
+                }
+            }
+        }
+    }
+
     // Sets the errors values to 0 when dropped out
     TEST_F(ConvBackwardFixture, backward_2) {
 
@@ -2594,6 +4598,47 @@ namespace ConvLayer_cpp {
 
         delete conv;
     }
+
+    // Swaps the back-up in, rather than copying it
+    TEST(ConvLayer, restoreValidation_3) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        ConvLayer* conv = new ConvLayer(0, 5);
+        conv->filterWeights = {{{{1,2},{1,2}}}};
+        conv->biases = {1};
+
+        conv->backUpValidation();
+        double* row = conv->validationFilterWeights[0][0][1].data();
+        conv->filterWeights[0][0][1][0] = 5;
+        conv->biases[0] = 5;
+        conv->restoreValidation();
+
+        EXPECT_EQ( conv->filterWeights[0][0][1][0], 1 );
+        EXPECT_EQ( conv->filterWeights[0][0][1].data(), row );
+        EXPECT_EQ( conv->biases[0], 1 );
+
+        delete conv;
+    }
+
+    // Marks the cached Winograd filter transforms as stale, when the weights change
+    TEST(ConvLayer, restoreValidation_2) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        ConvLayer* conv = new ConvLayer(0, 5);
+
+        conv->winogradStale = false;
+        conv->winogradErrorStale = false;
+        conv->fftStale = false;
+        conv->validationFilterWeights = {{{{1,2,3},{1,2,3},{1,2,3}}}};
+
+        conv->restoreValidation();
+
+        EXPECT_TRUE( conv->winogradStale );
+        EXPECT_TRUE( conv->winogradErrorStale );
+        EXPECT_TRUE( conv->fftStale );
+
+        delete conv;
+    }
 }
 
 namespace PoolLayer_cpp {
@@ -2872,6 +4917,49 @@ namespace PoolLayer_cpp {
         }
     }
 
+    // Creates the same error map through only the surviving weights of a pruned next FCLayer
+    TEST_F(PoolBackwardFixture, backward_1_pruned) {
+
+        PoolLayer* layer = new PoolLayer(0, 2);
+        layer->stride = 2;
+        layer->channels = 1;
+        layer->outMapSize = 6;
+        layer->inMapValuesCount = 36;
+        layer->hasActivation = false;
+
+        layer->assignNext(fcLayer);
+        fcLayer->assignPrev(layer);
+        layer->init(0);
+        fcLayer->init(1);
+
+        layer->errors = NetUtil::createVolume<double>(1, 12, 12, 0);
+        layer->indeces = std::vector<std::vector<std::vector<std::vector<int> > > >(1,
+            std::vector<std::vector<std::vector<int> > >(6, std::vector<std::vector<int> >(6, {1,0})));
+
+        fcLayer->errs = {};
+
+        for (double n=0; n<fcLayer->size; n++) {
+            fcLayer->errs.push_back(n / 100);
+            fcLayer->weights[n] = {0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5};
+        }
+
+        layer->backward();
+        std::vector<std::vector<std::vector<double> > > denseErrors = layer->errors;
+
+        fcLayer->prune(0.5);
+        layer->errors = NetUtil::createVolume<double>(1, 12, 12, 0);
+        layer->backward();
+
+        EXPECT_EQ( fcLayer->weights[0].size(), 32 );
+
+        for (int i=0; i<12; i++) {
+            for (int j=0; j<12; j++) {
+                EXPECT_DOUBLE_EQ( layer->errors[0][i][j], denseErrors[0][i][j] );
+            }
+        }
+        delete layer;
+    }
+
     // Creates the error map correctly when the next layer is a ConvLayer
     TEST_F(PoolBackwardFixture, backward_2) {
 
@@ -3613,6 +5701,14 @@ namespace NetMath_cpp {
         EXPECT_EQ( NetMath::crossentropy(values1, values2), (double)70.16654147569186 );
     }
 
+    // Class index versions match the one-hot versions
+    TEST(NetMath, labelCostFunctions) {
+        std::vector<double> output = {0.1, 0.7, 0.2};
+        std::vector<double> oneHot = {0, 1, 0};
+        EXPECT_DOUBLE_EQ( NetMath::meansquarederror(1, output), NetMath::meansquarederror(output, oneHot) );
+        EXPECT_DOUBLE_EQ( NetMath::crossentropy(1, output), NetMath::crossentropy(oneHot, output) );
+    }
+
     TEST(NetMath, vanillasgd) {
         Network::deleteNetwork();
         Network::newNetwork();
@@ -4562,10 +6658,65 @@ namespace NetMath_cpp {
         EXPECT_EQ( NetMath::softmax(values), expected );
     }
 
-    TEST(NetMath, softmax_2) {
-        std::vector<double> values = {23, 54, 167, 3};
-        std::vector<double> expected = {2.8946403116483003e-63, 8.408597124803643e-50, 1, 5.96629836401057e-72};
-        EXPECT_EQ( NetMath::softmax(values), expected );
+    TEST(NetMath, softmax_2) {
+        std::vector<double> values = {23, 54, 167, 3};
+        std::vector<double> expected = {2.8946403116483003e-63, 8.408597124803643e-50, 1, 5.96629836401057e-72};
+        EXPECT_EQ( NetMath::softmax(values), expected );
+    }
+
+    // Gives the same result as a plain loop, including for lengths not divisible by 4
+    TEST(NetMath, dot) {
+        std::vector<double> a = {1,2,3,4,5,6,7};
+        std::vector<double> b = {7,6,5,4,3,2,1};
+
+        EXPECT_EQ( NetMath::dot(a.data(), b.data(), 7), 84 );
+        EXPECT_EQ( NetMath::dot(a.data(), b.data(), 3), 34 );
+        EXPECT_EQ( NetMath::dot(a.data(), b.data(), 0), 0 );
+    }
+
+    // Adds the scaled values to the existing ones
+    TEST(NetMath, axpy) {
+        std::vector<double> x = {1,2,3,4,5};
+        std::vector<double> y = {1,1,1,1,1};
+        std::vector<double> expected = {3,5,7,9,11};
+
+        NetMath::axpy(2, x.data(), y.data(), 5);
+        EXPECT_EQ( y, expected );
+    }
+
+    // Adds the element-wise products to the existing values
+    TEST(NetMath, multiplyAccumulate) {
+        std::vector<double> a = {1,2,3};
+        std::vector<double> b = {4,5,6};
+        std::vector<double> out = {1,1,1};
+        std::vector<double> expected = {5,11,19};
+
+        NetMath::multiplyAccumulate(a.data(), b.data(), out.data(), 3);
+        EXPECT_EQ( out, expected );
+    }
+
+    // Updates the weights the same way as NetMath::vanillasgd, with regularization, returning the sum of their squares
+    TEST(NetMath, sgdUpdate) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        Network::getInstance(0)->learningRate = 0.5;
+
+        std::vector<double> weights = {0.5, -0.25, 1};
+        std::vector<double> deltas = {1, 2, -1};
+        std::vector<double> expected;
+        double squares = 0;
+
+        for (int w=0; w<3; w++) {
+            double regularized = (deltas[w] + 0.1 * weights[w] + 0.01 * (weights[w] > 0 ? 1 : -1)) / 2;
+            expected.push_back(NetMath::vanillasgd(0, weights[w], regularized));
+            squares += expected[w] * expected[w];
+        }
+
+        EXPECT_DOUBLE_EQ( NetMath::sgdUpdate(weights.data(), deltas.data(), 3, 0.5, 0.1, 0.01, 2), squares );
+
+        for (int w=0; w<3; w++) {
+            EXPECT_DOUBLE_EQ( weights[w], expected[w] );
+        }
     }
 }
 
@@ -4574,71 +6725,48 @@ namespace NetUtil_cpp {
     class ShuffleFixture : public ::testing::Test {
     public:
         virtual void SetUp() {
-            std::tuple<std::vector<double>, std::vector<double> > a;
-            std::tuple<std::vector<double>, std::vector<double> > b;
-            std::tuple<std::vector<double>, std::vector<double> > c;
-
-            std::get<0>(a) = {1,2,3};
-            std::get<1>(a) = {4,5,6};
-            values.push_back(a);
-
-            std::get<0>(b) = {7,8,9};
-            std::get<1>(b) = {10,11,12};
-            values.push_back(b);
-
-            std::get<0>(c) = {13,14,15};
-            std::get<1>(c) = {16,17,18};
-            values.push_back(c);
-
+            values = {0,1,2,3,4,5,6,7,8,9};
             original = values;
+            rng.seed(123);
         }
 
-        std::vector<std::tuple<std::vector<double>, std::vector<double> > > values;
-        std::vector<std::tuple<std::vector<double>, std::vector<double> > > original;
+        std::vector<int> values;
+        std::vector<int> original;
+        std::mt19937 rng;
     };
 
     // Keeps the same number of elements
     TEST_F(ShuffleFixture, shuffle_1) {
-        NetUtil::shuffle(values);
-        EXPECT_EQ( values.size(), 3 );
+        NetUtil::shuffle(values, rng);
+        EXPECT_EQ( values.size(), 10 );
     }
 
     // Changes the order of the elements
     TEST_F(ShuffleFixture, shuffle_2) {
-        NetUtil::shuffle(values);
+        NetUtil::shuffle(values, rng);
         EXPECT_NE(values, original);
     }
 
-    // Still contains all original values
+    // Still contains all original values, and no new ones
     TEST_F(ShuffleFixture, shuffle_3) {
-
-        NetUtil::shuffle(values);
-
-        for (int i=0; i<3; i++) {
-            bool ok = false;
-
-            for (int j=0; j<3; j++) {
-
-                if (values[i] == original[j]) {
-                    ok = true;
-                }
-            }
-
-            EXPECT_TRUE(ok);
-        }
+        NetUtil::shuffle(values, rng);
+        std::sort(values.begin(), values.end());
+        EXPECT_EQ( values, original );
     }
 
-    // Contains no new values
+    // The same seed gives the same order
     TEST_F(ShuffleFixture, shuffle_4) {
+        std::vector<int> other = original;
+        std::mt19937 otherRNG(123);
 
-        NetUtil::shuffle(values);
-
-        for (int i=0; i<3; i++) {
-
-            bool bad = values[i] != original[0] && values[i] != original[1] && values[i] != original[2];
+        NetUtil::shuffle(values, rng);
+        NetUtil::shuffle(other, otherRNG);
+        EXPECT_EQ( values, other );
 
-            EXPECT_FALSE( bad );
-        }
+        otherRNG.seed(321);
+        other = original;
+        NetUtil::shuffle(other, otherRNG);
+        EXPECT_NE( values, other );
     }
 
 
@@ -4780,6 +6908,419 @@ namespace NetUtil_cpp {
         EXPECT_EQ( res, expected2 );
     }
 
+    // Uses F(2x2, 3x3) for small output maps, and F(4x4, 3x3) for larger ones
+    TEST(NetUtil, winogradTileSize) {
+        EXPECT_EQ( NetUtil::winogradTileSize(5), 2 );
+        EXPECT_EQ( NetUtil::winogradTileSize(7), 2 );
+        EXPECT_EQ( NetUtil::winogradTileSize(8), 4 );
+        EXPECT_EQ( NetUtil::winogradTileSize(28), 4 );
+    }
+
+    // Gives the same results as NetUtil::convolve, using F(2x2, 3x3), with an output size not divisible by the tile size
+    TEST(NetUtil, winogradConvolve_1) {
+        std::vector<std::vector<std::vector<double> > > input = NetUtil::createVolume<double>(3, 7, 7, 0);
+        std::vector<std::vector<std::vector<std::vector<double> > > > weights = {NetUtil::createVolume<double>(3, 3, 3, 0), NetUtil::createVolume<double>(3, 3, 3, 0)};
+
+        for (int c=0; c<3; c++) {
+            for (int r=0; r<7; r++) {
+                for (int v=0; v<7; v++) {
+                    input[c][r][v] = (double) rand() / (RAND_MAX) - 0.5;
+                }
+            }
+            for (int f=0; f<2; f++) {
+                for (int r=0; r<3; r++) {
+                    for (int v=0; v<3; v++) {
+                        weights[f][c][r][v] = (double) rand() / (RAND_MAX) - 0.5;
+                    }
+                }
+            }
+        }
+
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::winogradConvolve(input, 1, NetUtil::winogradFilters(weights, 2, false), 2, 2);
+
+        EXPECT_EQ( res.size(), 2 );
+        EXPECT_EQ( res[0].size(), 7 );
+
+        for (int f=0; f<2; f++) {
+            std::vector<std::vector<double> > expected = NetUtil::convolve(input, 1, weights[f], 3, 1, 0);
+
+            for (int r=0; r<7; r++) {
+                for (int v=0; v<7; v++) {
+                    EXPECT_NEAR( res[f][r][v], expected[r][v], 1e-12 );
+                }
+            }
+        }
+    }
+
+    // Gives the same results as NetUtil::convolve, using F(4x4, 3x3), with different zero padding
+    TEST(NetUtil, winogradConvolve_2) {
+        std::vector<std::vector<std::vector<double> > > input = NetUtil::createVolume<double>(2, 10, 10, 0);
+        std::vector<std::vector<std::vector<std::vector<double> > > > weights = {NetUtil::createVolume<double>(2, 3, 3, 0)};
+
+        for (int c=0; c<2; c++) {
+            for (int r=0; r<10; r++) {
+                for (int v=0; v<10; v++) {
+                    input[c][r][v] = (double) rand() / (RAND_MAX) - 0.5;
+                }
+            }
+            for (int r=0; r<3; r++) {
+                for (int v=0; v<3; v++) {
+                    weights[0][c][r][v] = (double) rand() / (RAND_MAX) - 0.5;
+                }
+            }
+        }
+
+        for (int zP=0; zP<=2; zP++) {
+            std::vector<std::vector<std::vector<double> > > res = NetUtil::winogradConvolve(input, zP, NetUtil::winogradFilters(weights, 4, false), 1, 4);
+            std::vector<std::vector<double> > expected = NetUtil::convolve(input, zP, weights[0], 2, 1, 0);
+
+            EXPECT_EQ( res[0].size(), expected.size() );
+
+            for (int r=0; r<expected.size(); r++) {
+                for (int v=0; v<expected.size(); v++) {
+                    EXPECT_NEAR( res[0][r][v], expected[r][v], 1e-12 );
+                }
+            }
+        }
+    }
+
+    // Lays the rotated filter transforms out by channel first, then by filter
+    TEST(NetUtil, winogradFilters) {
+        std::vector<std::vector<std::vector<std::vector<double> > > > weights = {
+            {{{1,2,3},{4,5,6},{7,8,9}}, {{0,0,0},{0,0,0},{0,0,0}}},
+            {{{0,0,0},{0,0,0},{0,0,0}}, {{0,0,0},{0,0,0},{0,0,0}}}
+        };
+        std::vector<std::vector<std::vector<std::vector<double> > > > rotated = {
+            {{{9,8,7},{6,5,4},{3,2,1}}}
+        };
+
+        std::vector<double> forward = NetUtil::winogradFilters(weights, 2, false);
+        std::vector<double> backward = NetUtil::winogradFilters(weights, 2, true);
+        std::vector<double> expected = NetUtil::winogradFilters(rotated, 2, false);
+
+        EXPECT_EQ( forward.size(), 4*16 );
+        EXPECT_EQ( backward.size(), 4*16 );
+        EXPECT_NE( forward[0], 0 );
+        EXPECT_EQ( forward[16], 0 );
+
+        for (int k=0; k<16; k++) {
+            EXPECT_EQ( backward[k], expected[k] );
+            EXPECT_EQ( backward[16+k], 0 );
+        }
+    }
+
+    // Picks Winograd for small 3x3 layers, FFT for large filters on large maps, and the direct path otherwise
+    TEST(NetUtil, pickConvAlgorithm) {
+        EXPECT_EQ( NetUtil::pickConvAlgorithm(4, 3, 3, 1, 1, 28), 1 );
+        EXPECT_EQ( NetUtil::pickConvAlgorithm(16, 16, 11, 1, 5, 64), 2 );
+        EXPECT_EQ( NetUtil::pickConvAlgorithm(4, 3, 3, 2, 1, 28), 0 );
+        EXPECT_EQ( NetUtil::pickConvAlgorithm(2, 4, 5, 1, 1, 5), 0 );
+    }
+
+    // Stores the picked algorithm in the layer, and falls back to the direct path for unsupported, explicitly set ones
+    TEST(NetUtil, getConvAlgorithm) {
+        Network::deleteNetwork();
+        Network::newNetwork();
+        ConvLayer* conv = new ConvLayer(0, 1);
+        conv->filterSize = 3;
+        conv->stride = 1;
+        conv->zeroPadding = 1;
+        conv->filterWeights = {NetUtil::createVolume<double>(3, 3, 3, 0)};
+
+        EXPECT_EQ( NetUtil::getConvAlgorithm(conv, 28), 1 );
+        EXPECT_EQ( conv->convAlgorithm, 1 );
+
+        conv->stride = 2;
+        EXPECT_EQ( NetUtil::getConvAlgorithm(conv, 28), 0 );
+
+        conv->convAlgorithm = 2;
+        EXPECT_EQ( NetUtil::getConvAlgorithm(conv, 28), 0 );
+
+        conv->stride = 1;
+        EXPECT_EQ( NetUtil::getConvAlgorithm(conv, 28), 2 );
+
+        delete conv;
+    }
+
+    // Transforms to the frequency domain and back
+    TEST(NetUtil, fft2D) {
+        std::vector<std::complex<double> > values(8*8);
+
+        for (int i=0; i<64; i++) {
+            values[i] = (double) rand() / (RAND_MAX);
+        }
+
+        std::vector<std::complex<double> > original = values;
+        double sum = 0;
+
+        for (int i=0; i<64; i++) {
+            sum += original[i].real();
+        }
+
+        NetUtil::fft2D(values, 8, false);
+        EXPECT_NEAR( values[0].real(), sum, 1e-12 );
+
+        NetUtil::fft2D(values, 8, true);
+
+        for (int i=0; i<64; i++) {
+            EXPECT_NEAR( values[i].real(), original[i].real(), 1e-12 );
+            EXPECT_NEAR( values[i].imag(), 0, 1e-12 );
+        }
+    }
+
+    class FFTConvFixture : public ::testing::Test {
+    public:
+        virtual void SetUp() {
+            Network::deleteNetwork();
+            Network::newNetwork();
+            net = Network::getInstance(0);
+            net->weightInitFn = &NetMath::uniform;
+            net->weightsConfig["limit"] = 0.5;
+
+            prevLayer = new FCLayer(0, 2*12*12);
+            prevLayer->init(0);
+
+            layer = new ConvLayer(0, 3);
+            layer->channels = 2;
+            layer->filterSize = 7;
+            layer->zeroPadding = 3;
+            layer->stride = 1;
+            layer->outMapSize = 12;
+            layer->inMapValuesCount = 144;
+            layer->hasActivation = false;
+            layer->assignPrev(prevLayer);
+            layer->init(1);
+
+            for (int n=0; n<prevLayer->actvns.size(); n++) {
+                prevLayer->actvns[n] = (double) rand() / (RAND_MAX) - 0.5;
+            }
+
+            for (int f=0; f<3; f++) {
+                for (int r=0; r<12; r++) {
+                    for (int c=0; c<12; c++) {
+                        layer->errors[f][r][c] = (double) rand() / (RAND_MAX) - 0.5;
+                    }
+                }
+            }
+        }
+
+        virtual void TearDown() {
+            delete prevLayer;
+            delete layer;
+            Network::deleteNetwork();
+        }
+
+        Network* net;
+        FCLayer* prevLayer;
+        ConvLayer* layer;
+    };
+
+    // Gives the same sum maps as NetUtil::convolve, caching the filter spectra
+    TEST_F(FFTConvFixture, fftConvolve) {
+        std::vector<std::vector<std::vector<double> > > input = NetUtil::arrayToVolume(prevLayer->actvns, 2);
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::fftConvolve(input, layer);
+
+        EXPECT_FALSE( layer->fftStale );
+        EXPECT_EQ( layer->fftSize, 32 );
+        EXPECT_EQ( layer->fftWeights.size(), 6 );
+
+        for (int f=0; f<3; f++) {
+            std::vector<std::vector<double> > expected = NetUtil::convolve(input, 3, layer->filterWeights[f], 2, 1, 0);
+
+            EXPECT_EQ( res[f].size(), 12 );
+
+            for (int r=0; r<12; r++) {
+                for (int c=0; c<12; c++) {
+                    EXPECT_NEAR( res[f][r][c], expected[r][c], 1e-10 );
+                }
+            }
+        }
+    }
+
+    // Gives the same error maps as buildConvErrorMap
+    TEST_F(FFTConvFixture, fftConvErrorMaps) {
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::fftConvErrorMaps(12, layer, 2);
+
+        for (int c=0; c<2; c++) {
+            std::vector<std::vector<double> > expected = NetUtil::buildConvErrorMap(12+6, layer, c);
+
+            for (int r=0; r<12; r++) {
+                for (int v=0; v<12; v++) {
+                    EXPECT_NEAR( res[c][r][v], expected[r][v], 1e-10 );
+                }
+            }
+        }
+    }
+
+    // Gives the same error maps as buildConvErrorMap, through im2col + GEMM
+    TEST_F(FFTConvFixture, gemmConvErrorMaps) {
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::gemmConvErrorMaps(12, layer, 2);
+
+        for (int c=0; c<2; c++) {
+            std::vector<std::vector<double> > expected = NetUtil::buildConvErrorMap(12+6, layer, c);
+
+            for (int r=0; r<12; r++) {
+                for (int v=0; v<12; v++) {
+                    EXPECT_NEAR( res[c][r][v], expected[r][v], 1e-10 );
+                }
+            }
+        }
+    }
+
+    // Gives the same delta weights and delta biases as the direct path, through im2col + GEMM
+    TEST_F(FFTConvFixture, gemmConvDWeights) {
+        layer->convAlgorithm = 0;
+        NetUtil::buildConvDWeights(layer);
+
+        std::vector<std::vector<std::vector<std::vector<double> > > > expected = layer->filterDeltaWeights;
+        std::vector<double> expectedBiases = layer->deltaBiases;
+
+        layer->filterDeltaWeights = {};
+        layer->deltaBiases = {0,0,0};
+
+        for (int f=0; f<3; f++) {
+            layer->filterDeltaWeights.push_back(NetUtil::createVolume<double>(2, 7, 7, 0));
+        }
+
+        layer->convAlgorithm = 3;
+        NetUtil::buildConvDWeights(layer);
+
+        for (int f=0; f<3; f++) {
+            EXPECT_NEAR( layer->deltaBiases[f], expectedBiases[f], 1e-10 );
+
+            for (int c=0; c<2; c++) {
+                for (int r=0; r<7; r++) {
+                    for (int v=0; v<7; v++) {
+                        EXPECT_NEAR( layer->filterDeltaWeights[f][c][r][v], expected[f][c][r][v], 1e-10 );
+                    }
+                }
+            }
+        }
+    }
+
+    // Picks one of the algorithms supported by the layer shape, leaving the delta weights untouched
+    TEST_F(FFTConvFixture, benchmarkConvAlgorithms_1) {
+        std::vector<std::vector<std::vector<std::vector<double> > > > deltaWeights = layer->filterDeltaWeights;
+        std::vector<double> deltaBiases = layer->deltaBiases;
+
+        int algorithm = NetUtil::benchmarkConvAlgorithms(layer, 1);
+
+        EXPECT_NE( algorithm, 1 );
+        EXPECT_EQ( layer->convAlgorithm, algorithm );
+        EXPECT_EQ( layer->filterDeltaWeights, deltaWeights );
+        EXPECT_EQ( layer->deltaBiases, deltaBiases );
+    }
+
+    // Leaves the activations, sum maps and dropout maps as they were, without taking any dropout draws
+    TEST_F(FFTConvFixture, benchmarkConvAlgorithms_2) {
+        net->dropout = 0.5;
+        net->isTraining = true;
+        layer->forward();
+
+        std::vector<std::vector<std::vector<double> > > activations = layer->activations;
+        std::vector<std::vector<double> > sumMap = layer->filters[1]->sumMap;
+        std::vector<std::vector<bool> > dropoutMap = layer->filters[1]->dropoutMap;
+
+        srand(7);
+        int nextRand = rand();
+        srand(7);
+
+        NetUtil::benchmarkConvAlgorithms(layer, 1);
+
+        EXPECT_EQ( rand(), nextRand );
+        EXPECT_EQ( net->dropout, 0.5 );
+        EXPECT_EQ( layer->activations, activations );
+        EXPECT_EQ( layer->filters[1]->sumMap, sumMap );
+        EXPECT_EQ( layer->filters[1]->dropoutMap, dropoutMap );
+    }
+
+    // Gives the same delta weights and delta biases as the direct path
+    TEST_F(FFTConvFixture, fftConvDWeights) {
+        layer->convAlgorithm = 0;
+        NetUtil::buildConvDWeights(layer);
+
+        std::vector<std::vector<std::vector<std::vector<double> > > > expected = layer->filterDeltaWeights;
+        std::vector<double> expectedBiases = layer->deltaBiases;
+
+        layer->filterDeltaWeights = {};
+        layer->deltaBiases = {0,0,0};
+
+        for (int f=0; f<3; f++) {
+            layer->filterDeltaWeights.push_back(NetUtil::createVolume<double>(2, 7, 7, 0));
+        }
+
+        layer->convAlgorithm = 2;
+        NetUtil::buildConvDWeights(layer);
+
+        for (int f=0; f<3; f++) {
+            EXPECT_NEAR( layer->deltaBiases[f], expectedBiases[f], 1e-10 );
+
+            for (int c=0; c<2; c++) {
+                for (int r=0; r<7; r++) {
+                    for (int v=0; v<7; v++) {
+                        EXPECT_NEAR( layer->filterDeltaWeights[f][c][r][v], expected[f][c][r][v], 1e-10 );
+                    }
+                }
+            }
+        }
+    }
+
+    // Multiplies matrices, with either of them optionally transposed, adding to the existing values
+    TEST(NetUtil, gemm) {
+        std::vector<double> a = {1,2,3, 4,5,6};
+        std::vector<double> aT = {1,4, 2,5, 3,6};
+        std::vector<double> b = {1,0, 0,1, 1,1};
+        std::vector<double> bT = {1,0,1, 0,1,1};
+        std::vector<double> expected = {5,6, 11,12};
+
+        std::vector<double> c1 = {1,1,1,1};
+        std::vector<double> c2 = {1,1,1,1};
+        std::vector<double> c3 = {1,1,1,1};
+        std::vector<double> c4 = {1,1,1,1};
+
+        NetUtil::gemm(&a[0], &b[0], &c1[0], 2, 2, 3, false, false);
+        NetUtil::gemm(&aT[0], &b[0], &c2[0], 2, 2, 3, true, false);
+        NetUtil::gemm(&a[0], &bT[0], &c3[0], 2, 2, 3, false, true);
+        NetUtil::gemm(&aT[0], &bT[0], &c4[0], 2, 2, 3, true, true);
+
+        EXPECT_EQ( c1, expected );
+        EXPECT_EQ( c2, expected );
+        EXPECT_EQ( c3, expected );
+        EXPECT_EQ( c4, expected );
+    }
+
+    // Unrolls the zero padded input patches into columns
+    TEST(NetUtil, im2col) {
+        std::vector<std::vector<std::vector<double> > > input = {{{1,2,3},{4,5,6},{7,8,9}}};
+        std::vector<double> res = NetUtil::im2col(input, 2, 0, 1);
+        std::vector<double> expected = {1,2,4,5, 2,3,5,6, 4,5,7,8, 5,6,8,9};
+        EXPECT_EQ( res, expected );
+
+        res = NetUtil::im2col(input, 3, 1, 2);
+        EXPECT_EQ( res.size(), 9*4 );
+        EXPECT_EQ( res[0], 0 );
+        EXPECT_EQ( res[4*4], 1 );
+        EXPECT_EQ( res[4*4+3], 9 );
+    }
+
+    // Gives the same results as NetUtil::convolve, with a stride of 2 (Example 1)
+    TEST(NetUtil, gemmConvolve) {
+        std::vector<double> testInput = {0,0,2,2,2, 1,1,0,2,0, 1,2,1,1,2, 0,1,2,2,1, 1,2,0,0,1, 2,2,1,1,2, 1,1,2,0,0, 2,0,0,2,2, 1,2,2,1,1, 1,1,2,0,1, 0,1,1,0,0, 1,2,0,2,0, 2,0,1,2,0, 2,0,1,0,1, 0,1,2,2,1};
+        std::vector<std::vector<std::vector<double> > > expected1 = {{{-4,7,5},{0,-5,0},{2,2,0}}};
+
+        Network::deleteNetwork();
+        Network::newNetwork();
+        ConvLayer* conv = new ConvLayer(0, 1);
+        conv->filterSize = 3;
+        conv->zeroPadding = 1;
+        conv->stride = 2;
+        conv->filterWeights = {{{{-1,0,-1},{1,0,1},{1,-1,0}},   {{0,1,1},{1,-1,-1},{-1,1,0}},  {{-1,0,-1},{1,0,0},{1,0,0}}}};
+
+        EXPECT_EQ( NetUtil::gemmConvolve(NetUtil::arrayToVolume(testInput, 3), conv), expected1 );
+
+        delete conv;
+    }
+
     TEST(NetUtil, createVolume) {
         std::vector<std::vector<std::vector<double> > > expected1 = {{{1,1,1},{1,1,1},{1,1,1}}, {{1,1,1},{1,1,1},{1,1,1}}};
         std::vector<std::vector<std::vector<double> > > expected2 = {{{0,0},{0,0},{0,0}}};
@@ -5020,6 +7561,63 @@ namespace NetUtil_cpp {
     }
 
 
+    // Builds all the error maps at once, the same way as buildConvErrorMap, when the next layer is 3x3, with stride 1
+    TEST_F(BuildConvErrorMapFixture, buildConvErrorMaps_1) {
+        nextLayerC->filters = {nlFilterC};
+        nextLayerC->errors = { {{0.1,0.4,-0.2,0.3,0},{0.9,0.2,-0.7,1.1,0.6},{0.4,0,0.3,-0.8,0.1},{0.2,0.3,0.1,-0.1,0.5},{-0.3,0.4,0.5,-0.2,0.3}} };
+        nextLayerC->filterWeights = { {{{1, 1, 0}, {-1, 1, 0}, {1, -1, 1}}} };
+        std::vector<std::vector<double> > expectedD = {{0.8,0.1,-0.1,2.0,0.6},{1.4,0.7,-1.4,-0.7,1},{0.2,0.1,3.1,-1.7,1.1},{-0.4,1.8,-0.6,0.7,-0.1},{-0.6,-0.1,0.8,0.2,-0.3}};
+
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::buildConvErrorMaps(5, nextLayerC, 1);
+
+        EXPECT_EQ( res.size(), 1 );
+        EXPECT_EQ( res[0].size(), 5 );
+        EXPECT_FALSE( nextLayerC->winogradErrorStale );
+
+        for (int r=0; r<5; r++) {
+            for (int c=0; c<5; c++) {
+                EXPECT_NEAR( res[0][r][c], expectedD[r][c], 1e-8 );
+            }
+        }
+    }
+
+    // Builds the error maps through im2col + GEMM the same way, with a stride of 2
+    TEST_F(BuildConvErrorMapFixture, buildConvErrorMaps_3) {
+        nextLayerB->filters = {nlFilterA, nlFilterB};
+        nextLayerB->errors = { {{0.5, -0.2, 0.1}, {0, -0.4, -0.1}, {0.2, 0.6, 0.3}}, {{0.1, 0.4, 0.2}, {-0.1,0.2,-0.3}, {0, -0.4, 0.5}} };
+        nextLayerB->filterWeights = { {{{-1, 0, -1}, {1, 0, 1}, {1, -1, 0}}}, {{{1, 1, 0}, {-1, 1, 0}, {1, -1, 1}}} };
+        nextLayerB->convAlgorithm = 3;
+        std::vector<std::vector<double> > expectedC = {{0.1,-0.1,0.4,-0.3,0.2},{-0.7,0.9,0,0.9,-0.6},{-0.1,-0.6,0.2,-0.2,-0.3},{0.1,-1.5,-0.2,-0.6,0.9},{0,1.2,-0.4,0.4,0.5}};
+
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::buildConvErrorMaps(5, nextLayerB, 1);
+
+        for (int r=0; r<5; r++) {
+            for (int c=0; c<5; c++) {
+                EXPECT_NEAR( res[0][r][c], expectedC[r][c], 1e-8 );
+            }
+        }
+    }
+
+    // Falls back to buildConvErrorMap, for each channel, when the next layer's stride is not 1
+    TEST_F(BuildConvErrorMapFixture, buildConvErrorMaps_2) {
+        nextLayerB->filters = {nlFilterA, nlFilterB};
+        nextLayerB->errors = { {{0.5, -0.2, 0.1}, {0, -0.4, -0.1}, {0.2, 0.6, 0.3}}, {{0.1, 0.4, 0.2}, {-0.1,0.2,-0.3}, {0, -0.4, 0.5}} };
+        nextLayerB->filterWeights = { {{{-1, 0, -1}, {1, 0, 1}, {1, -1, 0}}}, {{{1, 1, 0}, {-1, 1, 0}, {1, -1, 1}}} };
+        std::vector<std::vector<double> > expectedC = {{0.1,-0.1,0.4,-0.3,0.2},{-0.7,0.9,0,0.9,-0.6},{-0.1,-0.6,0.2,-0.2,-0.3},{0.1,-1.5,-0.2,-0.6,0.9},{0,1.2,-0.4,0.4,0.5}};
+
+        std::vector<std::vector<std::vector<double> > > res = NetUtil::buildConvErrorMaps(5, nextLayerB, 1);
+
+        EXPECT_EQ( res.size(), 1 );
+        EXPECT_TRUE( nextLayerB->winogradErrorStale );
+
+        for (int r=0; r<5; r++) {
+            for (int c=0; c<5; c++) {
+                EXPECT_NEAR( res[0][r][c], expectedC[r][c], 1e-8 );
+            }
+        }
+    }
+
+
     class GetActivationsFixture : public ::testing::Test {
     public:
         virtual void SetUp() {
@@ -9,10 +9,11 @@ const sinon = require("sinon")
 chai.use(sinonChai)
 chai.use(chaiAsPromised)
 
-global.Module = require("./emscriptenTests.js")
+// Set JSNET_WASM_SIMD to run against the SIMD128 build of the emscripten test module
+global.Module = require(process.env.JSNET_WASM_SIMD ? "./emscriptenTests.simd.js" : "./emscriptenTests.js")
 
 const {Network, Layer, FCLayer, ConvLayer, PoolLayer, InputLayer, OutputLayer,
-    Neuron, Filter, NetUtil, NetMath} = require("../dist/jsNetWebAssembly.concat.js")
+    Neuron, Filter, NetUtil, NetMath, Ensemble} = require("../dist/jsNetWebAssembly.concat.js")
 
 describe("Loading", () => {
     it("Network is loaded", () => expect(Network).to.not.be.undefined)
@@ -25,6 +26,7 @@ describe("Loading", () => {
     it("Neuron is loaded", () => expect(Neuron).to.not.be.undefined)
     it("Filter is loaded", () => expect(Filter).to.not.be.undefined)
     it("NetUtil is loaded", () => expect(NetUtil).to.not.be.undefined)
+    it("Ensemble is loaded", () => expect(Ensemble).to.not.be.undefined)
 
     it("Loads Layer as an alias of FCLayer", () => {
 
@@ -432,6 +434,16 @@ describe("Network", () => {
                 expect(NetUtil.defineProperty).to.be.calledWith(net, "maxNormTotal")
             })
 
+            it("Defines the net parallelThreshold", () => {
+                const net = new Network({Module: fakeModule})
+                expect(NetUtil.defineProperty).to.be.calledWith(net, "parallelThreshold", ["number"], [0])
+            })
+
+            it("Defines the net priority", () => {
+                const net = new Network({Module: fakeModule})
+                expect(NetUtil.defineProperty).to.be.calledWith(net, "priority", ["number"], [0])
+            })
+
             it("Defines the net channels when configured", () => {
                 const net = new Network({Module: fakeModule, channels: 3})
                 expect(NetUtil.defineProperty).to.be.calledWith(net, "channels")
@@ -843,31 +855,82 @@ describe("Network", () => {
         })
 
         it("Logs a warning if the given input array length does not match input length", () => {
-            sinon.stub(NetUtil, "ccallArrays")
             sinon.spy(console, "warn")
             const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
+            net.inputView = () => new Float64Array(4)
+            net.outputView = () => new Float64Array(3)
             net.forward([1,2,3,4])
             expect(console.warn).to.have.been.calledWith("Input data length did not match input layer neurons count.")
             console.warn.restore()
-            NetUtil.ccallArrays.restore()
         })
 
-        it("Calls the NetUtil.ccallArrays function with the data, otherwise", () => {
-            const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
-            sinon.stub(NetUtil, "ccallArrays")
-            net.netInstance = 123
-            net.forward([1,2,3])
-            expect(NetUtil.ccallArrays).to.be.calledWith("forward", "array", ["number", "array"], [123, [1,2,3]], {heapOut: "HEAPF64", returnArraySize: 3})
-            NetUtil.ccallArrays.restore()
-        })
+        describe("WASM memory views", () => {
 
-        it("Flattens volume input data", () => {
-            const net = new Network({Module: fakeModule, layers: [new FCLayer(4)]})
-            sinon.stub(NetUtil, "ccallArrays")
-            net.netInstance = 123
-            net.forward([[[1,2],[3,4]]])
-            expect(NetUtil.ccallArrays).to.be.calledWith("forward", "array", ["number", "array"], [123, [1,2,3,4]], {heapOut: "HEAPF64", returnArraySize: 4})
-            NetUtil.ccallArrays.restore()
+            let heap
+            let originalHeap
+
+            beforeEach(() => {
+                originalHeap = fakeModule.HEAPF64
+                heap = new Float64Array(16)
+                heap.set([0.1, 0.2, 0.3, 0.4], 8)
+                fakeModule.HEAPF64 = heap
+                sinon.stub(fakeModule, "ccall").callsFake(fnName => ({get_input_buffer: 0, get_output_buffer: 64})[fnName])
+            })
+
+            afterEach(() => {
+                fakeModule.ccall.restore()
+                fakeModule.HEAPF64 = originalHeap
+            })
+
+            it("Writes the data straight into the input layer's WASM memory, and returns the output activations", () => {
+                const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
+                net.netInstance = 123
+                const result = net.forward([1,2,3])
+                expect(Array.from(heap.subarray(0, 3))).to.deep.equal([1,2,3])
+                expect(fakeModule.ccall).to.be.calledWith("forward_buffer", "number", ["number"], [123])
+                expect(result).to.deep.equal([0.1, 0.2, 0.3])
+            })
+
+            it("Drops input values past the input layer's size", () => {
+                const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
+                sinon.stub(console, "warn")
+                net.forward([1,2,3,4,5])
+                console.warn.restore()
+                expect(Array.from(heap.subarray(0, 4))).to.deep.equal([1,2,3,0])
+            })
+
+            it("Zeroes the input values left over from a longer input, when given too few", () => {
+                const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
+                net.forward([1,2,3])
+                sinon.stub(console, "warn")
+                net.forward([4])
+                console.warn.restore()
+                expect(Array.from(heap.subarray(0, 3))).to.deep.equal([4,0,0])
+            })
+
+            it("Flattens volume input data", () => {
+                const net = new Network({Module: fakeModule, layers: [new FCLayer(4)]})
+                const result = net.forward([[[1,2],[3,4]]])
+                expect(Array.from(heap.subarray(0, 4))).to.deep.equal([1,2,3,4])
+                expect(result).to.deep.equal([0.1, 0.2, 0.3, 0.4])
+            })
+
+            it("Re-uses the same views across forward passes", () => {
+                const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
+                net.forward([1,2,3])
+                net.forward([4,5,6])
+                expect(fakeModule.ccall.withArgs("get_input_buffer").callCount).to.equal(1)
+                expect(fakeModule.ccall.withArgs("get_output_buffer").callCount).to.equal(1)
+                expect(net.inputView()).to.equal(net.inputView())
+            })
+
+            it("Re-creates the views when the WASM memory has grown", () => {
+                const net = new Network({Module: fakeModule, layers: [new Layer(3)]})
+                const view = net.inputView()
+                fakeModule.HEAPF64 = new Float64Array(32)
+                expect(net.inputView()).to.not.equal(view)
+                expect(net.inputView().buffer).to.equal(fakeModule.HEAPF64.buffer)
+            })
         })
     })
 
@@ -918,6 +981,13 @@ describe("Network", () => {
             return expect(net.train()).to.be.rejectedWith("No data provided")
         })
 
+        it("Rejects the promise when hogwild training is combined with prefetching or augmentation", () => {
+            return Promise.all([
+                expect(net.train(testData, {hogwild: true, prefetch: 2})).to.be.rejectedWith("Hogwild training can't be used with prefetching or augmentation"),
+                expect(net.train(testData, {hogwild: true, augmentation: {flip: true}})).to.be.rejectedWith("Hogwild training can't be used with prefetching or augmentation")
+            ])
+        })
+
         it("Rejects the promise if some data does not have the key 'input' and 'expected'/'output'", () => {
             return expect(net.train(badTestData)).to.be.rejectedWith("Data set must be a list of objects with keys: 'input' and 'expected' (or 'output')")
         })
@@ -948,6 +1018,85 @@ describe("Network", () => {
             })
         })
 
+        it("CCalls the Module's set_threads function with the given threads value", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            return net.train(testData, {threads: 4}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_threads", null, ["number", "number"], [99, 4])
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("Defaults the threads to 1", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            return net.train(testData).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_threads", null, ["number", "number"], [99, 1])
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("CCalls the Module's set_prefetch function with the given prefetch value, defaulting to 0", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            return net.train(testData, {prefetch: 2}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_prefetch", null, ["number", "number"], [99, 2])
+                return net.train(testData)
+            }).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_prefetch", null, ["number", "number"], [99, 0])
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("CCalls the Module's set_hogwild function with the hogwild option, defaulting to false", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            return net.train(testData, {hogwild: true}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_hogwild", null, ["number", "number"], [99, 1])
+                return net.train(testData)
+            }).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_hogwild", null, ["number", "number"], [99, 0])
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("CCalls the Module's set_deterministic function with the deterministic option, defaulting to false", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            return net.train(testData, {deterministic: true}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_deterministic", null, ["number", "number"], [99, 1])
+                return net.train(testData)
+            }).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_deterministic", null, ["number", "number"], [99, 0])
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("CCalls the Module's set_pipeline function with the pipeline option, defaulting to false", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            return net.train(testData, {pipeline: true}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_pipeline", null, ["number", "number"], [99, 1])
+                return net.train(testData)
+            }).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_pipeline", null, ["number", "number"], [99, 0])
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("CCalls the Module's set_augmentation function with the augmentation config, defaulting to none", () => {
+            sinon.stub(fakeModule, "ccall")
+            net.netInstance = 99
+            const types = ["number", "number", "number", "number", "number"]
+            return net.train(testData, {augmentation: {shift: 2, flip: true, noise: 0.05}}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_augmentation", null, types, [99, 2, 1, 0, 0.05])
+                return net.train(testData)
+            }).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_augmentation", null, types, [99, 0, 0, 0, 0])
+                fakeModule.ccall.restore()
+            })
+        })
+
         it("CCalls the WASM Module's shuffleTrainingData function if the shuffle option is set to true", () => {
             sinon.stub(fakeModule, "ccall")
             net.netInstance = 123
@@ -957,6 +1106,26 @@ describe("Network", () => {
             })
         })
 
+        it("Shuffles the training order at the start of every epoch", () => {
+            sinon.stub(fakeModule, "ccall").callsFake(() => 0)
+            return net.train(testData, {shuffle: true, epochs: 3}).then(() => {
+                expect(fakeModule.ccall.withArgs("shuffleTrainingData").callCount).to.equal(3)
+                fakeModule.ccall.restore()
+            })
+        })
+
+        it("CCalls the WASM Module's set_shuffleSeed function with the seed option, if given", () => {
+            sinon.stub(fakeModule, "ccall").callsFake(() => 0)
+            net.netInstance = 123
+            return net.train(testData, {shuffle: true, seed: 42}).then(() => {
+                expect(fakeModule.ccall).to.be.calledWith("set_shuffleSeed", null, ["number", "number"], [123, 42])
+                return net.train(testData, {shuffle: true})
+            }).then(() => {
+                expect(fakeModule.ccall.withArgs("set_shuffleSeed").callCount).to.equal(1)
+                fakeModule.ccall.restore()
+            })
+        })
+
         it("CCalls the WASM Module's collectErrors function if the option is configured as true", () => {
             sinon.stub(fakeModule, "ccall")
             net.netInstance = 456
@@ -994,6 +1163,39 @@ describe("Network", () => {
             })
         })
 
+        it("Loads class index samples, working out the classes count from the data without any layers", () => {
+            const network = new Network({Module: fakeModule})
+            const stub = sinon.stub(fakeModule, "ccall").callsFake(() => 0)
+            sinon.stub(fakeModule, "_malloc").callsFake(bytes => bytes)
+            sinon.spy(network, "initLayers")
+            const labelData = [{input: [1, 2], expected: 1}, {input: [3, 4], output: 2}, {input: [5, 6], expected: 0}]
+
+            return network.train(labelData, {log: false}).then(() => {
+                expect(network.initLayers).to.be.calledWith(2, 3)
+                stub.restore()
+                fakeModule._malloc.restore()
+            })
+        })
+
+        it("Loads the validation data from its own buffer, and frees the data buffers once loaded", () => {
+            const network = new Network({Module: fakeModule})
+            const stub = sinon.stub(fakeModule, "ccall").callsFake(() => 0)
+            sinon.stub(fakeModule, "_malloc").callsFake(bytes => bytes)
+            sinon.stub(fakeModule, "_free")
+
+            return network.train(testData, {validation: {data: testData.slice(0, 3)}}).then(() => {
+                // 4 training items, then 3 validation items, of 4 values each
+                const types = ["number", "number", "number", "number", "number", "number"]
+                expect(stub).to.be.calledWith("loadTrainingData", "number", types, [network.netInstance, 64, 16, 4, 2, 0])
+                expect(stub).to.be.calledWith("loadValidationData", "number", types, [network.netInstance, 48, 12, 4, 2, 0])
+                expect(fakeModule._free).to.be.calledWith(64)
+                expect(fakeModule._free).to.be.calledWith(48)
+                stub.restore()
+                fakeModule._malloc.restore()
+                fakeModule._free.restore()
+            })
+        })
+
         it("CCalls the WASM Module's train function for every iteration when a callback is given", () => {
             const network = new Network({Module: fakeModule})
             const stub = sinon.stub(fakeModule, "ccall").callsFake(() => 0)
@@ -1006,6 +1208,32 @@ describe("Network", () => {
             })
         })
 
+        it("CCalls the WASM Module's trainFor function with the timeBudget, until the epoch is over", () => {
+            const network = new Network({Module: fakeModule})
+            const cursors = [2, 0]
+            const stub = sinon.stub(fakeModule, "ccall").callsFake(fnName => fnName=="get_trainingCursor" ? cursors.shift() : 0)
+
+            return network.train(testData, {timeBudget: 16}).then(() => {
+                expect(stub.withArgs("trainFor").callCount).to.equal(2)
+                expect(stub).to.be.calledWith("trainFor", "number", ["number", "number"], [network.netInstance, 16])
+                expect(stub.withArgs("train")).to.not.be.called
+                stub.restore()
+            })
+        })
+
+        it("Calls the callback after every timeBudget step, in every epoch", () => {
+            const cb = sinon.stub()
+            const network = new Network({Module: fakeModule})
+            const stub = sinon.stub(fakeModule, "ccall").callsFake(fnName => fnName=="trainFor" ? 4 : 0)
+
+            return network.train(testData, {epochs: 3, timeBudget: 16, callback: cb}).then(() => {
+                expect(cb.callCount).to.equal(3)
+                expect(cb.firstCall.args[0].trained).to.equal(4)
+                expect(cb.lastCall.args[0].epoch).to.equal(3)
+                stub.restore()
+            })
+        })
+
         it("Calls the callback with every iteration, in every epoch", () => {
             let counter = 0
             const cb = () => counter++
@@ -1028,6 +1256,19 @@ describe("Network", () => {
             })
         })
 
+        it("CCalls the Module's set_backgroundValidation function with the validation's background option, defaulting to off", () => {
+            const network = new Network({Module: fakeModule})
+            const stub = sinon.stub(fakeModule, "ccall").callsFake(() => 0)
+
+            return network.train(testData, {validation: {data: testData, background: true}}).then(() => {
+                expect(stub).to.be.calledWith("set_backgroundValidation", null, ["number", "number"], [0, 1])
+                return network.train(testData, {validation: {data: testData}})
+            }).then(() => {
+                expect(stub).to.be.calledWith("set_backgroundValidation", null, ["number", "number"], [0, 0])
+                stub.restore()
+            })
+        })
+
         it("Sets the l2Error to 0 with each epoch", () => {
             const network = new Network({Module: fakeModule, l2: 0.01})
             sinon.stub(fakeModule, "ccall").callsFake((_) => {
@@ -1308,7 +1549,23 @@ describe("Network", () => {
         it("Calls the Module.ccall function with the data", () => {
             net.netInstance = 456
             net.test(testData)
-            expect(fakeModule.ccall).to.be.calledWith("loadTestingData", "number", ["number", "number", "number", "number", "number"])
+            expect(fakeModule.ccall).to.be.calledWith("loadTestingData", "number", ["number", "number", "number", "number", "number", "number"])
+        })
+
+        it("Loads class index samples as one expected value each, with the output layer's classes count", () => {
+            const network = new Network({Module: fakeModule, layers: [new FCLayer(2), new FCLayer(5)]})
+            network.netInstance = 456
+            fakeModule.ccall.resetHistory()
+            network.test([{input: [1, 2], expected: 0}, {input: [3, 4], expected: 4}])
+            expect(fakeModule.ccall).to.be.calledWith("loadTestingData", "number", ["number", "number", "number", "number", "number", "number"], [456, undefined, 6, 3, 2, 5])
+        })
+
+        it("CCalls the Module's set_threads function with the given threads value, defaulting to 1", () => {
+            net.netInstance = 456
+            net.test(testData, {threads: 3})
+            expect(fakeModule.ccall).to.be.calledWith("set_threads", null, ["number", "number"], [456, 3])
+            net.test(testData)
+            expect(fakeModule.ccall).to.be.calledWith("set_threads", null, ["number", "number"], [456, 1])
         })
 
         it("CCalls the WASM Module's test function once", () => {
@@ -1443,6 +1700,162 @@ describe("Network", () => {
         })
     })
 
+    describe("prefetchStats", () => {
+
+        it("Reads the stall time, stalls, load time and loaded batches out of the get_prefetchStats buffer", () => {
+            const net = new Network({Module: fakeModule})
+            const originalHeap = fakeModule.HEAPF64
+            fakeModule.HEAPF64 = new Float64Array([0, 0, 12.5, 3, 40, 20])
+            sinon.stub(fakeModule, "ccall").callsFake(() => 16)
+            net.netInstance = 7
+
+            expect(net.prefetchStats()).to.deep.equal({stallTime: 12.5, stalls: 3, loadTime: 40, batches: 20})
+            expect(fakeModule.ccall).to.be.calledWith("get_prefetchStats", "number", ["number"], [7])
+
+            fakeModule.ccall.restore()
+            fakeModule.HEAPF64 = originalHeap
+        })
+    })
+
+    describe("sweep", () => {
+
+        const testData = [{input: [1, 2], expected: [3]}, {input: [4, 5], expected: [6]}]
+        let nets
+        let originalHeap
+
+        beforeEach(() => {
+            originalHeap = fakeModule.HEAPF64
+            fakeModule.HEAPF64 = new Float64Array([0, 0, 4, 0.1, 0.2, 3, 2, 3, 0.5, 0.4, 1, 1])
+            nets = [new Network({Module: fakeModule}), new Network({Module: fakeModule})]
+            nets[0].netInstance = 3
+            nets[1].netInstance = 4
+
+            nets.forEach(net => {
+                net.state = "initialised"
+                sinon.stub(net, "loadDataSet")
+            })
+            sinon.stub(NetUtil, "ccallArrays").callsFake(() => 16)
+        })
+
+        afterEach(() => {
+            NetUtil.ccallArrays.restore()
+            fakeModule.HEAPF64 = originalHeap
+        })
+
+        it("Rejects the promise when no networks are given", () => {
+            return Network.sweep([], testData, {log: false}).catch(err => expect(err).to.equal("No networks provided"))
+        })
+
+        it("Loads the training and validation data into just the first network", () => {
+            const validation = {data: testData}
+            return Network.sweep(nets, testData, {log: false, validation}).then(() => {
+                expect(nets[0].loadDataSet).to.be.calledWith("loadTrainingData", testData)
+                expect(nets[0].loadDataSet).to.be.calledWith("loadValidationData", testData)
+                expect(nets[1].loadDataSet).to.not.be.called
+            })
+        })
+
+        it("Calls the native sweep with the networks' instances, and the options", () => {
+            return Network.sweep(nets, testData, {log: false, epochs: 2, keep: 0.25, threads: 4, shuffle: true}).then(() => {
+                expect(NetUtil.ccallArrays).to.be.calledWith("sweep", "number", ["array", "number", "number", "number", "number"],
+                    [[3, 4], 2, 0.25, 4, 1], {heapIn: "HEAP32"})
+            })
+        })
+
+        it("Resolves with a row per network, in the order given natively", () => {
+            return Network.sweep(nets, testData, {log: false}).then(results => {
+                expect(results).to.deep.equal([
+                    {network: nets[1], validationError: 0.1, trainingError: 0.2, epochs: 3, rounds: 2},
+                    {network: nets[0], validationError: 0.5, trainingError: 0.4, epochs: 1, rounds: 1}
+                ])
+            })
+        })
+    })
+
+    describe("exportParameters / importParameters", () => {
+
+        let net
+        let originalHeap
+
+        beforeEach(() => {
+            // The layout at byte 0, and the values at byte 64
+            const buffer = new ArrayBuffer(256)
+            originalHeap = fakeModule.HEAPF64
+            fakeModule.HEAP32 = new Int32Array(buffer)
+            fakeModule.HEAPF64 = new Float64Array(buffer)
+            fakeModule.HEAP32.set([0,0,0,0,0, 0,3,6,0,6])
+            fakeModule.HEAPF64.set([1,2,3, 4,5, 6,7, 8,9, 1,1, 1,1, 1,1], 8)
+
+            net = new Network({Module: fakeModule, layers: [new FCLayer(2), new FCLayer(3)]})
+            net.state = "initialised"
+            sinon.stub(fakeModule, "ccall").callsFake(fnName => ({get_parametersLayout: 0, exportParameters: 64})[fnName])
+            sinon.stub(NetUtil, "ccallArrays")
+        })
+
+        afterEach(() => {
+            fakeModule.ccall.restore()
+            NetUtil.ccallArrays.restore()
+            fakeModule.HEAPF64 = originalHeap
+            delete fakeModule.HEAP32
+        })
+
+        it("Throws an error if the network has not been initialised", () => {
+            net.state = "constructed"
+            expect(net.exportParameters.bind(net)).to.throw("The network layers have not been initialised.")
+            expect(net.importParameters.bind(net, {})).to.throw("The network layers have not been initialised.")
+        })
+
+        it("Copies every parameter out of the WASM memory with one exportParameters ccall", () => {
+            const params = net.exportParameters()
+            expect(fakeModule.ccall.withArgs("exportParameters").callCount).to.equal(1)
+            expect(params.layout).to.deep.equal([0,0,0,0,0, 0,3,6,0,6])
+            expect(Array.from(params.values)).to.deep.equal([1,2,3,4,5,6,7,8,9,1,1,1,1,1,1])
+            expect(params.values.buffer).to.not.equal(fakeModule.HEAPF64.buffer)
+        })
+
+        it("Imports the values with one importParameters ccall", () => {
+            const params = net.exportParameters()
+            net.importParameters(params)
+            expect(NetUtil.ccallArrays).to.be.calledOnce
+            expect(NetUtil.ccallArrays).to.be.calledWith("importParameters", "number", ["number", "array"], [net.netInstance, params.values], {heapIn: "HEAPF64"})
+        })
+
+        it("Throws an error if the layout or values count don't match the network's", () => {
+            expect(net.importParameters.bind(net)).to.throw("No parameters given to import.")
+            expect(net.importParameters.bind(net, {layout: [0,0,0,0,0, 0,3,9,0,9], values: new Float64Array(21)})).to.throw("Mismatched parameters layout. The network's layers or update function differ from the exported ones.")
+            expect(net.importParameters.bind(net, {layout: [0,0,0,0,0, 0,3,6,0,6], values: new Float64Array(8)})).to.throw("Mismatched parameters count. Given: 8 Existing: 15")
+            expect(NetUtil.ccallArrays).to.not.be.called
+        })
+
+        it("Builds the JSON from the exported parameters", () => {
+            const json = net.toJSON()
+            expect(json.layers[1].weights).to.deep.equal([
+                {bias: 1, weights: [4,5]},
+                {bias: 2, weights: [6,7]},
+                {bias: 3, weights: [8,9]}
+            ])
+        })
+
+        it("Imports JSON by writing into the exported parameters, and importing them back", () => {
+            net.fromJSON({layers: [{weights: [{},{}]}, {weights: [
+                {bias: -1, weights: [-4,-5]},
+                {bias: -2, weights: [-6,-7]},
+                {bias: -3, weights: [-8,-9]}
+            ]}]})
+            expect(NetUtil.ccallArrays).to.be.calledOnce
+            expect(Array.from(NetUtil.ccallArrays.firstCall.args[3][1])).to.deep.equal([-1,-2,-3,-4,-5,-6,-7,-8,-9,1,1,1,1,1,1])
+        })
+
+        it("Orders the IMG data as each neuron's bias, then its weights", () => {
+            const IMGArrays = {toIMG: sinon.stub(), fromIMG: () => [-1,-4,-5, -2,-6,-7, -3,-8,-9]}
+            net.toIMG(IMGArrays)
+            expect(IMGArrays.toIMG).to.be.calledWith([1,4,5, 2,6,7, 3,8,9])
+
+            net.fromIMG(null, IMGArrays)
+            expect(Array.from(NetUtil.ccallArrays.firstCall.args[3][1])).to.deep.equal([-1,-2,-3,-4,-5,-6,-7,-8,-9,1,1,1,1,1,1])
+        })
+    })
+
     describe("toIMG", () => {
         it("Throws an error if IMGArrays is not provided", () => {
             const net = new Network({Module: fakeModule})
@@ -3262,6 +3675,83 @@ describe("OutputLayer", () => {
     })
 })
 
+describe("Ensemble", () => {
+
+    const makeNet = (input, output, netInstance) => ({state: "initialised", netInstance, layers: [{size: input}, {size: 3}, {size: output}]})
+    let nets
+
+    beforeEach(() => {
+        nets = [makeNet(2, 3, 4), makeNet(2, 3, 5)]
+        sinon.stub(NetUtil, "ccallArrays").callsFake(() => 16)
+        sinon.spy(fakeModule, "ccall")
+    })
+
+    afterEach(() => {
+        NetUtil.ccallArrays.restore()
+        fakeModule.ccall.restore()
+    })
+
+    describe("constructor", () => {
+
+        it("Throws an error if no networks are given", () => {
+            expect(() => new Ensemble({Module: fakeModule})).to.throw("No networks provided")
+        })
+
+        it("Throws an error if a network has not been initialised", () => {
+            nets[1].state = "not-defined"
+            expect(() => new Ensemble({Module: fakeModule, networks: nets})).to.throw("The network layers have not been initialised.")
+        })
+
+        it("Throws an error if the networks' input or output sizes differ", () => {
+            nets[1] = makeNet(2, 4, 5)
+            expect(() => new Ensemble({Module: fakeModule, networks: nets})).to.throw("The networks' input and output sizes must match.")
+        })
+
+        it("Throws an error for unknown combinations", () => {
+            expect(() => new Ensemble({Module: fakeModule, networks: nets, combine: "median"})).to.throw("Unknown ensemble combination: median")
+        })
+
+        it("Creates the native ensemble from the networks' instances", () => {
+            const ensemble = new Ensemble({Module: fakeModule, networks: nets})
+            expect(NetUtil.ccallArrays).to.be.calledWith("newEnsemble", "number", ["array"], [[4, 5]], {heapIn: "HEAP32"})
+            expect(ensemble.ensembleInstance).to.equal(16)
+        })
+
+        it("Sets the combination, weights and threads natively", () => {
+            new Ensemble({Module: fakeModule, networks: nets, combine: "Vote", weights: [2, 1], threads: 3})
+            expect(fakeModule.ccall).to.be.calledWith("set_ensemble_combine", null, ["number", "number"], [16, 2])
+            expect(fakeModule.ccall).to.be.calledWith("set_ensemble_threads", null, ["number", "number"], [16, 3])
+            expect(NetUtil.ccallArrays).to.be.calledWith("set_ensemble_weights", null, ["number", "array"], [16, [2, 1]], {heapIn: "HEAPF64"})
+        })
+    })
+
+    describe("forward", () => {
+
+        let originalHeap
+
+        beforeEach(() => {
+            originalHeap = fakeModule.HEAPF64
+            fakeModule.HEAPF64 = new Float64Array([0, 0, 1, 2, 3, 4, 5, 6])
+        })
+
+        afterEach(() => fakeModule.HEAPF64 = originalHeap)
+
+        it("Passes all the inputs natively in one block, and reads back each one's combined output", () => {
+            const ensemble = new Ensemble({Module: fakeModule, networks: nets})
+
+            expect(ensemble.forward([[1, 2], [3, 4]])).to.deep.equal([[1, 2, 3], [4, 5, 6]])
+            expect(NetUtil.ccallArrays).to.be.calledWith("ensemble_forward", "number", ["number", "array"], [16, new Float32Array([1, 2, 3, 4])])
+        })
+
+        it("Flattens volume inputs", () => {
+            nets = [makeNet(4, 3, 4)]
+            const ensemble = new Ensemble({Module: fakeModule, networks: nets})
+            ensemble.forward([[[[1, 2], [3, 4]]]])
+            expect(NetUtil.ccallArrays).to.be.calledWith("ensemble_forward", "number", ["number", "array"], [16, new Float32Array([1, 2, 3, 4])])
+        })
+    })
+})
+
 describe("NetUtil", () => {
 
     describe("ccallArrays", () => {
@@ -3345,7 +3835,18 @@ describe("NetUtil", () => {
             expect(Array.isArray(res)).to.be.false
         })
 
-        it("Throws errors, but first it frees the memory using Module._free", () => {
+        it("Re-uses the same scratch memory across calls, only growing it when needed", () => {
+            NetUtil.scratch = undefined
+            sinon.spy(NetUtil.Module, "_malloc")
+            NetUtil.ccallArrays("addNums", "number", ["array"], [[1,2,3]], {heapIn: "HEAP32"})
+            NetUtil.ccallArrays("addNums", "number", ["array"], [[4,5,6]], {heapIn: "HEAP32"})
+            expect(NetUtil.Module._malloc.callCount).to.equal(1)
+            NetUtil.ccallArrays("addNums", "number", ["array"], [[1,2,3,4,5,6,7,8,9,10]], {heapIn: "HEAP32"})
+            expect(NetUtil.Module._malloc.callCount).to.equal(2)
+            NetUtil.Module._malloc.restore()
+        })
+
+        it("Throws errors from the ccall", () => {
             sinon.stub(NetUtil.Module, "ccall").callsFake(() => {throw new Error("Fake error")})
             expect(NetUtil.ccallArrays.bind(null, "addNums", "array", ["array"], [[1,2,3]], {heapIn: "HEAP32", heapOut: "HEAP3fdgd2"})).to.throw("Fake error")
             NetUtil.Module.ccall.restore()
@@ -3432,6 +3933,49 @@ describe("NetUtil", () => {
         })
     })
 
+    describe("simdSupported", () => {
+
+        afterEach(() => {
+            delete global.jsNetWASMSIMD
+            WebAssembly.validate.restore && WebAssembly.validate.restore()
+        })
+
+        it("Returns whether the runtime validates the SIMD128 test module", () => {
+            sinon.stub(WebAssembly, "validate").returns(true)
+            expect(NetUtil.simdSupported()).to.be.true
+            WebAssembly.validate.returns(false)
+            expect(NetUtil.simdSupported()).to.be.false
+        })
+
+        it("Returns false when validating throws", () => {
+            sinon.stub(WebAssembly, "validate").throws(new Error())
+            expect(NetUtil.simdSupported()).to.be.false
+        })
+
+        it("Returns false when global.jsNetWASMSIMD is false, without checking", () => {
+            sinon.stub(WebAssembly, "validate").returns(true)
+            global.jsNetWASMSIMD = false
+            expect(NetUtil.simdSupported()).to.be.false
+            expect(WebAssembly.validate).to.not.be.called
+        })
+    })
+
+    describe("threadsSupported", () => {
+
+        afterEach(() => {
+            delete global.crossOriginIsolated
+        })
+
+        it("Returns true when SharedArrayBuffer is available, outside of browsers", () => {
+            expect(NetUtil.threadsSupported()).to.equal(typeof SharedArrayBuffer=="function")
+        })
+
+        it("Returns false on pages which are not cross-origin isolated", () => {
+            global.crossOriginIsolated = false
+            expect(NetUtil.threadsSupported()).to.be.false
+        })
+    })
+
     describe("format", () => {
 
         it("Returns undefined if passed undefined", () => {